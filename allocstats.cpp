@@ -0,0 +1,55 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "allocstats.h"
+
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+// counted without any ordering, so counting costs a single atomic addition
+static std::atomic<uint64_t> AllocationCount(0);
+
+uint64_t GetAllocationCount(void)
+{
+   return AllocationCount.load(std::memory_order_relaxed);
+}
+
+//
+// Array and non-throwing forms of `operator new` call this one, so they
+// are counted as well. Aligned allocations are not used.
+//
+void *operator new(std::size_t size)
+{
+   AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+   // zero-size allocations must return distinct pointers
+   if(size == 0)
+      size = 1;
+
+   for(;;) {
+      if(void *ptr = malloc(size))
+         return ptr;
+
+      std::new_handler handler = std::get_new_handler();
+
+      if(!handler)
+         throw std::bad_alloc();
+
+      handler();
+   }
+}
+
+void operator delete(void *ptr) noexcept
+{
+   free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+   free(ptr);
+}
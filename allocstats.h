@@ -0,0 +1,23 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <cstdint>
+
+///
+/// @brief  Returns the number of memory blocks allocated with `operator new`
+///         by all threads since the program started.
+///
+/// Global `operator new` and `operator delete` are replaced in the same
+/// module to count allocations. Memory allocated with `malloc`, such as
+/// by the Flex scanner or zlib, is not counted.
+///
+uint64_t GetAllocationCount(void);
+
+#endif // ALLOCSTATS_H
@@ -0,0 +1,86 @@
+#include "bm_corpus.h"
+
+namespace bench {
+
+const char *GetCorpusName(corpus_t corpus)
+{
+   switch(corpus) {
+      case CORPUS_COMMENTS:
+         return "comments";
+      case CORPUS_STRINGS:
+         return "strings";
+      case CORPUS_LONG_LINES:
+         return "long-lines";
+      case CORPUS_CRLF:
+         return "crlf";
+      case CORPUS_BRACES:
+         return "braces";
+      default:
+         return "unknown";
+   }
+}
+
+std::string MakeCorpus(corpus_t corpus, size_t size)
+{
+   std::string source;
+   std::string block;
+
+   switch(corpus) {
+      case CORPUS_COMMENTS:
+         block = "/*\n"
+                 " * A C comment block that describes the function below\n"
+                 " * in a few lines of text, with some code in it: x = y * z;\n"
+                 " */\n"
+                 "// A C++ comment line\n"
+                 "// Another C++ comment line with a /* nested */ comment\n"
+                 "int value = 0;   /* trailing C comment */   // and a C++ one\n"
+                 "/* a C comment */ // followed by a C++ comment\n";
+         break;
+      case CORPUS_STRINGS:
+         block = "printf(\"value: %d, name: \\\"%s\\\"\\n\", value, name);\n"
+                 "const char *path = \"C:\\\\Program Files\\\\linecnt\\\\// not a comment\";\n"
+                 "const char *text = \"/* not a comment */ and a quote \\\" inside\";\n"
+                 "char quote = '\"', slash = '/', star = '*', esc = '\\'';\n"
+                 "std::string line = \"a string that is long enough to take a while to scan\";\n";
+         break;
+      case CORPUS_LONG_LINES:
+         // each line is about 4 KB of code with a comment at the end
+         for(size_t i = 0; i < 128; i++)
+            block += "value" + std::to_string(i) + " = compute(a, b, c) + 42; ";
+         block += "// long line\n";
+         break;
+      case CORPUS_CRLF:
+         block = "/*\r\n"
+                 " * A C comment block.\r\n"
+                 " */\r\n"
+                 "int main(int argc, char *argv[])\r\n"
+                 "{\r\n"
+                 "   printf(\"argc: %d\\n\", argc);   // C++ comment\r\n"
+                 "\r\n"
+                 "   return 0;\r\n"
+                 "}\r\n";
+         break;
+      case CORPUS_BRACES:
+         block = "{\n"
+                 "   {\n"
+                 "\n"
+                 "      {\n"
+                 "      }\n"
+                 "\n"
+                 "   }\n"
+                 "}\n"
+                 "\n";
+         break;
+      default:
+         return source;
+   }
+
+   source.reserve(size + block.length());
+
+   while(source.length() < size)
+      source += block;
+
+   return source;
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef BM_CORPUS_H
+#define BM_CORPUS_H
+
+#include <string>
+#include <cstddef>
+
+namespace bench {
+
+///
+/// @brief  Synthetic source corpora that stress different lexer paths.
+///
+enum corpus_t {
+   CORPUS_COMMENTS,              ///< Mostly C and C++ comments.
+   CORPUS_STRINGS,               ///< Mostly string and character literals with escapes.
+   CORPUS_LONG_LINES,            ///< Code lines that are a few KB long.
+   CORPUS_CRLF,                  ///< Mixed code and comments with CR/LF line endings.
+   CORPUS_BRACES,                ///< Mostly brace-only and empty lines.
+   CORPUS_COUNT
+};
+
+/// Returns a short corpus name for benchmark labels.
+const char *GetCorpusName(corpus_t corpus);
+
+/// Generates a source text of the specified corpus of at least `size` bytes.
+std::string MakeCorpus(corpus_t corpus, size_t size);
+
+}
+
+#endif // BM_CORPUS_H
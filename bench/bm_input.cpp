@@ -0,0 +1,160 @@
+#include <benchmark/benchmark.h>
+
+#include "../cpplexer.h"
+#include "../mappedfile.h"
+#include "../filereader.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <map>
+#include <stdexcept>
+
+namespace bench {
+//
+// Input benchmarks compare reading source files via a file stream, which
+// Flex copies into its own buffer, with scanning memory-mapped files in
+// place. Benchmark arguments are file sizes in bytes, which are used to
+// find the break-even point for the minimum size of mapped files (-M).
+// Read-ahead benchmarks also take a FileReader backend (--io).
+//
+
+///
+/// @brief  Creates temporary source files of requested sizes on demand
+///         and removes them at exit.
+///
+class SourceFiles {
+   private:
+      std::map<size_t, std::string> paths;
+
+   public:
+      ~SourceFiles(void)
+      {
+         for(const auto& path : paths)
+            unlink(path.second.c_str());
+      }
+
+      const std::string& GetPath(size_t size)
+      {
+         auto iter = paths.find(size);
+
+         if(iter != paths.end())
+            return iter->second;
+
+         char path[] = "/tmp/linecnt-bench-XXXXXX";
+         int fd = mkstemp(path);
+
+         if(fd == -1)
+            throw std::runtime_error("Cannot create a temporary file");
+
+         static const char block[] =
+               "/*\n"
+               " * A C comment block.\n"
+               " */\n"
+               "int main(int argc, char *argv[])\n"
+               "{\n"
+               "   printf(\"argc: %d\\n\", argc);   // C++ comment\n"
+               "\n"
+               "   return 0;\n"
+               "}\n";
+
+         std::string source;
+
+         while(source.length() < size)
+            source.append(block, sizeof(block) - 1);
+
+         source.resize(size);
+
+         if(write(fd, source.data(), source.length()) != (ssize_t) source.length()) {
+            close(fd);
+            throw std::runtime_error("Cannot write a temporary file");
+         }
+
+         close(fd);
+
+         return paths.emplace(size, path).first->second;
+      }
+};
+
+static SourceFiles Sources;
+
+static void BM_ReadFile(benchmark::State& state)
+{
+   const std::string& path = Sources.GetPath((size_t) state.range(0));
+
+   for(auto _ : state) {
+      FILE *srcfile = fopen(path.c_str(), "r");
+
+      if(!srcfile) {
+         state.SkipWithError("Cannot open a source file");
+         break;
+      }
+
+      CppFlexLexer cpplex(std::move(srcfile));
+
+      benchmark::DoNotOptimize(cpplex.CountLines());
+   }
+
+   state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_MapFile(benchmark::State& state)
+{
+   const std::string& path = Sources.GetPath((size_t) state.range(0));
+
+   for(auto _ : state) {
+      struct stat statinfo;
+      int fd = open(path.c_str(), O_RDONLY);
+
+      if(fd == -1 || fstat(fd, &statinfo) == -1) {
+         state.SkipWithError("Cannot open a source file");
+         break;
+      }
+
+      MappedFile srcmap(std::move(fd), (size_t) statinfo.st_size);
+
+      CppFlexLexer cpplex(srcmap.GetData(), srcmap.GetLength());
+
+      benchmark::DoNotOptimize(cpplex.CountLines());
+   }
+
+   state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_ReadAhead(benchmark::State& state)
+{
+   const std::string& path = Sources.GetPath((size_t) state.range(0));
+   FileReader reader((FileReader::backend_t) state.range(1), 32);
+   std::string srcpath;
+   std::string source;
+
+   // keep the queue full, so each iteration waits only for the oldest file
+   for(size_t index = 0; index < 32; index++)
+      reader.Submit(std::string(path));
+
+   for(auto _ : state) {
+      if(reader.Next(srcpath, source) != 0) {
+         state.SkipWithError("Cannot read a source file");
+         break;
+      }
+
+      CppFlexLexer cpplex(&source[0], source.length() - 2);
+
+      benchmark::DoNotOptimize(cpplex.CountLines());
+
+      reader.Submit(std::move(srcpath));
+   }
+
+   state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ReadFile)->RangeMultiplier(4)->Range(1 << 10, 16 << 20);
+BENCHMARK(BM_MapFile)->RangeMultiplier(4)->Range(1 << 10, 16 << 20);
+BENCHMARK(BM_ReadAhead)->RangeMultiplier(4)->Ranges({{1 << 10, 16 << 20}, {FileReader::BACKEND_URING, FileReader::BACKEND_THREADS}});
+
+}
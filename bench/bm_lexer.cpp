@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+
+#include "bm_corpus.h"
+
+#include "../cpplexer.h"
+#include "../simdlexer.h"
+#include "../dfalexer.h"
+
+#include <string>
+#include <vector>
+
+namespace bench {
+//
+// Lexer benchmarks measure scanning throughput over in-memory corpora
+// that stress different lexer paths. Benchmark arguments are corpus
+// identifiers. Bytes per second are reported by the framework and lines
+// per second are reported as a rate counter.
+//
+// Running these before and after changing cpplexer_scanner.l, or after
+// upgrading Flex, shows whether scanner performance has changed.
+//
+
+static constexpr size_t CorpusSize = 4 << 20;
+
+///
+/// @brief  Returns a corpus with two zero bytes after the source text,
+///         which are required to scan the buffer in place.
+///
+static const std::string& GetCorpus(corpus_t corpus)
+{
+   static std::vector<std::string> corpora(CORPUS_COUNT);
+
+   if(corpora[corpus].empty()) {
+      corpora[corpus] = MakeCorpus(corpus, CorpusSize);
+      corpora[corpus].append(2, '\0');
+   }
+
+   return corpora[corpus];
+}
+
+///
+/// @brief  Reports throughput and the corpus name for a lexer benchmark.
+///
+static void SetLexerCounters(benchmark::State& state, corpus_t corpus, size_t length, uint64_t linecnt)
+{
+   state.SetLabel(GetCorpusName(corpus));
+   state.SetBytesProcessed(state.iterations() * (int64_t) length);
+   state.counters["lines/s"] = benchmark::Counter((double) (state.iterations() * linecnt), benchmark::Counter::kIsRate);
+}
+
+static void BM_FlexLexer(benchmark::State& state)
+{
+   corpus_t corpus = (corpus_t) state.range(0);
+   const std::string& source = GetCorpus(corpus);
+   std::string buffer;
+   uint64_t linecnt = 0;
+
+   for(auto _ : state) {
+      // Flex modifies the buffer while scanning it in place
+      state.PauseTiming();
+      buffer = source;
+      state.ResumeTiming();
+
+      CppFlexLexer cpplex(buffer.data(), buffer.length() - 2);
+
+      CppFlexLexer::Result counts = cpplex.CountLines();
+
+      benchmark::DoNotOptimize(counts);
+
+      linecnt = counts.linecnt;
+   }
+
+   SetLexerCounters(state, corpus, source.length() - 2, linecnt);
+}
+
+static void BM_SimdLexer(benchmark::State& state)
+{
+   corpus_t corpus = (corpus_t) state.range(0);
+   const std::string& source = GetCorpus(corpus);
+   uint64_t linecnt = 0;
+
+   for(auto _ : state) {
+      SimdLexer simdlex(std::string_view(source.data(), source.length() - 2));
+
+      CppFlexLexer::Result counts = simdlex.CountLines();
+
+      benchmark::DoNotOptimize(counts);
+
+      linecnt = counts.linecnt;
+   }
+
+   SetLexerCounters(state, corpus, source.length() - 2, linecnt);
+}
+
+static void BM_DfaLexer(benchmark::State& state)
+{
+   corpus_t corpus = (corpus_t) state.range(0);
+   const std::string& source = GetCorpus(corpus);
+   uint64_t linecnt = 0;
+
+   for(auto _ : state) {
+      DfaLexer dfalex(std::string_view(source.data(), source.length() - 2));
+
+      CppFlexLexer::Result counts = dfalex.CountLines();
+
+      benchmark::DoNotOptimize(counts);
+
+      linecnt = counts.linecnt;
+   }
+
+   SetLexerCounters(state, corpus, source.length() - 2, linecnt);
+}
+
+//
+// Runs the automaton over each corpus split into 4 chunks, which shows the
+// cost of speculative scanning when fewer cores than chunks are available.
+//
+static void BM_DfaLexerChunks(benchmark::State& state)
+{
+   corpus_t corpus = (corpus_t) state.range(0);
+   const std::string& source = GetCorpus(corpus);
+   uint64_t linecnt = 0;
+
+   for(auto _ : state) {
+      DfaLexer dfalex(std::string_view(source.data(), source.length() - 2));
+
+      CppFlexLexer::Result counts = dfalex.CountLines(4);
+
+      benchmark::DoNotOptimize(counts);
+
+      linecnt = counts.linecnt;
+   }
+
+   SetLexerCounters(state, corpus, source.length() - 2, linecnt);
+}
+
+BENCHMARK(BM_FlexLexer)->DenseRange(0, CORPUS_COUNT - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimdLexer)->DenseRange(0, CORPUS_COUNT - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DfaLexer)->DenseRange(0, CORPUS_COUNT - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DfaLexerChunks)->DenseRange(0, CORPUS_COUNT - 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
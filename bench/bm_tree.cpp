@@ -0,0 +1,185 @@
+#include <benchmark/benchmark.h>
+
+#include "bm_corpus.h"
+
+#include "../cpplexer.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <ftw.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+extern char **environ;
+
+namespace bench {
+//
+// Tree benchmarks run the linecnt executable against a generated source
+// tree and measure end-to-end throughput, including directory traversal,
+// file input and output. The executable path is taken from the LINECNT
+// environment variable, which is set by `make bench`. Benchmark arguments
+// are the number of threads (-J) and the engine (0 - flex, 1 - simd).
+//
+
+static constexpr size_t TreeDirs = 8;
+static constexpr size_t TreeSubdirs = 8;
+static constexpr size_t TreeFiles = 16;
+static constexpr size_t TreeFileSize = 16 << 10;
+
+///
+/// @brief  Creates a temporary source tree of a fixed shape on demand
+///         and removes it at exit.
+///
+class SourceTree {
+   private:
+      std::string rootdir;
+      uint64_t    bytecnt = 0;
+      uint64_t    linecnt = 0;
+      uint64_t    filecnt = 0;
+
+   private:
+      static int RemoveEntry(const char *path, const struct stat *, int, struct FTW *)
+      {
+         return remove(path);
+      }
+
+      void WriteFile(const std::string& path, const std::string& source)
+      {
+         FILE *file = fopen(path.c_str(), "wb");
+
+         if(!file || fwrite(source.data(), 1, source.length(), file) != source.length()) {
+            if(file)
+               fclose(file);
+            throw std::runtime_error("Cannot write a source file " + path);
+         }
+
+         fclose(file);
+
+         bytecnt += source.length();
+         linecnt += CppFlexLexer(source).CountLines().linecnt;
+         filecnt++;
+      }
+
+   public:
+      ~SourceTree(void)
+      {
+         if(!rootdir.empty())
+            nftw(rootdir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+      }
+
+      const std::string& GetRootDir(void)
+      {
+         if(!rootdir.empty())
+            return rootdir;
+
+         char path[] = "/tmp/linecnt-bench-tree-XXXXXX";
+
+         if(!mkdtemp(path))
+            throw std::runtime_error("Cannot create a temporary directory");
+
+         rootdir = path;
+
+         std::vector<std::string> corpora;
+
+         for(int corpus = 0; corpus < CORPUS_COUNT; corpus++)
+            corpora.push_back(MakeCorpus((corpus_t) corpus, TreeFileSize));
+
+         // files cycle through all corpora, so each directory has a mix of them
+         for(size_t d = 0; d < TreeDirs; d++) {
+            std::string dirpath = rootdir + "/d" + std::to_string(d);
+
+            mkdir(dirpath.c_str(), 0755);
+
+            for(size_t s = 0; s < TreeSubdirs; s++) {
+               std::string subdirpath = dirpath + "/s" + std::to_string(s);
+
+               mkdir(subdirpath.c_str(), 0755);
+
+               for(size_t f = 0; f < TreeFiles; f++)
+                  WriteFile(subdirpath + "/f" + std::to_string(f) + ".cpp", corpora[(d + s + f) % corpora.size()]);
+            }
+         }
+
+         return rootdir;
+      }
+
+      uint64_t GetByteCount(void) const {return bytecnt;}
+
+      uint64_t GetLineCount(void) const {return linecnt;}
+
+      uint64_t GetFileCount(void) const {return filecnt;}
+};
+
+static SourceTree Tree;
+
+///
+/// @brief  Runs linecnt with the specified arguments and its standard
+///         output redirected to `/dev/null`. Returns `false` if linecnt
+///         could not be started or did not exit with zero.
+///
+static bool RunLineCount(const std::string& linecnt, const std::vector<std::string>& args)
+{
+   std::vector<char*> argv;
+   posix_spawn_file_actions_t actions;
+   pid_t pid;
+   int status;
+
+   argv.push_back(const_cast<char*>(linecnt.c_str()));
+
+   for(const std::string& arg : args)
+      argv.push_back(const_cast<char*>(arg.c_str()));
+
+   argv.push_back(nullptr);
+
+   posix_spawn_file_actions_init(&actions);
+   posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+   int error = posix_spawn(&pid, linecnt.c_str(), &actions, nullptr, argv.data(), environ);
+
+   posix_spawn_file_actions_destroy(&actions);
+
+   if(error)
+      return false;
+
+   return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void BM_CountTree(benchmark::State& state)
+{
+   const char *linecnt = getenv("LINECNT");
+
+   if(!linecnt || !*linecnt) {
+      state.SkipWithError("LINECNT must contain the path of the linecnt executable");
+      return;
+   }
+
+   std::vector<std::string> args = {
+      "-s", "-c",
+      "-d", Tree.GetRootDir(),
+      "-J", std::to_string(state.range(0)),
+      state.range(1) ? "--engine=simd" : "--engine=flex"
+   };
+
+   for(auto _ : state) {
+      if(!RunLineCount(linecnt, args)) {
+         state.SkipWithError("Cannot run linecnt");
+         break;
+      }
+   }
+
+   state.SetBytesProcessed(state.iterations() * (int64_t) Tree.GetByteCount());
+   state.counters["files/s"] = benchmark::Counter((double) (state.iterations() * Tree.GetFileCount()), benchmark::Counter::kIsRate);
+   state.counters["lines/s"] = benchmark::Counter((double) (state.iterations() * Tree.GetLineCount()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_CountTree)->Args({1, 0})->Args({1, 1})->Args({4, 0})->Args({4, 1})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
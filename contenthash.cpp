@@ -0,0 +1,108 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "contenthash.h"
+
+#include <cstring>
+
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+   return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t Read64(const unsigned char *ptr)
+{
+   uint64_t value;
+   memcpy(&value, ptr, sizeof(value));
+   return value;
+}
+
+static inline uint32_t Read32(const unsigned char *ptr)
+{
+   uint32_t value;
+   memcpy(&value, ptr, sizeof(value));
+   return value;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+   acc += input * PRIME64_2;
+   acc = RotateLeft(acc, 31);
+   return acc * PRIME64_1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+{
+   acc ^= Round(0, value);
+   return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t HashContent(const void *data, size_t length, uint64_t seed)
+{
+   const unsigned char *ptr = static_cast<const unsigned char*>(data);
+   const unsigned char *end = ptr + length;
+   uint64_t hash;
+
+   if(length >= 32) {
+      const unsigned char *limit = end - 32;
+      uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+      uint64_t v2 = seed + PRIME64_2;
+      uint64_t v3 = seed;
+      uint64_t v4 = seed - PRIME64_1;
+
+      // four independent accumulators consume 32-byte stripes
+      do {
+         v1 = Round(v1, Read64(ptr));
+         v2 = Round(v2, Read64(ptr + 8));
+         v3 = Round(v3, Read64(ptr + 16));
+         v4 = Round(v4, Read64(ptr + 24));
+         ptr += 32;
+      } while(ptr <= limit);
+
+      hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+
+      hash = MergeRound(hash, v1);
+      hash = MergeRound(hash, v2);
+      hash = MergeRound(hash, v3);
+      hash = MergeRound(hash, v4);
+   }
+   else
+      hash = seed + PRIME64_5;
+
+   hash += (uint64_t) length;
+
+   for(; end - ptr >= 8; ptr += 8) {
+      hash ^= Round(0, Read64(ptr));
+      hash = RotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+   }
+
+   if(end - ptr >= 4) {
+      hash ^= (uint64_t) Read32(ptr) * PRIME64_1;
+      hash = RotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+      ptr += 4;
+   }
+
+   for(; ptr < end; ptr++) {
+      hash ^= *ptr * PRIME64_5;
+      hash = RotateLeft(hash, 11) * PRIME64_1;
+   }
+
+   // final mix, so every input bit affects every output bit
+   hash ^= hash >> 33;
+   hash *= PRIME64_2;
+   hash ^= hash >> 29;
+   hash *= PRIME64_3;
+   hash ^= hash >> 32;
+
+   return hash;
+}
@@ -0,0 +1,24 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+///
+/// @brief  Computes a 64-bit XXH64 hash of `length` bytes in `data`.
+///
+/// This is a fast non-cryptographic hash, which is used to identify files
+/// with identical contents. Input is read in the little-endian byte order,
+/// so hash values match those of the reference implementation only on
+/// little-endian systems.
+///
+uint64_t HashContent(const void *data, size_t length, uint64_t seed = 0);
+
+#endif // CONTENTHASH_H
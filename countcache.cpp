@@ -0,0 +1,295 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "countcache.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+//
+// Journals are looked up via a thread-local pointer, so threads can add
+// entries without locking. The instance identifier prevents a thread from
+// using a journal of a cache instance that no longer exists.
+//
+static std::atomic<uint64_t> NextInstanceId(1);
+
+static thread_local uint64_t JournalInstanceId = 0;
+static thread_local void *CurrentJournal = nullptr;
+
+///
+/// @brief  Copies line counts stored in a cache record into `counts`.
+///
+static void GetRecordCounts(const uint64_t record_counts[7], CppFlexLexer::Result& counts)
+{
+   counts.linecnt = record_counts[0];
+   counts.cmntcnt = record_counts[1];
+   counts.cppcnt = record_counts[2];
+   counts.ccnt = record_counts[3];
+   counts.codecnt = record_counts[4];
+   counts.bracecnt = record_counts[5];
+   counts.emptycnt = record_counts[6];
+}
+
+CountCache::CountCache(void) :
+      instance_id(NextInstanceId++)
+{
+}
+
+bool CountCache::GetFileInfo(const std::string& filepath, file_info_t& fileinfo)
+{
+#if defined(_WIN32)
+   struct _stat64 statinfo;
+
+   if(_stat64(filepath.c_str(), &statinfo) == -1)
+      return false;
+
+   // Windows reports no inode numbers in stat calls
+   fileinfo.inode = 0;
+   fileinfo.mtime = (int64_t) statinfo.st_mtime * 1000000000;
+#else
+   struct stat statinfo;
+
+   if(stat(filepath.c_str(), &statinfo) == -1)
+      return false;
+
+   fileinfo.inode = (uint64_t) statinfo.st_ino;
+#if defined(__APPLE__)
+   fileinfo.mtime = (int64_t) statinfo.st_mtimespec.tv_sec * 1000000000 + statinfo.st_mtimespec.tv_nsec;
+#else
+   fileinfo.mtime = (int64_t) statinfo.st_mtim.tv_sec * 1000000000 + statinfo.st_mtim.tv_nsec;
+#endif
+#endif
+
+   fileinfo.size = (uint64_t) statinfo.st_size;
+
+   return true;
+}
+
+CountCache::journal_t& CountCache::GetJournal(void)
+{
+   if(JournalInstanceId != instance_id) {
+      std::lock_guard<std::mutex> lock(journals_mtx);
+
+      journals.push_back(std::make_unique<journal_t>());
+
+      JournalInstanceId = instance_id;
+      CurrentJournal = journals.back().get();
+   }
+
+   return *static_cast<journal_t*>(CurrentJournal);
+}
+
+bool CountCache::Load(const std::string& cachepath)
+{
+   file_header_t header;
+   FILE *cachefile;
+   long filesize;
+
+   records.clear();
+   filedata.clear();
+
+   if((cachefile = fopen(cachepath.c_str(), "rb")) == nullptr)
+      return false;
+
+   // read the entire file with a single read
+   if(fseek(cachefile, 0, SEEK_END) == 0 && (filesize = ftell(cachefile)) >= (long) sizeof(file_header_t) && fseek(cachefile, 0, SEEK_SET) == 0) {
+      filedata.resize((size_t) filesize);
+
+      if(fread(filedata.data(), 1, filedata.size(), cachefile) != filedata.size())
+         filedata.clear();
+   }
+
+   fclose(cachefile);
+
+   if(filedata.size() < sizeof(file_header_t))
+      return false;
+
+   memcpy(&header, filedata.data(), sizeof(file_header_t));
+
+   // a cache file written on a system with a different byte order or layout is ignored
+   if(memcmp(header.magic, "LCNT", sizeof(header.magic)) || header.byte_order != 0x01020304 ||
+         header.version != version || header.record_size != sizeof(record_t) ||
+         header.record_count > (filedata.size() - sizeof(file_header_t)) / sizeof(record_t) ||
+         header.names_size != filedata.size() - sizeof(file_header_t) - header.record_count * sizeof(record_t)) {
+      filedata.clear();
+      return false;
+   }
+
+   const char *recptr = filedata.data() + sizeof(file_header_t);
+   const char *names = recptr + header.record_count * sizeof(record_t);
+
+   records.reserve((size_t) header.record_count);
+
+   for(uint64_t index = 0; index < header.record_count; index++, recptr += sizeof(record_t)) {
+      record_t record;
+
+      memcpy(&record, recptr, sizeof(record_t));
+
+      if(record.name_offset > header.names_size || record.name_length > header.names_size - record.name_offset) {
+         records.clear();
+         filedata.clear();
+         return false;
+      }
+
+      records.emplace(std::string_view(names + record.name_offset, (size_t) record.name_length), reinterpret_cast<const record_t*>(recptr));
+   }
+
+   return true;
+}
+
+bool CountCache::Lookup(const std::string& filepath, const file_info_t& fileinfo, CppFlexLexer::Result& counts)
+{
+   record_t record;
+
+   auto iter = records.find(filepath);
+
+   if(iter == records.end())
+      return false;
+
+   // records may not be aligned in the file buffer
+   memcpy(&record, iter->second, sizeof(record_t));
+
+   if(record.fileinfo.inode != fileinfo.inode || record.fileinfo.size != fileinfo.size || record.fileinfo.mtime != fileinfo.mtime)
+      return false;
+
+   GetRecordCounts(record.counts, counts);
+
+   // keep this entry in the cache
+   Update(filepath, fileinfo, counts);
+
+   return true;
+}
+
+bool CountCache::LookupContent(const std::string& key, uint64_t& size, CppFlexLexer::Result& counts)
+{
+   record_t record;
+
+   auto iter = records.find(key);
+
+   if(iter == records.end())
+      return false;
+
+   memcpy(&record, iter->second, sizeof(record_t));
+
+   GetRecordCounts(record.counts, counts);
+
+   size = record.fileinfo.size;
+
+   Update(key, record.fileinfo, counts);
+
+   return true;
+}
+
+void CountCache::Update(const std::string& filepath, const file_info_t& fileinfo, const CppFlexLexer::Result& counts)
+{
+   GetJournal().push_back({filepath, fileinfo, counts});
+}
+
+void CountCache::Save(const std::string& cachepath)
+{
+   std::vector<const entry_t*> entries;
+   file_header_t header;
+   uint64_t names_size = 0;
+
+   for(const std::unique_ptr<journal_t>& journal : journals) {
+      for(const entry_t& entry : *journal)
+         entries.push_back(&entry);
+   }
+
+   // sort entries, so the same tree always produces the same cache file, and drop duplicates
+   std::sort(entries.begin(), entries.end(), [] (const entry_t *entry1, const entry_t *entry2) {return entry1->filepath < entry2->filepath;});
+   entries.erase(std::unique(entries.begin(), entries.end(), [] (const entry_t *entry1, const entry_t *entry2) {return entry1->filepath == entry2->filepath;}), entries.end());
+
+   memcpy(header.magic, "LCNT", sizeof(header.magic));
+   header.byte_order = 0x01020304;
+   header.version = version;
+   header.record_size = sizeof(record_t);
+   header.record_count = entries.size();
+
+   std::vector<char> cachedata(sizeof(file_header_t) + entries.size() * sizeof(record_t));
+
+   for(size_t index = 0; index < entries.size(); index++) {
+      const entry_t& entry = *entries[index];
+      record_t record;
+
+      record.fileinfo = entry.fileinfo;
+      record.counts[0] = entry.counts.linecnt;
+      record.counts[1] = entry.counts.cmntcnt;
+      record.counts[2] = entry.counts.cppcnt;
+      record.counts[3] = entry.counts.ccnt;
+      record.counts[4] = entry.counts.codecnt;
+      record.counts[5] = entry.counts.bracecnt;
+      record.counts[6] = entry.counts.emptycnt;
+      record.name_offset = names_size;
+      record.name_length = entry.filepath.length();
+
+      memcpy(cachedata.data() + sizeof(file_header_t) + index * sizeof(record_t), &record, sizeof(record_t));
+
+      names_size += entry.filepath.length();
+   }
+
+   header.names_size = names_size;
+
+   memcpy(cachedata.data(), &header, sizeof(file_header_t));
+
+   cachedata.reserve(cachedata.size() + (size_t) names_size);
+
+   for(const entry_t *entry : entries)
+      cachedata.insert(cachedata.end(), entry->filepath.begin(), entry->filepath.end());
+
+   //
+   // Write a temporary file next to the cache file, so it's on the same
+   // file system, and rename it over the cache file.
+   //
+#if defined(_WIN32)
+   std::string temppath = cachepath + "." + std::to_string(_getpid()) + ".tmp";
+#else
+   std::string temppath = cachepath + "." + std::to_string(getpid()) + ".tmp";
+#endif
+
+   FILE *tempfile;
+
+   if((tempfile = fopen(temppath.c_str(), "wb")) == nullptr)
+      throw std::system_error(errno, std::system_category(), "Cannot create a cache file " + temppath);
+
+   bool written = fwrite(cachedata.data(), 1, cachedata.size(), tempfile) == cachedata.size() && fflush(tempfile) == 0;
+
+#if !defined(_WIN32)
+   // make sure data is on disk before the file is renamed
+   written = written && fsync(fileno(tempfile)) == 0;
+#endif
+
+   if(fclose(tempfile) != 0 || !written) {
+      remove(temppath.c_str());
+      throw std::runtime_error("Cannot write a cache file " + temppath);
+   }
+
+#if defined(_WIN32)
+   if(!MoveFileExA(temppath.c_str(), cachepath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+   if(rename(temppath.c_str(), cachepath.c_str()) != 0) {
+#endif
+      remove(temppath.c_str());
+      throw std::runtime_error("Cannot replace a cache file " + cachepath);
+   }
+}
@@ -0,0 +1,140 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef COUNTCACHE_H
+#define COUNTCACHE_H
+
+#include "cpplexer.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+///
+/// @brief  A persistent cache of line counts of source files, keyed by
+///         file paths and identified by file attributes.
+///
+/// A cached entry is used only if the file's inode, size and modification
+/// time are the same as when the file was counted. The cache file is read
+/// into memory with a single read and entries are looked up in place.
+///
+/// Only entries for files that are looked up or updated in the current run
+/// are saved, so files that no longer exist are dropped from the cache. The
+/// cache file is replaced atomically, so an interrupted run never leaves a
+/// partially written cache behind.
+///
+/// Lookups and updates may be called concurrently from multiple threads.
+/// Loading and saving the cache must not be concurrent with any other calls.
+///
+class CountCache {
+   public:
+      ///
+      /// @brief  File attributes that identify a specific version of a file.
+      ///
+      struct file_info_t {
+         uint64_t    inode = 0;              ///< File serial number (zero on Windows).
+         uint64_t    size = 0;               ///< File size, in bytes.
+         int64_t     mtime = 0;              ///< Modification time, in nanoseconds since the epoch.
+      };
+
+   private:
+      ///
+      /// @brief  Cache file header.
+      ///
+      struct file_header_t {
+         char        magic[4];               ///< Always `LCNT`.
+         uint32_t    byte_order;             ///< Always `0x01020304` in the byte order of the writer.
+         uint32_t    version;                ///< File format version.
+         uint32_t    record_size;            ///< Size of `record_t`, in bytes.
+         uint64_t    record_count;           ///< Number of records following the header.
+         uint64_t    names_size;             ///< Size of the name block following all records.
+      };
+
+      ///
+      /// @brief  Cache file record, which refers to a file path in the name
+      ///         block.
+      ///
+      struct record_t {
+         file_info_t fileinfo;               ///< File attributes when the file was counted.
+         uint64_t    counts[7];              ///< Line counts, in the order of `CppFlexLexer::Result` fields.
+         uint64_t    name_offset;            ///< Offset of the file path in the name block.
+         uint64_t    name_length;            ///< Length of the file path, in bytes.
+      };
+
+      ///
+      /// @brief  An entry looked up or updated in the current run.
+      ///
+      struct entry_t {
+         std::string             filepath;   ///< File path.
+         file_info_t             fileinfo;   ///< File attributes when the file was counted.
+         CppFlexLexer::Result    counts;     ///< Line counts.
+      };
+
+      /// Entries from one thread, which are combined only when the cache is saved.
+      typedef std::vector<entry_t> journal_t;
+
+   private:
+      static constexpr uint32_t  version = 1;            ///< Current file format version.
+
+      std::vector<char>    filedata;         ///< Contents of the loaded cache file.
+
+      std::unordered_map<std::string_view, const record_t*> records; ///< Loaded records, keyed by path in `filedata`.
+
+      std::vector<std::unique_ptr<journal_t>> journals;  ///< Per-thread entries for the current run.
+      std::mutex           journals_mtx;     ///< Protects `journals`.
+
+      uint64_t             instance_id;      ///< Identifies per-thread journals of this instance.
+
+   private:
+      /// Returns the entry journal of the calling thread, creating one if needed.
+      journal_t& GetJournal(void);
+
+   public:
+      CountCache(void);
+
+      CountCache(const CountCache&) = delete;
+
+      CountCache& operator = (const CountCache&) = delete;
+
+      ///
+      /// @brief  Loads the cache file. Returns `false` if the file does not
+      ///         exist or is not a valid cache file.
+      ///
+      bool Load(const std::string& cachepath);
+
+      ///
+      /// @brief  Writes all entries looked up or updated in the current run
+      ///         into a temporary file and replaces the cache file with it.
+      ///
+      void Save(const std::string& cachepath);
+
+      ///
+      /// @brief  Looks up cached line counts for a file that has the same
+      ///         attributes as when it was counted and, if found, keeps
+      ///         the entry for the current run.
+      ///
+      bool Lookup(const std::string& filepath, const file_info_t& fileinfo, CppFlexLexer::Result& counts);
+
+      ///
+      /// @brief  Looks up cached line counts for contents identified by `key`,
+      ///         such as a Git blob identifier, regardless of attributes,
+      ///         and returns the size stored with them in `size`.
+      ///
+      bool LookupContent(const std::string& key, uint64_t& size, CppFlexLexer::Result& counts);
+
+      /// Adds or replaces line counts for the file in the current run.
+      void Update(const std::string& filepath, const file_info_t& fileinfo, const CppFlexLexer::Result& counts);
+
+      /// Returns file attributes used to identify cached entries.
+      static bool GetFileInfo(const std::string& filepath, file_info_t& fileinfo);
+};
+
+#endif // COUNTCACHE_H
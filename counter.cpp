@@ -0,0 +1,992 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#if defined(_WIN32)
+#include <io.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "counter.h"
+#include "dfalexer.h"
+#include "runstats.h"
+#include "workerpool.h"
+#if !defined(_WIN32)
+#include "mappedfile.h"
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <unordered_set>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(_WIN32)
+#define stricmp _stricmp
+#else
+#include <strings.h>
+#define stricmp strcasecmp
+#endif
+
+//
+// Platform-specific directory name separator
+//
+#if defined(_WIN32)
+#define DIRSEP "\\"
+#else
+#define DIRSEP "/"
+#endif
+
+///
+/// @brief  A directory in a tree or a group of listed files in a single
+///         directory, which is processed by worker threads.
+///
+struct Counter::dir_node_t {
+   struct file_t {
+      Totals                  totals;     // line counts and size of this file
+      std::exception_ptr      error;      // an exception thrown while counting this file
+   };
+
+   std::string             dirpath;       // path of this directory
+   NameList                filenames;     // file names, no separators, under dirpath
+   std::vector<file_t>     files;         // results of files in the same order as filenames
+   std::vector<std::unique_ptr<dir_node_t>> subdirs;  // sub-directories in the order they were enumerated
+   std::exception_ptr      error;         // an exception thrown while enumerating this directory
+   std::atomic<size_t>     pending {1};   // directory enumeration plus files that haven't been counted yet
+};
+
+//
+// When worker threads are used, directories are enumerated and files are
+// counted in any order, but results are reported and added to totals in
+// the same order as if the tree was walked on a single thread.
+//
+// Tasks submit further tasks to the pool that runs them, which is owned
+// by the function walking the tree and must be declared after all data
+// used by worker threads, so it's destroyed first, discarding queued
+// tasks and waiting for running ones, if an exception is thrown.
+//
+struct Counter::tree_walk_t {
+   const tree_options_t&   tree_options;  // options of the tree or the file list
+   size_t                  root_length;   // length of the root path, which is not matched against path patterns
+   WorkerPool              *workers;      // pool running tasks of this walk
+   std::mutex              node_mtx;      // used only to wait for directory nodes to complete
+   std::condition_variable node_cv;       // signaled when a directory node completes
+
+   tree_walk_t(const tree_options_t& arg_tree_options, size_t arg_root_length) :
+         tree_options(arg_tree_options),
+         root_length(arg_root_length),
+         workers(nullptr)
+   {
+   }
+};
+
+bool Counter::less_stricmp_t::operator () (const std::string& str1, const std::string& str2) const
+{
+   return stricmp(str1.c_str(), str2.c_str()) < 0;
+}
+
+///
+/// @brief  Converts ASCII upper case letters in 8 characters packed into
+///         `chars` to lower case, without branches.
+///
+static uint64_t FoldCase(uint64_t chars)
+{
+   // the high bit of each byte is set if a character is greater than Z and, separately, not less than A
+   uint64_t lowbits = chars & 0x7F7F7F7F7F7F7F7Full;
+   uint64_t above_z = lowbits + 0x2525252525252525ull;
+   uint64_t from_a = lowbits + 0x3F3F3F3F3F3F3F3Full;
+   uint64_t upper = (from_a ^ above_z) & ~chars & 0x8080808080808080ull;
+
+   // move the high bit of each upper case letter to the case bit
+   return chars | (upper >> 2);
+}
+
+///
+/// @brief  Returns the table index of an extension key, which is the top
+///         bits of its multiplicative hash above `shift`.
+///
+static size_t HashExtension(const uint64_t key[2], unsigned int shift)
+{
+   return (size_t) (((key[0] ^ key[1] * 0xC2B2AE3D27D4EB4Full) * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+Counter::Counter(void)
+{
+   BuildExtensionTable();
+}
+
+Counter::Counter(const options_t& arg_options) :
+      options(arg_options)
+{
+   BuildExtensionTable();
+}
+
+///
+/// The table has at least twice as many slots as there are extensions,
+/// so probe sequences are short, and is rebuilt whenever extensions are
+/// added, which happens only while a counter is being configured.
+///
+void Counter::BuildExtensionTable(void)
+{
+   size_t slot_count = 16;
+
+   while(slot_count < extensions.size() * 2)
+      slot_count *= 2;
+
+   ext_table.assign(slot_count, ext_slot_t());
+   ext_shift = 64;
+   ext_max_length = 0;
+
+   for(size_t count = slot_count; count > 1; count /= 2)
+      ext_shift--;
+
+   for(const auto& extension : extensions) {
+      size_t length = extension.first.length();
+
+      ext_max_length = std::max(ext_max_length, length);
+
+      // longer extensions are looked up in the extension set
+      if(length > ext_key_size)
+         continue;
+
+      ext_slot_t slot = {};
+
+      memcpy(slot.key, extension.first.data(), length);
+
+      slot.key[0] = FoldCase(slot.key[0]);
+      slot.key[1] = FoldCase(slot.key[1]);
+      slot.language = extension.second;
+
+      size_t index = HashExtension(slot.key, ext_shift);
+
+      while(ext_table[index].language)
+         index = (index + 1) & (slot_count - 1);
+
+      ext_table[index] = slot;
+   }
+}
+
+void Counter::AddExtension(const char *ext, const language_t& language)
+{
+   extensions.emplace(ext, &language);
+
+   BuildExtensionTable();
+}
+
+void Counter::AddLanguage(const language_t& language)
+{
+   for(const char *ext : language.extensions)
+      extensions.emplace(ext, &language);
+
+   BuildExtensionTable();
+}
+
+std::vector<std::string> Counter::GetExtensions(void) const
+{
+   std::vector<std::string> extlist;
+
+   extlist.reserve(extensions.size());
+
+   for(const auto& extension : extensions)
+      extlist.push_back(extension.first);
+
+   return extlist;
+}
+
+///
+/// The extension is copied into a zero-padded key and its case is folded
+/// a word at a time, so looking up an extension takes the same time and
+/// makes no memory allocations, regardless of how many extensions there
+/// are. Extensions are matched by comparing two words.
+///
+const language_t *Counter::FindFileLanguage(const char *filename) const
+{
+   const char *ext = strrchr(filename, '.');
+
+   if(!ext)
+      return nullptr;
+
+   size_t length = strlen(++ext);
+
+   if(length > ext_max_length)
+      return nullptr;
+
+   if(length > ext_key_size) {
+      auto iter = extensions.find(ext);
+      return iter != extensions.end() ? iter->second : nullptr;
+   }
+
+   uint64_t key[2] = {};
+
+   memcpy(key, ext, length);
+
+   key[0] = FoldCase(key[0]);
+   key[1] = FoldCase(key[1]);
+
+   size_t index = HashExtension(key, ext_shift);
+
+   // the table is never full, so each probe sequence ends with an empty slot
+   for(;;) {
+      const ext_slot_t& slot = ext_table[index];
+
+      if(!slot.language || (slot.key[0] == key[0] && slot.key[1] == key[1]))
+         return slot.language;
+
+      index = (index + 1) & (ext_table.size() - 1);
+   }
+}
+
+bool Counter::IsSourceFile(const char *filename) const
+{
+   return FindFileLanguage(filename) != nullptr;
+}
+
+const language_t& Counter::GetFileLanguage(const char *filename) const
+{
+   return *FindFileLanguage(filename);
+}
+
+///
+/// Only the automaton can start counting in the middle of a source, so
+/// large C-like sources are split into chunks with the Flex and automaton
+/// engines. The SIMD lexer is fast enough to count them in one piece.
+///
+size_t Counter::GetChunkCount(uint64_t length, SimdLexer::profile_t profile) const
+{
+   if(options.engine == ENGINE_SIMD || profile != SimdLexer::PROFILE_C || !options.chunk_size || options.chunk_jobs <= 1)
+      return 1;
+
+   return (size_t) std::max(std::min(length / options.chunk_size, (uint64_t) options.chunk_jobs), (uint64_t) 1);
+}
+
+///
+/// The Flex scanner and the automaton implement only the C profile, so
+/// sources in other languages are always counted with the SIMD lexer.
+/// Large sources are counted with the automaton in chunks, which
+/// produces the same counts as any other engine.
+///
+CppFlexLexer::Result Counter::LexBuffer(char *buffer, size_t length, SimdLexer::profile_t profile) const
+{
+   RunStats::PhaseTimer timer(options.stats, RunStats::PHASE_LEX);
+
+   size_t chunk_count = GetChunkCount(length, profile);
+
+   if(chunk_count > 1)
+      return DfaLexer(std::string_view(buffer, length)).CountLines(chunk_count);
+
+   if(options.engine == ENGINE_SIMD || profile != SimdLexer::PROFILE_C)
+      return SimdLexer(std::string_view(buffer, length), profile).CountLines();
+
+   if(options.engine == ENGINE_DFA)
+      return DfaLexer(std::string_view(buffer, length)).CountLines();
+
+   CppFlexLexer cpplex(buffer, length);
+
+   return cpplex.CountLines();
+}
+
+CppFlexLexer::Result Counter::CountBuffer(const std::string_view& source, const language_t& language) const
+{
+   // the size of this buffer is its capacity and it is never shrunk
+   static thread_local std::string buffer;
+
+   if(buffer.length() < source.length() + 2)
+      buffer.resize(source.length() + 2);
+
+   // two zero characters are required by the Flex scanner
+   source.copy(buffer.data(), source.length());
+   buffer[source.length()] = buffer[source.length() + 1] = '\0';
+
+   return LexBuffer(buffer.data(), source.length(), language.profile);
+}
+
+///
+/// The buffer is sized from the file size and only grows, so once it
+/// fits the largest file, reading files makes no memory allocations.
+/// The stream is unbuffered because it is read in blocks directly into
+/// the buffer. All engines scan the buffer in place.
+///
+Totals Counter::ReadStream(FILE* &&srcfile, const char *filepath, const buffer_counter_t& count) const
+{
+   // the size of this buffer is its capacity and it is never shrunk
+   static thread_local std::string source;
+   uint64_t filesize = 0;
+   size_t length = 0;
+   size_t bytes;
+
+#if defined(_WIN32)
+   struct _stat64 statinfo;
+
+   if(_fstat64(_fileno(srcfile), &statinfo) == 0)
+      filesize = (uint64_t) statinfo.st_size;
+#else
+   struct stat statinfo;
+
+   if(fstat(fileno(srcfile), &statinfo) == 0)
+      filesize = (uint64_t) statinfo.st_size;
+#endif
+
+   RunStats::PhaseTimer timer(options.stats, RunStats::PHASE_READ);
+
+   setvbuf(srcfile, nullptr, _IONBF, 0);
+
+   // one extra character lets the end of file be detected without another read
+   if(source.length() < filesize + 3)
+      source.resize((size_t) filesize + 3);
+
+   // two zero characters are required by the Flex scanner, so they are never read into
+   while((bytes = fread(source.data() + length, 1, source.length() - 2 - length, srcfile)) != 0) {
+      length += bytes;
+
+      // files may grow after they are looked up
+      if(length == source.length() - 2)
+         source.resize(source.length() * 2);
+   }
+
+   if(ferror(srcfile)) {
+      fclose(srcfile);
+      throw std::runtime_error(std::string("Cannot read file ") + filepath);
+   }
+
+   fclose(srcfile);
+
+   timer.Stop();
+
+   source[length] = source[length + 1] = '\0';
+
+   return count(source.data(), length);
+}
+
+#if !defined(_WIN32)
+///
+/// Small files are read via a file stream because mapping a file costs
+/// more than copying a few pages of data through a stream buffer.
+///
+Totals Counter::ReadMappedFile(const char *filepath, const buffer_counter_t& count) const
+{
+   struct stat statinfo;
+   FILE *srcfile;
+   int fd;
+
+   RunStats::PhaseTimer open_timer(options.stats, RunStats::PHASE_OPEN);
+
+   if((fd = open(filepath, O_RDONLY)) == -1)
+      throw std::system_error(errno, std::system_category(), filepath);
+
+   bool map_file = fstat(fd, &statinfo) == 0 && S_ISREG(statinfo.st_mode) && (size_t) statinfo.st_size >= options.map_min_size;
+
+   open_timer.Stop();
+
+   if(map_file) {
+      // pages are read when they are first accessed, so mapping only sets up the address range
+      RunStats::PhaseTimer map_timer(options.stats, RunStats::PHASE_OPEN);
+
+      MappedFile srcmap(std::move(fd), (size_t) statinfo.st_size);
+
+      map_timer.Stop();
+
+      return count(srcmap.GetData(), srcmap.GetLength());
+   }
+
+   if((srcfile = fdopen(fd, "r")) == nullptr) {
+      int error = errno;
+      close(fd);
+      throw std::system_error(error, std::system_category(), filepath);
+   }
+
+   return ReadStream(std::move(srcfile), filepath, count);
+}
+#endif
+
+Totals Counter::ReadFile(const char *filepath, const buffer_counter_t& count) const
+{
+   FILE *srcfile;
+
+#if !defined(_WIN32)
+   if(options.map_min_size)
+      return ReadMappedFile(filepath, count);
+#endif
+
+   RunStats::PhaseTimer timer(options.stats, RunStats::PHASE_OPEN);
+
+   srcfile = fopen(filepath, "r");
+
+   if(srcfile == nullptr)
+      throw std::system_error(errno, std::system_category(), filepath);
+
+   timer.Stop();
+
+   return ReadStream(std::move(srcfile), filepath, count);
+}
+
+///
+/// Files are read with `ReadFile`, unless the lookup hook finds their
+/// totals without reading them, such as in a cache, or reads them some
+/// other way, such as from a queue of files read ahead.
+///
+Totals Counter::CountSourceFile(const std::string& filepath, const language_t& language, const tree_options_t& tree_options) const
+{
+   std::chrono::steady_clock::time_point start_time;
+
+   if(options.stats)
+      start_time = std::chrono::steady_clock::now();
+
+   auto read = [this, &filepath, &language, &tree_options] (void)
+   {
+      return ReadFile(filepath.c_str(), [this, &language, &tree_options] (char *buffer, size_t length)
+      {
+         if(tree_options.count_buffer)
+            return tree_options.count_buffer(buffer, length, language);
+
+         Totals totals;
+
+         totals.filecnt = 1;
+         totals.bytecnt = length;
+         totals.lines = LexBuffer(buffer, length, language.profile);
+
+         return totals;
+      });
+   };
+
+   Totals totals = tree_options.lookup ? tree_options.lookup(filepath, language, read) : read();
+
+   // cached files are not read, so they are not included in file times and sizes
+   if(options.stats && !totals.cachedcnt)
+      options.stats->AddFile(filepath, totals.bytecnt, (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count());
+
+   return totals;
+}
+
+Totals Counter::CountFile(const std::string& filepath) const
+{
+   static const tree_options_t no_hooks;
+
+#if defined(_WIN32)
+   size_t sep = filepath.find_last_of("\\/");
+#else
+   size_t sep = filepath.rfind('/');
+#endif
+   const char *filename = filepath.c_str() + (sep == std::string::npos ? 0 : sep + 1);
+   const char *ext = strrchr(filename, '.');
+
+   // files with extensions that are not listed are counted in the language of their extension
+   return CountSourceFile(filepath, IsSourceFile(filename) ? GetFileLanguage(filename) : GetExtensionLanguage(ext ? ext + 1 : ""), no_hooks);
+}
+
+///
+/// On POSIX systems, entry types reported by `readdir` are used when
+/// available and entries are looked up only if their type is unknown
+/// or if they are symbolic links, which need to be followed to tell
+/// whether they point to a directory. Entries that would be ignored
+/// whether they are directories or not are never looked up.
+///
+/// The path filter state of the directory is computed once, in a list
+/// reused by the calling thread, and entries are matched against it
+/// only if they would be kept otherwise.
+///
+/// On POSIX systems, files and sub-directories are sorted by their inode
+/// numbers, which usually follow the order in which inodes are laid out
+/// on disk, so files are opened with fewer seeks than in the order of
+/// `readdir`, which is a hash order on many file systems.
+///
+void Counter::EnumDirectory(const std::string& dirname, const std::string_view& relpath, NameList& files, NameList& subdirs) const
+{
+   RunStats::PhaseTimer timer(options.stats, RunStats::PHASE_ENUM);
+
+   static thread_local PathFilter::dir_state_t dir_state;
+   bool filtered = !path_filter.IsEmpty();
+
+   files.Clear();
+   subdirs.Clear();
+
+   if(filtered)
+      path_filter.EnterDirectory(relpath, dir_state);
+
+#if defined(_WIN32)
+   struct _finddata_t fileinfo;
+   intptr_t fhandle;
+
+   // get all files and directories, except current and parent directories
+   std::string dirpat(dirname + DIRSEP + "*.*");
+
+   if((fhandle = _findfirst(dirpat.c_str(), &fileinfo)) == -1)
+      throw std::system_error(errno, std::system_category(), "Cannot enumerate directory: " + dirname);
+
+   do {
+      if(fileinfo.attrib & _A_SUBDIR) {
+         if(IsSkippedDirectory(fileinfo.name))
+            continue;
+
+         if(*fileinfo.name && (!filtered || !path_filter.IsExcluded(dir_state, fileinfo.name, true)))
+            subdirs.Add(fileinfo.name);
+         continue;
+      }
+
+      if(*fileinfo.name && IsSourceFile(fileinfo.name) && (!filtered || !path_filter.IsExcluded(dir_state, fileinfo.name, false)))
+         files.Add(fileinfo.name);
+
+   } while(_findnext(fhandle, &fileinfo) == 0);
+
+   _findclose(fhandle);
+#else
+   DIR *dir;
+   struct dirent *entry;
+   struct stat statinfo;
+
+   if((dir = opendir(dirname.c_str())) == nullptr) 
+      throw std::system_error(errno, std::system_category(), "Cannot open directory: " + dirname);
+
+   while ((entry = readdir(dir)) != nullptr) {
+      bool is_dir;
+
+      if(!*entry->d_name)
+         continue;
+
+      // check the extension first, so we don't look up entries that will be ignored
+      bool is_source = IsSourceFile(entry->d_name);
+
+#if defined(DT_DIR)
+      if(entry->d_type == DT_DIR)
+         is_dir = true;
+      else if(entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+         is_dir = false;
+      else
+#endif
+      {
+         // a name starting with a period is ignored, either as a directory or as a non-source file
+         if(!is_source && IsSkippedDirectory(entry->d_name))
+            continue;
+
+         // look up the entry relative to the open directory, following symbolic links
+         if(fstatat(dirfd(dir), entry->d_name, &statinfo, 0) == -1) {
+            int error = errno;
+
+            closedir(dir);
+            throw std::system_error(error, std::system_category(), "Cannot stat directory: " + dirname);
+         }
+
+         is_dir = S_ISDIR(statinfo.st_mode);
+      }
+
+      if(is_dir) {
+         if(IsSkippedDirectory(entry->d_name))
+            continue;
+
+         // excluded sub-directories are pruned here, so they are never opened
+         if(filtered && path_filter.IsExcluded(dir_state, entry->d_name, true))
+            continue;
+
+         subdirs.Add(entry->d_name, (uint64_t) entry->d_ino);
+         continue;
+      }
+
+      if(is_source && (!filtered || !path_filter.IsExcluded(dir_state, entry->d_name, false)))
+         files.Add(entry->d_name, (uint64_t) entry->d_ino);
+   }
+
+   closedir(dir);
+
+   files.SortByKey();
+   subdirs.SortByKey();
+#endif
+}
+
+void Counter::CountDirFiles(const std::string& dirpath, const NameList& files, const tree_options_t& tree_options, const file_callback_t& callback, Totals& totals) const
+{
+   // file paths are composed in a buffer reused by the calling thread
+   static thread_local std::string filepath;
+
+   if(files.IsEmpty())
+      return;
+
+   if(tree_options.prefetch)
+      tree_options.prefetch(dirpath, files);
+
+   for(size_t index = 0; index < files.GetCount(); index++) {
+      const language_t& language = GetFileLanguage(files[index]);
+
+      filepath.assign(dirpath).append(DIRSEP).append(files[index]);
+
+      Totals file = CountSourceFile(filepath, language, tree_options);
+
+      if(callback)
+         callback(dirpath, files[index], language, file);
+
+      totals += file;
+   }
+}
+
+void Counter::CompleteDirTask(tree_walk_t& walk, dir_node_t& node)
+{
+   if(--node.pending == 0) {
+      // lock the mutex, so the reporting thread cannot miss the notification
+      std::lock_guard<std::mutex> lock(walk.node_mtx);
+      walk.node_cv.notify_one();
+   }
+}
+
+void Counter::CountFileTask(tree_walk_t& walk, dir_node_t& node, size_t index) const
+{
+   static thread_local std::string filepath;
+
+   dir_node_t::file_t& file = node.files[index];
+
+   try {
+      filepath.assign(node.dirpath).append(DIRSEP).append(node.filenames[index]);
+
+      file.totals = CountSourceFile(filepath, GetFileLanguage(node.filenames[index]), walk.tree_options);
+   }
+   catch (...) {
+      file.error = std::current_exception();
+   }
+
+   CompleteDirTask(walk, node);
+}
+
+///
+/// Tasks are queued in reverse order because each worker runs its own
+/// tasks last-in-first-out, so files are counted in the order they are
+/// listed, while idle workers steal the last ones. The node must count
+/// one pending task of its own, which is completed by the caller.
+///
+void Counter::QueueFileTasks(tree_walk_t& walk, dir_node_t& node) const
+{
+   node.pending += node.files.size();
+
+   for(size_t index = node.files.size(); index > 0; index--) {
+      dir_node_t *parent = &node;
+      walk.workers->Submit([this, &walk, parent, index] (size_t) {CountFileTask(walk, *parent, index - 1);});
+   }
+}
+
+///
+/// Sub-directory tasks are queued before file tasks, so this worker will
+/// count files first, in the order they were enumerated, while idle
+/// workers steal enumeration of the last sub-directories, which are
+/// reported last.
+///
+void Counter::EnumDirectoryTask(tree_walk_t& walk, dir_node_t& node) const
+{
+   try {
+      // names are collected in lists reused by this thread and file names are copied into the node in one piece
+      static thread_local NameList files;
+      static thread_local NameList subdirs;
+      std::vector<std::unique_ptr<dir_node_t>> subdir_list;
+
+      EnumDirectory(node.dirpath, std::string_view(node.dirpath).substr(walk.root_length), files, subdirs);
+
+      if(walk.tree_options.recursive) {
+         subdir_list.reserve(subdirs.GetCount());
+
+         for(size_t index = 0; index < subdirs.GetCount(); index++) {
+            subdir_list.push_back(std::make_unique<dir_node_t>());
+            subdir_list.back()->dirpath.assign(node.dirpath).append(DIRSEP).append(subdirs[index]);
+         }
+      }
+
+      node.filenames = files;
+      node.files.resize(node.filenames.GetCount());
+      node.subdirs = std::move(subdir_list);
+
+      if(walk.tree_options.prefetch && !files.IsEmpty())
+         walk.tree_options.prefetch(node.dirpath, node.filenames);
+   }
+   catch (...) {
+      node.error = std::current_exception();
+   }
+
+   for(size_t index = node.subdirs.size(); index > 0; index--) {
+      dir_node_t *subdir = node.subdirs[index - 1].get();
+      walk.workers->Submit([this, &walk, subdir] (size_t) {EnumDirectoryTask(walk, *subdir);});
+   }
+
+   QueueFileTasks(walk, node);
+
+   CompleteDirTask(walk, node);
+}
+
+///
+/// If enumerating the directory or counting any of its files failed, the
+/// exception is rethrown here, so errors are reported in the same order
+/// as they would be without worker threads.
+///
+void Counter::ReportDirNode(tree_walk_t& walk, dir_node_t& node, const file_callback_t& callback, Totals& totals) const
+{
+   {
+      std::unique_lock<std::mutex> lock(walk.node_mtx);
+      walk.node_cv.wait(lock, [&node] {return node.pending == 0;});
+   }
+
+   if(node.error)
+      std::rethrow_exception(node.error);
+
+   for(size_t index = 0; index < node.files.size(); index++) {
+      const dir_node_t::file_t& file = node.files[index];
+
+      if(file.error)
+         std::rethrow_exception(file.error);
+
+      if(callback)
+         callback(node.dirpath, node.filenames[index], GetFileLanguage(node.filenames[index]), file.totals);
+
+      totals += file.totals;
+   }
+
+   // file names and counts are no longer needed
+   std::vector<dir_node_t::file_t>().swap(node.files);
+   node.filenames = NameList();
+}
+
+///
+/// Worker threads enumerate directories and count files concurrently,
+/// while this thread walks the directory tree depth-first, as it would
+/// be walked without worker threads, waiting for each directory to be
+/// processed before reporting it.
+///
+Totals Counter::CountTreeJobs(const std::string& dirname, const tree_options_t& tree_options, const file_callback_t& callback) const
+{
+   // processing state of a directory node
+   struct state_t {
+      dir_node_t  *node;                  // directory node being reported
+      size_t      next;                   // next sub-directory node to report
+   };
+
+   dir_node_t root;
+   std::vector<state_t> stack;
+   tree_walk_t walk(tree_options, dirname.length());
+   Totals totals;
+
+   root.dirpath = dirname;
+
+   // declared after the tree, so tasks using it are discarded or finished if an exception is thrown
+   WorkerPool workers(tree_options.jobs);
+
+   walk.workers = &workers;
+
+   workers.Submit([this, &walk, &root] (size_t) {EnumDirectoryTask(walk, root);});
+
+   totals.dircnt = 1;
+
+   ReportDirNode(walk, root, callback, totals);
+
+   stack.push_back({&root, 0});
+
+   while(!stack.empty()) {
+      state_t& state = stack.back();
+
+      // release sub-directory nodes after all of them have been reported
+      if(state.next == state.node->subdirs.size()) {
+         state.node->subdirs.clear();
+         stack.pop_back();
+         continue;
+      }
+
+      dir_node_t& subdir = *state.node->subdirs[state.next++];
+
+      totals.dircnt++;
+
+      ReportDirNode(walk, subdir, callback, totals);
+
+      stack.push_back({&subdir, 0});
+   }
+
+   workers.Stop();
+
+   return totals;
+}
+
+///
+/// The tree is walked depth-first with a name list for each level of
+/// the tree, which is reused for all directories at that depth, and file
+/// paths are composed in a single buffer.
+///
+Totals Counter::CountTree(const std::string& dirname, const tree_options_t& tree_options, const file_callback_t& callback) const
+{
+   if(tree_options.jobs > 1)
+      return CountTreeJobs(dirname, tree_options, callback);
+
+   // processing state of a level of the tree
+   struct level_t {
+      NameList    subdirs;                // sub-directory names, no separators
+      size_t      next = 0;               // next sub-directory to process
+      size_t      dirpath_length = 0;     // length of the path of the parent of subdirs
+   };
+
+   std::vector<level_t> levels(1);
+   size_t depth = 0;
+   std::string dirpath = dirname;
+   NameList files;
+   Totals totals;
+
+   totals.dircnt = 1;
+
+   EnumDirectory(dirpath, std::string_view(), files, levels[0].subdirs);
+
+   CountDirFiles(dirpath, files, tree_options, callback, totals);
+
+   if(!tree_options.recursive)
+      return totals;
+
+   levels[0].dirpath_length = dirpath.length();
+
+   for(;;) {
+      level_t& level = levels[depth];
+
+      // return to the parent level after all sub-directories have been processed
+      if(level.next == level.subdirs.GetCount()) {
+         if(depth == 0)
+            return totals;
+
+         depth--;
+         continue;
+      }
+
+      totals.dircnt++;
+
+      // replace the last processed directory at this level with the new one
+      dirpath.resize(level.dirpath_length);
+      dirpath.append(DIRSEP).append(level.subdirs[level.next++]);
+
+      // the level reference is not used after this, so it's safe to add a level
+      if(++depth == levels.size())
+         levels.emplace_back();
+
+      level_t& sublevel = levels[depth];
+
+      sublevel.next = 0;
+      sublevel.dirpath_length = dirpath.length();
+
+      EnumDirectory(dirpath, std::string_view(dirpath).substr(dirname.length()), files, sublevel.subdirs);
+
+      CountDirFiles(dirpath, files, tree_options, callback, totals);
+   }
+}
+
+///
+/// Without worker threads, files of each directory are counted as soon
+/// as the list moves on to another directory. With worker threads, all
+/// groups of files are queued first and are reported in order as they
+/// are completed.
+///
+/// Groups are queued in reverse order because tasks submitted from this
+/// thread are distributed between workers, which run tasks in their own
+/// queues last-in-first-out, so earlier groups are counted first.
+///
+Totals Counter::CountFileList(const std::string& basedir, const std::vector<std::string>& paths, const tree_options_t& tree_options, const file_callback_t& callback) const
+{
+   std::unordered_set<std::string> dirs;
+   std::vector<std::unique_ptr<dir_node_t>> nodes;
+   std::string dirpath;
+   NameList files;
+   Totals totals;
+
+   // counts files collected for dirpath or, with worker threads, queues them in a new node
+   auto flush_files = [&] ()
+   {
+      if(files.IsEmpty())
+         return;
+
+      if(tree_options.jobs <= 1) {
+         CountDirFiles(dirpath, files, tree_options, callback, totals);
+         files.Clear();
+         return;
+      }
+
+      nodes.push_back(std::make_unique<dir_node_t>());
+      nodes.back()->dirpath = dirpath;
+      nodes.back()->files.resize(files.GetCount());
+      nodes.back()->filenames = std::move(files);
+
+      files.Clear();
+   };
+
+   for(const std::string& path : paths) {
+#if defined(_WIN32)
+      size_t sep = path.find_last_of("\\/");
+      bool relative = !strchr("\\/", path[0]) && (path.length() < 2 || path[1] != ':');
+#else
+      size_t sep = path.rfind('/');
+      bool relative = path[0] != '/';
+#endif
+
+      if(!IsSourceFile(path.c_str() + (sep == std::string::npos ? 0 : sep + 1)))
+         continue;
+
+      // listed paths are matched as they are, relative to the starting directory if they are relative
+      if(path_filter.IsPathExcluded(path, false))
+         continue;
+
+      std::string filedir = sep == std::string::npos ? std::string(".") : path.substr(0, sep);
+
+      if(relative && !basedir.empty())
+         filedir = sep == std::string::npos ? basedir : basedir + DIRSEP + filedir;
+
+      // consecutive files in the same directory are reported together
+      if(filedir != dirpath) {
+         flush_files();
+
+         dirpath = std::move(filedir);
+
+         if(dirs.insert(dirpath).second)
+            totals.dircnt++;
+      }
+
+      files.Add(sep == std::string::npos ? std::string_view(path) : std::string_view(path).substr(sep + 1));
+   }
+
+   flush_files();
+
+   if(nodes.empty())
+      return totals;
+
+   tree_walk_t walk(tree_options, 0);
+
+   // if an exception is thrown, queued tasks are discarded and running ones are finished before nodes are released
+   WorkerPool workers(tree_options.jobs);
+
+   walk.workers = &workers;
+
+   for(size_t index = nodes.size(); index > 0; index--) {
+      dir_node_t *node = nodes[index - 1].get();
+
+      workers.Submit([this, &walk, node] (size_t) {
+         try {
+            if(walk.tree_options.prefetch)
+               walk.tree_options.prefetch(node->dirpath, node->filenames);
+         }
+         catch (...) {
+            node->error = std::current_exception();
+         }
+
+         QueueFileTasks(walk, *node);
+         CompleteDirTask(walk, *node);
+      });
+   }
+
+   for(std::unique_ptr<dir_node_t>& node : nodes) {
+      ReportDirNode(walk, *node, callback, totals);
+      node.reset();
+   }
+
+   workers.Stop();
+
+   return totals;
+}
@@ -0,0 +1,299 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include "cpplexer.h"
+#include "simdlexer.h"
+#include "languages.h"
+#include "totals.h"
+#include "namelist.h"
+#include "pathfilter.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <functional>
+
+class RunStats;
+
+///
+/// @brief  Counts lines in buffers, files and directory trees, which is
+///         the entry point of `liblinecnt`.
+///
+/// A counter is configured with options and with a set of extensions of
+/// files to count, which must not be changed while lines are counted.
+/// All counting methods may be called concurrently from multiple threads.
+/// Files are read into buffers that are reused by the calling thread, so
+/// each thread keeps a buffer as large as the largest file it has read.
+///
+/// Errors are reported by throwing exceptions. Results of trees and file
+/// lists are reported through a callback for each file, instead of being
+/// printed, in the same order whether worker threads are used or not.
+///
+class Counter {
+   public:
+      ///
+      /// @brief  Line counting engines, which produce identical counts.
+      ///
+      enum engine_t {
+         ENGINE_FLEX,                        ///< Flex scanner (`CppFlexLexer`).
+         ENGINE_SIMD,                        ///< Hand-written SIMD lexer (`SimdLexer`).
+         ENGINE_DFA                          ///< Table-driven automaton (`DfaLexer`).
+      };
+
+      ///
+      /// @brief  Counting options.
+      ///
+      struct options_t {
+         engine_t       engine = ENGINE_FLEX;               ///< Engine for C-like sources.
+         size_t         map_min_size = 0;                   ///< Files of this size or larger are memory-mapped (zero - never).
+         uint64_t       chunk_size = 16 * 1024 * 1024;      ///< C-like sources at least twice this size are counted in chunks (zero - never).
+         unsigned int   chunk_jobs = 1;                     ///< Maximum number of chunks counted on separate threads.
+         RunStats       *stats = nullptr;                   ///< Run statistics to record phase and file times into, if any.
+      };
+
+      ///
+      /// @brief  Receives totals of a counted file, which is `filename` in
+      ///         the directory `dirpath`.
+      ///
+      typedef std::function<void(const std::string& dirpath, const char *filename, const language_t& language, const Totals& totals)> file_callback_t;
+
+      ///
+      /// @brief  Counts lines in `length` characters in `buffer`, which is
+      ///         followed by two zero characters and may be modified.
+      ///
+      typedef std::function<Totals(char *buffer, size_t length)> buffer_counter_t;
+
+      ///
+      /// @brief  Counts lines in `length` characters in `buffer`, which holds
+      ///         contents of a file in `language`, same as `buffer_counter_t`.
+      ///
+      typedef std::function<Totals(char *buffer, size_t length, const language_t& language)> content_counter_t;
+
+      ///
+      /// @brief  Returns totals of the file `filepath` in `language`, which
+      ///         may be found without reading the file, or calls `read`,
+      ///         which reads and counts the file.
+      ///
+      typedef std::function<Totals(const std::string& filepath, const language_t& language, const std::function<Totals(void)>& read)> file_lookup_t;
+
+      ///
+      /// @brief  Receives names of files in the directory `dirpath` before
+      ///         they are counted.
+      ///
+      typedef std::function<void(const std::string& dirpath, const NameList& files)> prefetch_t;
+
+      ///
+      /// @brief  Options of counting a directory tree or a file list.
+      ///
+      /// Hooks are called from worker threads if more than one job is used
+      /// and must be safe to call concurrently in that case.
+      ///
+      struct tree_options_t {
+         bool              recursive = true;    ///< Sub-directories are counted as well.
+         unsigned int      jobs = 1;            ///< Number of worker threads (one - files are counted on the calling thread).
+         file_lookup_t     lookup;              ///< Finds totals of a file instead of reading it, if set (e.g. in a cache).
+         content_counter_t count_buffer;        ///< Counts file contents instead of `LexBuffer`, if set (e.g. to reuse counts of identical files).
+         prefetch_t        prefetch;            ///< Receives files of each directory before they are counted, if set (e.g. to read them ahead).
+      };
+
+   private:
+      ///
+      /// @brief  Case-insensitive string comparison predicate.
+      ///
+      struct less_stricmp_t {
+         bool operator () (const std::string& str1, const std::string& str2) const;
+      };
+
+      ///
+      /// @brief  A slot of the extension lookup table, which is empty if
+      ///         `language` is `nullptr`.
+      ///
+      struct ext_slot_t {
+         uint64_t          key[2];           ///< Lowercase extension, padded with zeros.
+         const language_t  *language;        ///< Language of files with this extension.
+      };
+
+      /// A directory or a group of listed files processed by worker threads.
+      struct dir_node_t;
+
+      /// State shared by worker threads counting a tree or a file list.
+      struct tree_walk_t;
+
+   private:
+      static constexpr size_t ext_key_size = sizeof(ext_slot_t::key);
+
+      options_t   options;
+
+      std::map<std::string, const language_t*, less_stricmp_t> extensions;   ///< Extensions of counted files, without periods.
+
+      std::vector<ext_slot_t> ext_table;                                   ///< Open-addressing table of extensions that fit into a key.
+      unsigned int ext_shift;                                              ///< Shift of a key hash to a table index.
+      size_t      ext_max_length;                                          ///< Length of the longest extension.
+
+      PathFilter  path_filter;                                             ///< Patterns of excluded paths in trees.
+
+   private:
+      /// Rebuilds the extension lookup table from the extension set.
+      void BuildExtensionTable(void);
+
+      /// Returns the language of the extension of a file name in the extension set, or `nullptr`.
+      const language_t *FindFileLanguage(const char *filename) const;
+
+      /// Returns the number of chunks counted on separate threads for a source of `length` bytes in `profile`.
+      size_t GetChunkCount(uint64_t length, SimdLexer::profile_t profile) const;
+
+      /// Reads the stream into a buffer reused by the calling thread, closes it and counts the buffer with `count`.
+      Totals ReadStream(FILE* &&srcfile, const char *filepath, const buffer_counter_t& count) const;
+
+      ///
+      /// @brief  Looks up or reads the file, counts its lines in `language`
+      ///         with hooks in `tree_options` and records its size and time
+      ///         in run statistics, unless it was found in a cache.
+      ///
+      Totals CountSourceFile(const std::string& filepath, const language_t& language, const tree_options_t& tree_options) const;
+
+      /// Marks one task of the directory node complete and wakes up the reporting thread if it was the last one.
+      static void CompleteDirTask(tree_walk_t& walk, dir_node_t& node);
+
+      /// Counts a file of the directory node in a worker thread.
+      void CountFileTask(tree_walk_t& walk, dir_node_t& node, size_t index) const;
+
+      /// Queues tasks to count files of the directory node, which are run in the order of files.
+      void QueueFileTasks(tree_walk_t& walk, dir_node_t& node) const;
+
+      /// Enumerates the directory node in a worker thread and queues tasks for its sub-directories and files.
+      void EnumDirectoryTask(tree_walk_t& walk, dir_node_t& node) const;
+
+      /// Waits for the directory node to be processed, reports its files and adds them to `totals`.
+      void ReportDirNode(tree_walk_t& walk, dir_node_t& node, const file_callback_t& callback, Totals& totals) const;
+
+      /// Counts files in `files` in the directory `dirpath` on the calling thread and adds them to `totals`.
+      void CountDirFiles(const std::string& dirpath, const NameList& files, const tree_options_t& tree_options, const file_callback_t& callback, Totals& totals) const;
+
+      /// Counts the tree using worker threads, same as `CountTree`.
+      Totals CountTreeJobs(const std::string& dirname, const tree_options_t& tree_options, const file_callback_t& callback) const;
+
+#if !defined(_WIN32)
+      /// Maps the file if it's at least `map_min_size` bytes long or reads it otherwise, and counts it with `count`.
+      Totals ReadMappedFile(const char *filepath, const buffer_counter_t& count) const;
+#endif
+
+   public:
+      /// Creates a counter with default options and no extensions.
+      Counter(void);
+
+      /// Creates a counter with `options` and no extensions.
+      Counter(const options_t& options);
+
+      /// Replaces counting options.
+      void SetOptions(const options_t& new_options) {options = new_options;}
+
+      /// Returns counting options.
+      const options_t& GetOptions(void) const {return options;}
+
+      /// Adds an extension, without a period, of files in `language` to the extension set.
+      void AddExtension(const char *ext, const language_t& language);
+
+      /// Adds all extensions of `language` to the extension set.
+      void AddLanguage(const language_t& language);
+
+      /// Returns extensions in the extension set, sorted without regard to case.
+      std::vector<std::string> GetExtensions(void) const;
+
+      /// Replaces patterns of paths excluded from directory enumeration.
+      void SetPathFilter(const PathFilter& new_filter) {path_filter = new_filter;}
+
+      /// Returns patterns of paths excluded from directory enumeration.
+      const PathFilter& GetPathFilter(void) const {return path_filter;}
+
+      ///
+      /// @brief  Returns `true` if directories named `name` are skipped in
+      ///         trees, which are those whose names begin with a period (e.g.
+      ///         `.`, `..`, `.git`, `.vs`).
+      ///
+      static bool IsSkippedDirectory(const char *name) {return *name == '.';}
+
+      /// Returns `true` if the file name has one of the extensions in the extension set.
+      bool IsSourceFile(const char *filename) const;
+
+      /// Returns the language of a file name that has one of the extensions in the extension set.
+      const language_t& GetFileLanguage(const char *filename) const;
+
+      ///
+      /// @brief  Counts lines in `length` characters in `buffer` with the
+      ///         selected engine in the syntax `profile`.
+      ///
+      /// The buffer must be followed by two zero characters and will be
+      /// modified by the Flex scanner. This is the fastest way to count
+      /// sources that are already in memory.
+      ///
+      CppFlexLexer::Result LexBuffer(char *buffer, size_t length, SimdLexer::profile_t profile) const;
+
+      /// Counts lines in `source` in `language`, copying it into a buffer reused by the calling thread.
+      CppFlexLexer::Result CountBuffer(const std::string_view& source, const language_t& language) const;
+
+      ///
+      /// @brief  Reads or maps the file `filepath` and returns totals
+      ///         returned by `count` for its contents.
+      ///
+      /// This method lets callers process file contents, such as hash
+      /// them, before counting lines with `LexBuffer`.
+      ///
+      Totals ReadFile(const char *filepath, const buffer_counter_t& count) const;
+
+      ///
+      /// @brief  Counts lines in the file `filepath`, in the language of its
+      ///         extension, even if it's not in the extension set.
+      ///
+      Totals CountFile(const std::string& filepath) const;
+
+      ///
+      /// @brief  Enumerates files with extensions in the extension set and
+      ///         sub-directories of the directory `dirname`, which is at
+      ///         `relpath` relative to the root of the tree.
+      ///
+      /// Directories skipped by `IsSkippedDirectory` are not listed, as well
+      /// as entries excluded by the path filter, so excluded sub-directories
+      /// are never opened. Errors are reported as `std::system_error`.
+      ///
+      void EnumDirectory(const std::string& dirname, const std::string_view& relpath, NameList& files, NameList& subdirs) const;
+
+      ///
+      /// @brief  Counts files with extensions in the extension set in the
+      ///         directory `dirname` and, if requested, in all sub-directories,
+      ///         calls `callback` for each file and returns totals.
+      ///
+      /// Files are reported on the calling thread in the order they are
+      /// enumerated, directory by directory, depth-first. If more than one
+      /// job is requested, worker threads enumerate directories and count
+      /// files concurrently, while the calling thread reports directories
+      /// in the same order, as they are completed. An error in a file or
+      /// a directory is thrown after all preceding files are reported.
+      ///
+      Totals CountTree(const std::string& dirname, const tree_options_t& tree_options, const file_callback_t& callback) const;
+
+      ///
+      /// @brief  Counts files in the path list, without scanning any
+      ///         directories, calls `callback` for each file and returns
+      ///         totals.
+      ///
+      /// Relative paths are resolved against `basedir`, unless it's empty.
+      /// Only files with extensions in the extension set that are not
+      /// excluded by the path filter are counted. Consecutive files in the
+      /// same directory are reported together and directories are counted
+      /// once, no matter how many times they appear in the list. Worker
+      /// threads are used the same way as in `CountTree`.
+      ///
+      Totals CountFileList(const std::string& basedir, const std::vector<std::string>& paths, const tree_options_t& tree_options, const file_callback_t& callback) const;
+};
+
+#endif // COUNTER_H
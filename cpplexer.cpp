@@ -9,6 +9,7 @@
 
 #include <cstdio>
 
+#include <new>
 #include <stdexcept>
 #include <string>
 
@@ -25,21 +26,53 @@ extern "C" {
 
 #include "cpplexer.h"
 
+void *CppFlexLexer::InitScanner(void)
+{
+   yyscan_t yyscanner;
+
+   if(yylex_init(&yyscanner) != 0)
+      throw std::bad_alloc();
+
+   return yyscanner;
+}
+
 CppFlexLexer::CppFlexLexer(FILE* &&arg_yyin) :
+      scanner(nullptr),
       srcfile(std::move(arg_yyin))
 {
-   yyrestart(arg_yyin);
+   try {
+      scanner = InitScanner();
+   }
+   catch (...) {
+      if(srcfile)
+         fclose(srcfile);
+      throw;
+   }
+
+   yyrestart(srcfile, scanner);
 }
 
 CppFlexLexer::CppFlexLexer(const std::string_view& source) :
+      scanner(InitScanner()),
+      srcfile(nullptr)
+{
+   yy_scan_bytes(source.data(), (int) source.length(), scanner);
+}
+
+CppFlexLexer::CppFlexLexer(char *buffer, size_t length) :
+      scanner(InitScanner()),
       srcfile(nullptr)
 {
-   yy_scan_bytes(source.data(), (int) source.length());
+   // Flex checks that the buffer ends with two end-of-buffer characters
+   if(!yy_scan_buffer(buffer, length + 2, scanner)) {
+      yylex_destroy(scanner);
+      throw std::invalid_argument("Source buffer must end with two zero characters");
+   }
 }
 
 CppFlexLexer::~CppFlexLexer(void)
 {
-   yylex_destroy();
+   yylex_destroy(scanner);
 
    if(srcfile)
       fclose(srcfile);
@@ -47,11 +80,11 @@ CppFlexLexer::~CppFlexLexer(void)
 
 CppFlexLexer::Result CppFlexLexer::CountLines(void)
 {
-   unsigned int linecnt = 0, cmntcnt = 0, cppcnt = 0, ccnt = 0, codecnt = 0, bracecnt = 0, emptycnt = 0;
+   uint64_t linecnt = 0, cmntcnt = 0, cppcnt = 0, ccnt = 0, codecnt = 0, bracecnt = 0, emptycnt = 0;
    int token1;
 
    linecnt = 0;
-   if((token1 = yylex()) != TOKEN_EOF) {
+   if((token1 = yylex(scanner)) != TOKEN_EOF) {
       do {
          switch (token1) {
             case TOKEN_EMPTY_LINE:
@@ -111,9 +144,9 @@ CppFlexLexer::Result CppFlexLexer::CountLines(void)
                cmntcnt++;
                break;
             default:
-               throw std::runtime_error("Unknown token: " + std::string(yytext) + " at " + std::to_string(linecnt));
+               throw std::runtime_error("Unknown token: " + std::string(yyget_text(scanner)) + " at " + std::to_string(linecnt));
          }
-      } while(token1 < TOKEN_EOF && ((token1 = yylex()) != TOKEN_EOF));
+      } while(token1 < TOKEN_EOF && ((token1 = yylex(scanner)) != TOKEN_EOF));
    }
 
    return {linecnt, cmntcnt, cppcnt, ccnt, codecnt, bracecnt, emptycnt};
@@ -11,6 +11,8 @@
 #include "cpplexer_scanner.h"
 
 #include <cstdio>
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 ///
@@ -24,24 +26,61 @@
 /// absolute minimum set of methods to allow the line counting code to
 /// read the sequence of tokens in source files that are being parsed.
 /// 
+/// The scanner is generated as a reentrant scanner and each instance of
+/// this class owns its own scanner state, so multiple instances may be
+/// used concurrently in different threads. Instances cannot be copied.
+/// 
 class CppFlexLexer {
    public:
       ///
       /// @brief  Source line count result structure.
       ///
       struct Result {
-         unsigned int linecnt = 0;           ///< Total line count.
-         unsigned int cmntcnt = 0;           ///< Count of lines with comments.
-         unsigned int cppcnt = 0;            ///< Count of lines with C++ comments
-         unsigned int ccnt = 0;              ///< Count of lines with C-style comments.
-         unsigned int codecnt = 0;           ///< Count of lines with code.
-         unsigned int bracecnt = 0;          ///< Count of lines with a single brace.
-         unsigned int emptycnt = 0;          ///< Count of empty lines.
+         uint64_t linecnt = 0;               ///< Total line count.
+         uint64_t cmntcnt = 0;               ///< Count of lines with comments.
+         uint64_t cppcnt = 0;                ///< Count of lines with C++ comments
+         uint64_t ccnt = 0;                  ///< Count of lines with C-style comments.
+         uint64_t codecnt = 0;               ///< Count of lines with code.
+         uint64_t bracecnt = 0;              ///< Count of lines with a single brace.
+         uint64_t emptycnt = 0;              ///< Count of empty lines.
+
+         /// Adds line counts in `other` to this result.
+         Result& operator += (const Result& other)
+         {
+            linecnt += other.linecnt;
+            cmntcnt += other.cmntcnt;
+            cppcnt += other.cppcnt;
+            ccnt += other.ccnt;
+            codecnt += other.codecnt;
+            bracecnt += other.bracecnt;
+            emptycnt += other.emptycnt;
+
+            return *this;
+         }
+
+         /// Subtracts counts in `other`, which must have been added before, from these counts.
+         Result& operator -= (const Result& other)
+         {
+            linecnt -= other.linecnt;
+            cmntcnt -= other.cmntcnt;
+            cppcnt -= other.cppcnt;
+            ccnt -= other.ccnt;
+            codecnt -= other.codecnt;
+            bracecnt -= other.bracecnt;
+            emptycnt -= other.emptycnt;
+
+            return *this;
+         }
       };
 
    private:
+      void  *scanner;                        ///< Reentrant Flex scanner state (`yyscan_t`).
       FILE  *srcfile;                        ///< Source file handle (may be `nullptr`).
 
+   private:
+      /// Allocates a new reentrant Flex scanner state.
+      static void *InitScanner(void);
+
    public:
       /// Constructs a Flex scanner with a handle to the specified source file.
       CppFlexLexer(FILE* &&arg_yyin = nullptr);
@@ -49,9 +88,24 @@ class CppFlexLexer {
       /// Constructs a Flex scanner with the specified source text.
       CppFlexLexer(const std::string_view& source);
 
-      /// If Flex scanner was constructed with a file handle, closes that handle.
+      ///
+      /// @brief  Constructs a Flex scanner that scans `length` characters
+      ///         in `buffer` in place, without copying them.
+      ///
+      /// The buffer must have two zero characters after the source text,
+      /// which are not included in `length`. Flex writes into the buffer
+      /// while scanning, so it must be writable and it must not be used
+      /// by anything else until this scanner is destroyed.
+      ///
+      CppFlexLexer(char *buffer, size_t length);
+
+      CppFlexLexer(const CppFlexLexer&) = delete;
+
+      /// Destroys the Flex scanner state and closes the source file handle, if there is one.
       ~CppFlexLexer(void);
-      
+
+      CppFlexLexer& operator = (const CppFlexLexer&) = delete;
+
       /// Runs the source through the Flex scanner and returns resulting counts.
       Result CountLines(void);
 };
@@ -0,0 +1,680 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "dfalexer.h"
+#include "cpplexer_scanner.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <thread>
+
+namespace {
+
+///
+/// @brief  Character classes, which are the only distinction between
+///         characters made by the automaton.
+///
+enum char_class_t : uint8_t {
+   CC_CODE,                               ///< Any character not in other classes.
+   CC_SPACE,                              ///< Characters matched by `WS` in `cpplexer_scanner.l`.
+   CC_CR,
+   CC_LF,
+   CC_DQUOTE,
+   CC_SQUOTE,
+   CC_BACKSLASH,
+   CC_SLASH,
+   CC_STAR,
+   CC_BRACE,                              ///< Opening and closing braces.
+
+   CC_COUNT
+};
+
+///
+/// @brief  Automaton states.
+///
+/// States without comments are named after Flex start conditions in
+/// `cpplexer_scanner.l`. `_SLASH` and `_STAR` states follow a character
+/// that may start a two-character token, `_ESC` states follow a backslash
+/// in a string and `_CR` states follow a carriage return that may be
+/// followed by a new line character.
+///
+enum state_t : uint8_t {
+   S_INITIAL,
+   S_BOL,                                 ///< After a new line character, where `^` rules match.
+   S_BOL_CR,                              ///< After a lone carriage return, where `^` rules do not match.
+   S_LWS,
+   S_BRL,
+   S_SLASH,                               ///< A slash in a line without code or comments.
+   S_CODE,
+   S_CODE_SLASH,
+   S_CODE_C_COMMENT,
+   S_CODE_C_COMMENT_SLASH,
+   S_C_COMMENT,
+   S_C_COMMENT_SLASH,
+   S_CPP_COMMENT,
+   S_CODE_CPP_COMMENT,
+   S_CODE_C_CPP_COMMENT,
+   S_C_CPP_COMMENT,
+   S_C_COMMENT_OPEN,
+   S_C_COMMENT_OPEN_STAR,
+   S_C_COMMENT_OPEN_LF,
+   S_C_COMMENT_OPEN_CR,
+   S_CODE_C_COMMENT_OPEN,
+   S_CODE_C_COMMENT_OPEN_STAR,
+   S_CODE_C_COMMENT_OPEN_LF,
+   S_CODE_C_COMMENT_OPEN_CR,
+   S_DQSTR,
+   S_DQSTR_ESC,
+   S_DQSTR_ESC_CR,
+   S_DQSTR_C_COMMENT,
+   S_DQSTR_C_COMMENT_ESC,
+   S_DQSTR_C_COMMENT_ESC_CR,
+   S_SQSTR,
+   S_SQSTR_ESC,
+   S_SQSTR_ESC_CR,
+   S_SQSTR_C_COMMENT,
+   S_SQSTR_C_COMMENT_ESC,
+   S_SQSTR_C_COMMENT_ESC_CR,
+
+   // line ends, two per token type, entered at a new line character and at a carriage return
+   S_EOL,
+
+   S_COUNT = S_EOL + 2 * TOKEN_CODE_C_CPP_COMMENT_EOL
+};
+
+///
+/// @brief  States in which a line may start after a new line character,
+///         one per group of states with identical transitions.
+///
+/// Chunks of a source are scanned speculatively from each of these states.
+///
+constexpr uint8_t line_start_states[] = {
+   S_BOL,
+   S_C_COMMENT_OPEN,
+   S_CODE_C_COMMENT_OPEN,
+   S_DQSTR,
+   S_DQSTR_C_COMMENT,
+   S_SQSTR,
+   S_SQSTR_C_COMMENT
+};
+
+constexpr size_t line_start_count = sizeof(line_start_states) / sizeof(line_start_states[0]);
+
+///
+/// @brief  Returns the state entered at the end of a line of the type
+///         identified by a Flex token.
+///
+constexpr uint8_t GetEOLState(int token, bool cr)
+{
+   return (uint8_t) (S_EOL + 2 * (token - 1) + (cr ? 1 : 0));
+}
+
+///
+/// @brief  Bit offsets of counters packed into increment vectors.
+///
+/// Each counter takes 9 bits, so up to 511 lines may be accumulated
+/// before counters must be added to line counts.
+///
+enum counter_shift_t {
+   LINE_SHIFT = 0,
+   CODE_SHIFT = 9,
+   CMNT_SHIFT = 18,
+   CPP_SHIFT = 27,
+   C_SHIFT = 36,
+   EMPTY_SHIFT = 45,
+   BRACE_SHIFT = 54
+};
+
+constexpr uint64_t counter_mask = 0x1FF;
+
+constexpr size_t max_block_size = counter_mask;
+
+///
+/// @brief  Returns a packed vector of counter increments for a line of the
+///         type identified by a Flex token.
+///
+uint64_t GetLineIncrements(int token)
+{
+   uint64_t increments = (uint64_t) 1 << LINE_SHIFT;
+
+   switch (token) {
+      case TOKEN_EMPTY_LINE:
+         return increments | (uint64_t) 1 << EMPTY_SHIFT;
+      case TOKEN_BRACE_LINE:
+         return increments | (uint64_t) 1 << BRACE_SHIFT;
+      case TOKEN_CODE_EOL:
+         return increments | (uint64_t) 1 << CODE_SHIFT;
+      case TOKEN_C_COMMENT_EOL:
+         return increments | (uint64_t) 1 << C_SHIFT | (uint64_t) 1 << CMNT_SHIFT;
+      case TOKEN_CPP_COMMENT_EOL:
+         return increments | (uint64_t) 1 << CPP_SHIFT | (uint64_t) 1 << CMNT_SHIFT;
+      case TOKEN_C_CPP_COMMENT_EOL:
+         return increments | (uint64_t) 1 << CPP_SHIFT | (uint64_t) 1 << C_SHIFT | (uint64_t) 1 << CMNT_SHIFT;
+      case TOKEN_CODE_C_COMMENT_EOL:
+         return increments | (uint64_t) 1 << C_SHIFT | (uint64_t) 1 << CODE_SHIFT | (uint64_t) 1 << CMNT_SHIFT;
+      case TOKEN_CODE_CPP_COMMENT_EOL:
+         return increments | (uint64_t) 1 << CPP_SHIFT | (uint64_t) 1 << CODE_SHIFT | (uint64_t) 1 << CMNT_SHIFT;
+      case TOKEN_CODE_C_CPP_COMMENT_EOL:
+         return increments | (uint64_t) 1 << C_SHIFT | (uint64_t) 1 << CPP_SHIFT | (uint64_t) 1 << CODE_SHIFT | (uint64_t) 1 << CMNT_SHIFT;
+      default:
+         return 0;
+   }
+}
+
+///
+/// @brief  Adds counters packed into `accumulator` to line counts.
+///
+void AddCounters(CppFlexLexer::Result& counts, uint64_t accumulator)
+{
+   counts.linecnt += accumulator >> LINE_SHIFT & counter_mask;
+   counts.codecnt += accumulator >> CODE_SHIFT & counter_mask;
+   counts.cmntcnt += accumulator >> CMNT_SHIFT & counter_mask;
+   counts.cppcnt += accumulator >> CPP_SHIFT & counter_mask;
+   counts.ccnt += accumulator >> C_SHIFT & counter_mask;
+   counts.emptycnt += accumulator >> EMPTY_SHIFT & counter_mask;
+   counts.bracecnt += accumulator >> BRACE_SHIFT & counter_mask;
+}
+
+///
+/// @brief  Automaton tables.
+///
+/// Rows of the transition table are padded to 16 entries and the scanning
+/// loop tracks the offset of the row of the current state, rather than the
+/// state, so the next row is found with a single addition and a load.
+///
+struct dfa_t {
+   static constexpr size_t row_size = 16;
+
+   uint8_t     classes[256];              ///< Character class of each character.
+   uint8_t     next[S_COUNT][row_size];   ///< Next state for each state and character class.
+   uint16_t    rows[S_COUNT * row_size];  ///< Offset of the next row for each row offset plus character class.
+   uint64_t    increments[S_COUNT];       ///< Counter increments added when a state is entered.
+   uint64_t    eof_increments[S_COUNT];   ///< Counter increments for the last line, which ends in a state.
+   uint8_t     line_starts[S_COUNT];      ///< Index in `line_start_states` of a state with the same transitions.
+
+   dfa_t(void);
+
+   /// Sets all transitions of the state to `target`.
+   void SetAll(uint8_t state, uint8_t target) {memset(next[state], target, row_size);}
+
+   /// Copies all transitions of the state `from` to the state `state`.
+   void CopyRow(uint8_t state, uint8_t from) {memcpy(next[state], next[from], row_size);}
+
+   /// Sets transitions for both end-of-line characters to states counting a line of the token type.
+   void SetEOL(uint8_t state, int token)
+   {
+      next[state][CC_LF] = GetEOLState(token, false);
+      next[state][CC_CR] = GetEOLState(token, true);
+   }
+
+   /// Sets transitions of a string state and its escape states.
+   void SetString(uint8_t state, char_class_t quote, uint8_t closed, int token);
+
+   /// Sets transitions of an open C comment state and its star and line end states.
+   void SetOpenComment(uint8_t state, uint8_t closed);
+};
+
+void dfa_t::SetString(uint8_t state, char_class_t quote, uint8_t closed, int token)
+{
+   uint8_t esc = state + 1;
+   uint8_t esc_cr = state + 2;
+
+   SetAll(state, state);
+   next[state][CC_BACKSLASH] = esc;
+   next[state][quote] = closed;
+   SetEOL(state, token);
+
+   // \\{EOL} and \\. consume the next character or the entire EOL
+   SetAll(esc, state);
+   next[esc][CC_CR] = esc_cr;
+
+   CopyRow(esc_cr, state);
+   next[esc_cr][CC_LF] = state;
+}
+
+void dfa_t::SetOpenComment(uint8_t state, uint8_t closed)
+{
+   uint8_t star = state + 1;
+   uint8_t lf = state + 2;
+   uint8_t cr = state + 3;
+
+   // lines within an open comment do not change the state
+   SetAll(state, state);
+   next[state][CC_STAR] = star;
+   next[state][CC_LF] = lf;
+   next[state][CC_CR] = cr;
+
+   CopyRow(star, state);
+   next[star][CC_SLASH] = closed;
+
+   CopyRow(lf, state);
+
+   CopyRow(cr, state);
+   next[cr][CC_LF] = state;
+}
+
+//
+// Transitions follow rules in `cpplexer_scanner.l`, which are matched by
+// Flex using the longest match, and are the same as in `SimdLexer`, which
+// has more detailed comments.
+//
+dfa_t::dfa_t(void) : classes(), next(), rows(), increments(), eof_increments(), line_starts()
+{
+   for(size_t chr = 0; chr < 256; chr++) {
+      if(chr == 0x09 || chr == 0x0B || chr == 0x0C || (chr >= 0x0E && chr <= 0x20))
+         classes[chr] = CC_SPACE;
+   }
+
+   classes['\r'] = CC_CR;
+   classes['\n'] = CC_LF;
+   classes['"'] = CC_DQUOTE;
+   classes['\''] = CC_SQUOTE;
+   classes['\\'] = CC_BACKSLASH;
+   classes['/'] = CC_SLASH;
+   classes['*'] = CC_STAR;
+   classes['{'] = CC_BRACE;
+   classes['}'] = CC_BRACE;
+
+   // rules that are not anchored, with discarded whitespace and line ends
+   SetAll(S_BOL_CR, S_CODE);
+   next[S_BOL_CR][CC_SPACE] = S_BOL_CR;
+   next[S_BOL_CR][CC_CR] = S_BOL_CR;
+   next[S_BOL_CR][CC_LF] = S_BOL;
+   next[S_BOL_CR][CC_DQUOTE] = S_DQSTR;
+   next[S_BOL_CR][CC_SQUOTE] = S_SQSTR;
+   next[S_BOL_CR][CC_SLASH] = S_SLASH;
+
+   // ^{WS}+, ^{WS}*[\{\}]{WS}* and ^{EOL}, followed by rules that are not anchored
+   CopyRow(S_LWS, S_BOL_CR);
+   next[S_LWS][CC_SPACE] = S_LWS;
+   next[S_LWS][CC_BRACE] = S_BRL;
+   SetEOL(S_LWS, TOKEN_EMPTY_LINE);
+
+   CopyRow(S_BOL, S_LWS);
+   CopyRow(S_INITIAL, S_LWS);
+
+   CopyRow(S_BRL, S_BOL_CR);
+   next[S_BRL][CC_SPACE] = S_BRL;
+   SetEOL(S_BRL, TOKEN_BRACE_LINE);
+
+   SetAll(S_CODE, S_CODE);
+   next[S_CODE][CC_DQUOTE] = S_DQSTR;
+   next[S_CODE][CC_SQUOTE] = S_SQSTR;
+   next[S_CODE][CC_SLASH] = S_CODE_SLASH;
+   SetEOL(S_CODE, TOKEN_CODE_EOL);
+
+   SetAll(S_CODE_C_COMMENT, S_CODE_C_COMMENT);
+   next[S_CODE_C_COMMENT][CC_DQUOTE] = S_DQSTR_C_COMMENT;
+   next[S_CODE_C_COMMENT][CC_SQUOTE] = S_SQSTR_C_COMMENT;
+   next[S_CODE_C_COMMENT][CC_SLASH] = S_CODE_C_COMMENT_SLASH;
+   SetEOL(S_CODE_C_COMMENT, TOKEN_CODE_C_COMMENT_EOL);
+
+   SetAll(S_C_COMMENT, S_CODE_C_COMMENT);
+   next[S_C_COMMENT][CC_SPACE] = S_C_COMMENT;
+   next[S_C_COMMENT][CC_DQUOTE] = S_DQSTR_C_COMMENT;
+   next[S_C_COMMENT][CC_SQUOTE] = S_SQSTR_C_COMMENT;
+   next[S_C_COMMENT][CC_SLASH] = S_C_COMMENT_SLASH;
+   SetEOL(S_C_COMMENT, TOKEN_C_COMMENT_EOL);
+
+   // a slash that does not start a comment is code and the next character is matched as code
+   CopyRow(S_SLASH, S_CODE);
+   next[S_SLASH][CC_SLASH] = S_CPP_COMMENT;
+   next[S_SLASH][CC_STAR] = S_C_COMMENT_OPEN;
+
+   CopyRow(S_CODE_SLASH, S_CODE);
+   next[S_CODE_SLASH][CC_SLASH] = S_CODE_CPP_COMMENT;
+   next[S_CODE_SLASH][CC_STAR] = S_CODE_C_COMMENT_OPEN;
+
+   CopyRow(S_CODE_C_COMMENT_SLASH, S_CODE_C_COMMENT);
+   next[S_CODE_C_COMMENT_SLASH][CC_SLASH] = S_CODE_C_CPP_COMMENT;
+   next[S_CODE_C_COMMENT_SLASH][CC_STAR] = S_CODE_C_COMMENT_OPEN;
+
+   CopyRow(S_C_COMMENT_SLASH, S_CODE_C_COMMENT);
+   next[S_C_COMMENT_SLASH][CC_SLASH] = S_C_CPP_COMMENT;
+   next[S_C_COMMENT_SLASH][CC_STAR] = S_C_COMMENT_OPEN;
+
+   // C++ comments end only at a new line character, except in the last line
+   const std::pair<uint8_t, int> cpp_comments[] = {
+      {S_CPP_COMMENT, TOKEN_CPP_COMMENT_EOL},
+      {S_CODE_CPP_COMMENT, TOKEN_CODE_CPP_COMMENT_EOL},
+      {S_CODE_C_CPP_COMMENT, TOKEN_CODE_C_CPP_COMMENT_EOL},
+      {S_C_CPP_COMMENT, TOKEN_C_CPP_COMMENT_EOL}
+   };
+
+   for(const std::pair<uint8_t, int>& cpp_comment : cpp_comments) {
+      SetAll(cpp_comment.first, cpp_comment.first);
+      next[cpp_comment.first][CC_LF] = GetEOLState(cpp_comment.second, false);
+   }
+
+   SetOpenComment(S_C_COMMENT_OPEN, S_C_COMMENT);
+   SetOpenComment(S_CODE_C_COMMENT_OPEN, S_CODE_C_COMMENT);
+
+   SetString(S_DQSTR, CC_DQUOTE, S_CODE, TOKEN_CODE_EOL);
+   SetString(S_DQSTR_C_COMMENT, CC_DQUOTE, S_CODE_C_COMMENT, TOKEN_CODE_C_COMMENT_EOL);
+   SetString(S_SQSTR, CC_SQUOTE, S_CODE, TOKEN_CODE_EOL);
+   SetString(S_SQSTR_C_COMMENT, CC_SQUOTE, S_CODE_C_COMMENT, TOKEN_CODE_C_COMMENT_EOL);
+
+   // a line end continues like the beginning of a line after the same end-of-line character
+   for(int token = TOKEN_EMPTY_LINE; token <= TOKEN_CODE_C_CPP_COMMENT_EOL; token++) {
+      CopyRow(GetEOLState(token, false), S_BOL);
+      CopyRow(GetEOLState(token, true), S_BOL_CR);
+
+      increments[GetEOLState(token, false)] = GetLineIncrements(token);
+      increments[GetEOLState(token, true)] = GetLineIncrements(token);
+   }
+
+   increments[S_C_COMMENT_OPEN_LF] = increments[S_C_COMMENT_OPEN_CR] = GetLineIncrements(TOKEN_C_COMMENT_EOL);
+   increments[S_CODE_C_COMMENT_OPEN_LF] = increments[S_CODE_C_COMMENT_OPEN_CR] = GetLineIncrements(TOKEN_CODE_C_COMMENT_EOL);
+
+   // count the last line according to <<EOF>> rules
+   for(uint8_t state = 0; state < S_COUNT; state++) {
+      int token;
+
+      switch (state) {
+         case S_INITIAL:
+            token = 0;
+            break;
+         case S_BRL:
+            token = TOKEN_BRACE_LINE;
+            break;
+         case S_SLASH:
+         case S_CODE:
+         case S_CODE_SLASH:
+         case S_DQSTR:
+         case S_DQSTR_ESC:
+         case S_DQSTR_ESC_CR:
+         case S_SQSTR:
+         case S_SQSTR_ESC:
+         case S_SQSTR_ESC_CR:
+            token = TOKEN_CODE_EOL;
+            break;
+         case S_C_COMMENT:
+         case S_C_COMMENT_OPEN:
+         case S_C_COMMENT_OPEN_STAR:
+         case S_C_COMMENT_OPEN_LF:
+         case S_C_COMMENT_OPEN_CR:
+            token = TOKEN_C_COMMENT_EOL;
+            break;
+         case S_CPP_COMMENT:
+            token = TOKEN_CPP_COMMENT_EOL;
+            break;
+         case S_C_CPP_COMMENT:
+            token = TOKEN_C_CPP_COMMENT_EOL;
+            break;
+         case S_CODE_C_COMMENT:
+         case S_CODE_C_COMMENT_SLASH:
+         case S_C_COMMENT_SLASH:
+         case S_CODE_C_COMMENT_OPEN:
+         case S_CODE_C_COMMENT_OPEN_STAR:
+         case S_CODE_C_COMMENT_OPEN_LF:
+         case S_CODE_C_COMMENT_OPEN_CR:
+         case S_DQSTR_C_COMMENT:
+         case S_DQSTR_C_COMMENT_ESC:
+         case S_DQSTR_C_COMMENT_ESC_CR:
+         case S_SQSTR_C_COMMENT:
+         case S_SQSTR_C_COMMENT_ESC:
+         case S_SQSTR_C_COMMENT_ESC_CR:
+            token = TOKEN_CODE_C_COMMENT_EOL;
+            break;
+         case S_CODE_CPP_COMMENT:
+            token = TOKEN_CODE_CPP_COMMENT_EOL;
+            break;
+         case S_CODE_C_CPP_COMMENT:
+            token = TOKEN_CODE_C_CPP_COMMENT_EOL;
+            break;
+         default:
+            // beginnings of lines, including line ends
+            token = TOKEN_EMPTY_LINE;
+            break;
+      }
+
+      eof_increments[state] = GetLineIncrements(token);
+   }
+
+   for(size_t state = 0; state < S_COUNT; state++) {
+      for(size_t cls = 0; cls < row_size; cls++)
+         rows[state * row_size + cls] = (uint16_t) (next[state][cls] * row_size);
+   }
+
+   // states that cannot follow a new line character are never looked up
+   for(size_t state = 0; state < S_COUNT; state++) {
+      for(uint8_t index = 0; index < line_start_count; index++) {
+         if(!memcmp(next[state], next[line_start_states[index]], row_size))
+            line_starts[state] = index;
+      }
+   }
+}
+
+///
+/// @brief  Returns automaton tables, which are built on the first call.
+///
+const dfa_t& GetDfa(void)
+{
+   static const dfa_t dfa;
+
+   return dfa;
+}
+
+///
+/// @brief  Returns `true` if the state is within a C++ comment.
+///
+inline bool IsCppComment(uint8_t state)
+{
+   return state == S_CPP_COMMENT || state == S_CODE_CPP_COMMENT || state == S_CODE_C_CPP_COMMENT || state == S_C_CPP_COMMENT;
+}
+
+///
+/// @brief  Runs the automaton over the range, starting in `state`, adds
+///         counted lines to `counts` and returns the final state.
+///
+uint8_t RunDfa(const dfa_t& dfa, const uint8_t *ptr, const uint8_t *end, uint8_t state, CppFlexLexer::Result& counts)
+{
+   size_t row = state * dfa_t::row_size;
+
+   while(ptr < end) {
+      const uint8_t *block_end = ptr + std::min((size_t) (end - ptr), max_block_size);
+      uint64_t accumulator = 0;
+
+      for(; ptr < block_end; ptr++) {
+         row = dfa.rows[row + dfa.classes[*ptr]];
+         accumulator += dfa.increments[row / dfa_t::row_size];
+      }
+
+      AddCounters(counts, accumulator);
+   }
+
+   return (uint8_t) (row / dfa_t::row_size);
+}
+
+///
+/// @brief  Line counts and end states of a chunk scanned from each of the
+///         line start states.
+///
+struct chunk_counts_t {
+   uint8_t                 states[line_start_count];
+   CppFlexLexer::Result    counts[line_start_count];
+};
+
+///
+/// @brief  Runs the automaton over the range from all line start states at
+///         once and returns counts and end states for each of them.
+///
+/// Transitions for different start states do not depend on each other and
+/// are interleaved, so this takes about as long as a single run, which is
+/// limited by the latency of table lookups. Runs that end up in the same
+/// state stay in the same state, so once all of them do, the rest of the
+/// range is scanned by a single run.
+///
+void RunDfaSpeculative(const dfa_t& dfa, const uint8_t *ptr, const uint8_t *end, chunk_counts_t& chunk)
+{
+   size_t rows[line_start_count];
+
+   for(size_t lane = 0; lane < line_start_count; lane++)
+      rows[lane] = line_start_states[lane] * dfa_t::row_size;
+
+   while(ptr < end) {
+      if(std::all_of(rows + 1, rows + line_start_count, [&rows] (size_t row) {return row == rows[0];}))
+         break;
+
+      const uint8_t *block_end = ptr + std::min((size_t) (end - ptr), max_block_size);
+      uint64_t accumulators[line_start_count] = {};
+
+      for(; ptr < block_end; ptr++) {
+         size_t cls = dfa.classes[*ptr];
+
+         for(size_t lane = 0; lane < line_start_count; lane++) {
+            rows[lane] = dfa.rows[rows[lane] + cls];
+            accumulators[lane] += dfa.increments[rows[lane] / dfa_t::row_size];
+         }
+      }
+
+      for(size_t lane = 0; lane < line_start_count; lane++)
+         AddCounters(chunk.counts[lane], accumulators[lane]);
+   }
+
+   CppFlexLexer::Result counts;
+
+   uint8_t state = RunDfa(dfa, ptr, end, (uint8_t) (rows[0] / dfa_t::row_size), counts);
+
+   // runs that did not end up in the same state have reached the end of the range
+   for(size_t lane = 0; lane < line_start_count; lane++) {
+      chunk.counts[lane] += counts;
+      chunk.states[lane] = ptr < end ? state : (uint8_t) (rows[lane] / dfa_t::row_size);
+   }
+}
+
+///
+/// @brief  Counts the last line of the source, which starts at `ptr`, in
+///         `state` and adds its counts to `counts`.
+///
+void CountLastLine(const dfa_t& dfa, const uint8_t *ptr, const uint8_t *end, uint8_t state, CppFlexLexer::Result& counts)
+{
+   const uint8_t *last_line = ptr;
+
+   //
+   // .*{EOL} in a C++ comment in the last line extends to the last lone
+   // carriage return, if there is one, and the rest of the line is matched
+   // as if it was on a new line, except that `^` rules do not match.
+   //
+   const uint8_t *last_cr = end;
+
+   while(last_cr > last_line && last_cr[-1] != '\r')
+      last_cr--;
+
+   if(last_cr > last_line) {
+      state = RunDfa(dfa, last_line, last_cr - 1, state, counts);
+
+      if(IsCppComment(state)) {
+         AddCounters(counts, dfa.eof_increments[state]);
+         state = S_BOL_CR;
+         ptr = last_cr;
+      }
+      else
+         ptr = last_cr - 1;
+   }
+
+   state = RunDfa(dfa, ptr, end, state, counts);
+
+   AddCounters(counts, dfa.eof_increments[state]);
+}
+
+///
+/// @brief  Returns a pointer to the beginning of the last line in the range.
+///
+const uint8_t *FindLastLine(const uint8_t *begin, const uint8_t *end)
+{
+   while(end > begin && end[-1] != '\n')
+      end--;
+
+   return end;
+}
+
+}
+
+DfaLexer::DfaLexer(const std::string_view& source) :
+      source(source)
+{
+}
+
+CppFlexLexer::Result DfaLexer::CountLines(void)
+{
+   const dfa_t& dfa = GetDfa();
+
+   CppFlexLexer::Result counts;
+
+   const uint8_t *begin = (const uint8_t*) source.data();
+   const uint8_t *end = begin + source.length();
+   const uint8_t *last_line = FindLastLine(begin, end);
+
+   // every C++ comment before the last line ends with a new line character
+   uint8_t state = RunDfa(dfa, begin, last_line, S_INITIAL, counts);
+
+   CountLastLine(dfa, last_line, end, state, counts);
+
+   return counts;
+}
+
+CppFlexLexer::Result DfaLexer::CountLines(size_t chunk_count)
+{
+   const dfa_t& dfa = GetDfa();
+
+   const uint8_t *begin = (const uint8_t*) source.data();
+   const uint8_t *end = begin + source.length();
+   const uint8_t *last_line = FindLastLine(begin, end);
+
+   // chunks end after new line characters, which leaves only a few states in which the next chunk may start
+   std::vector<const uint8_t*> bounds(1, begin);
+
+   for(size_t index = 1; index < chunk_count; index++) {
+      const uint8_t *ptr = std::max(begin + (size_t) (last_line - begin) / chunk_count * index, bounds.back());
+
+      if((ptr = (const uint8_t*) memchr(ptr, '\n', last_line - ptr)) == nullptr || ptr + 1 == last_line)
+         break;
+
+      bounds.push_back(ptr + 1);
+   }
+
+   bounds.push_back(last_line);
+
+   if(bounds.size() == 2)
+      return CountLines();
+
+   std::vector<chunk_counts_t> chunks(bounds.size() - 2);
+   std::vector<std::thread> threads;
+
+   try {
+      for(size_t index = 0; index < chunks.size(); index++)
+         threads.emplace_back(RunDfaSpeculative, std::cref(dfa), bounds[index + 1], bounds[index + 2], std::ref(chunks[index]));
+   }
+   catch (...) {
+      for(std::thread& thread : threads)
+         thread.join();
+      throw;
+   }
+
+   CppFlexLexer::Result counts;
+
+   uint8_t state = RunDfa(dfa, bounds[0], bounds[1], S_INITIAL, counts);
+
+   for(std::thread& thread : threads)
+      thread.join();
+
+   // stitch chunks in order, picking the run that started in the state the previous chunk ended in
+   for(const chunk_counts_t& chunk : chunks) {
+      size_t lane = dfa.line_starts[state];
+
+      counts += chunk.counts[lane];
+      state = chunk.states[lane];
+   }
+
+   CountLastLine(dfa, last_line, end, state, counts);
+
+   return counts;
+}
@@ -0,0 +1,57 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef DFALEXER_H
+#define DFALEXER_H
+
+#include "cpplexer.h"
+
+#include <string_view>
+
+///
+/// @brief  A table-driven line counter for C-like languages, which runs
+///         a deterministic finite automaton over the source, one character
+///         at a time, without branches or function calls per line.
+///
+/// This lexer produces the same counts as the Flex scanner in
+/// `cpplexer_scanner.l`. Characters are mapped to a few character classes,
+/// which select transitions in a table of all states, and all tables fit
+/// in about 3 KB, so they stay in the L1 cache. Two-character tokens and
+/// `^` anchors, which Flex resolves with lookahead and the previous
+/// character, are represented by intermediate states.
+///
+/// Each state has a vector of counter increments, packed into a single
+/// 64-bit value, which is added to an accumulator on every transition.
+/// Only states entered at the end of a line have non-zero increments.
+///
+/// A C++ comment ending with a lone carriage return, which Flex matches
+/// only if there are no new line characters after it, can occur only in
+/// the last line of the source, which is finished separately.
+///
+/// Large sources may be split into chunks that end after new line
+/// characters, which are scanned in parallel. A line may start only in a
+/// few states (e.g. within a C comment or a string continued with a
+/// backslash), so every chunk after the first one is scanned from each of
+/// these states and chunks are stitched together in order, using counts
+/// of the run that started in the state in which the previous chunk ended.
+///
+class DfaLexer {
+   private:
+      std::string_view  source;              ///< Source text.
+
+   public:
+      /// Constructs a lexer for the specified source text, which is not copied.
+      DfaLexer(const std::string_view& source);
+
+      /// Counts lines in the source text.
+      CppFlexLexer::Result CountLines(void);
+
+      /// Counts lines in the source text split into up to `chunk_count` chunks scanned on separate threads.
+      CppFlexLexer::Result CountLines(size_t chunk_count);
+};
+
+#endif // DFALEXER_H
@@ -0,0 +1,449 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "filereader.h"
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__linux__)
+///
+/// @brief  An io_uring instance with its submission and completion rings
+///         mapped into memory.
+///
+/// liburing is not used, so all ring access is done as described in the
+/// `io_uring_setup` manual page.
+///
+struct FileReader::uring_t {
+   ///
+   /// @brief  Requests submitted for each file, which are encoded in the
+   ///         lowest bits of request data, above which is the slot index.
+   ///
+   enum op_t {
+      OP_OPEN,
+      OP_READ,
+      OP_CLOSE,
+
+      OP_BITS = 2
+   };
+
+   int            fd = -1;                   ///< io_uring file descriptor.
+
+   void           *sq_ring = MAP_FAILED;     ///< Mapped submission ring.
+   size_t         sq_ring_size = 0;
+   void           *cq_ring = MAP_FAILED;     ///< Mapped completion ring, which may be the same mapping as `sq_ring`.
+   size_t         cq_ring_size = 0;
+   io_uring_sqe   *sqes = (io_uring_sqe*) MAP_FAILED;    ///< Mapped submission queue entries.
+   size_t         sqes_size = 0;
+
+   unsigned       *sq_tail = nullptr;
+   unsigned       *sq_mask = nullptr;
+   unsigned       *sq_array = nullptr;
+   unsigned       *cq_head = nullptr;
+   unsigned       *cq_tail = nullptr;
+   unsigned       *cq_mask = nullptr;
+   io_uring_cqe   *cqes = nullptr;
+
+   unsigned       unpublished = 0;           ///< Number of entries filled in after the last published tail.
+   unsigned       unsubmitted = 0;           ///< Number of published entries not submitted to the kernel yet.
+
+   ~uring_t(void)
+   {
+      if(sqes != MAP_FAILED)
+         munmap(sqes, sqes_size);
+
+      if(cq_ring != MAP_FAILED && cq_ring != sq_ring)
+         munmap(cq_ring, cq_ring_size);
+
+      if(sq_ring != MAP_FAILED)
+         munmap(sq_ring, sq_ring_size);
+
+      if(fd != -1)
+         close(fd);
+   }
+
+   /// Returns a cleared submission queue entry, which is queued when `Submit` is called.
+   io_uring_sqe& GetSqe(void)
+   {
+      unsigned tail = *sq_tail + unpublished++;
+      unsigned index = tail & *sq_mask;
+
+      sq_array[index] = index;
+
+      memset(&sqes[index], 0, sizeof(io_uring_sqe));
+
+      return sqes[index];
+   }
+
+   /// Submits all queued entries and waits for `min_complete` completions.
+   void Submit(unsigned min_complete)
+   {
+      //
+      // Entries must be filled in before the kernel can see the new tail.
+      // Each entry is published only once, so if submitting fails, the
+      // next call submits remaining entries without moving the tail again.
+      //
+      if(unpublished) {
+         __atomic_store_n(sq_tail, *sq_tail + unpublished, __ATOMIC_RELEASE);
+         unsubmitted += unpublished;
+         unpublished = 0;
+      }
+
+      while(unsubmitted || min_complete) {
+         int submitted = (int) syscall(__NR_io_uring_enter, fd, unsubmitted, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+         if(submitted == -1) {
+            if(errno == EINTR)
+               continue;
+            throw std::system_error(errno, std::system_category(), "Cannot submit io_uring requests");
+         }
+
+         unsubmitted -= (unsigned) submitted;
+         min_complete = 0;
+      }
+   }
+};
+#else
+struct FileReader::uring_t {
+};
+#endif
+
+FileReader::FileReader(backend_t preferred, size_t depth) :
+      slots(std::max(depth, (size_t) 1)),
+      head(0),
+      active(0),
+      backend(preferred)
+{
+#if defined(__linux__)
+   if(backend == BACKEND_URING) {
+      uring = std::make_unique<uring_t>();
+
+      if(SetupUring())
+         return;
+
+      uring.reset();
+   }
+#endif
+
+   backend = BACKEND_THREADS;
+   workers = std::make_unique<WorkerPool>(slots.size());
+}
+
+FileReader::~FileReader(void)
+{
+#if defined(__linux__)
+   // requests in flight write into slot buffers, so they must complete first
+   if(uring) {
+      try {
+         for(const slot_t& slot : slots) {
+            while(slot.pending)
+               ReapUring(true);
+         }
+      }
+      catch (const std::exception&) {
+      }
+   }
+#endif
+}
+
+#if defined(__linux__)
+bool FileReader::SetupUring(void)
+{
+   io_uring_params params = {};
+
+   // each file takes up to three submission entries and completions
+   if((uring->fd = (int) syscall(__NR_io_uring_setup, (unsigned) slots.size() * 4, &params)) == -1)
+      return false;
+
+   uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+   uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+   uring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+   // both rings may be mapped with a single call since Linux 5.4
+   if(params.features & IORING_FEAT_SINGLE_MMAP)
+      uring->sq_ring_size = uring->cq_ring_size = std::max(uring->sq_ring_size, uring->cq_ring_size);
+
+   if((uring->sq_ring = mmap(nullptr, uring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+      return false;
+
+   if(params.features & IORING_FEAT_SINGLE_MMAP)
+      uring->cq_ring = uring->sq_ring;
+   else if((uring->cq_ring = mmap(nullptr, uring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+      return false;
+
+   if((uring->sqes = (io_uring_sqe*) mmap(nullptr, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES)) == MAP_FAILED)
+      return false;
+
+   uring->sq_tail = (unsigned*) ((char*) uring->sq_ring + params.sq_off.tail);
+   uring->sq_mask = (unsigned*) ((char*) uring->sq_ring + params.sq_off.ring_mask);
+   uring->sq_array = (unsigned*) ((char*) uring->sq_ring + params.sq_off.array);
+   uring->cq_head = (unsigned*) ((char*) uring->cq_ring + params.cq_off.head);
+   uring->cq_tail = (unsigned*) ((char*) uring->cq_ring + params.cq_off.tail);
+   uring->cq_mask = (unsigned*) ((char*) uring->cq_ring + params.cq_off.ring_mask);
+   uring->cqes = (io_uring_cqe*) ((char*) uring->cq_ring + params.cq_off.cqes);
+
+   // files are opened into a table of direct descriptors, one per slot, so reads can be linked to opens
+   std::vector<int> files(slots.size(), -1);
+
+   if(syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_FILES, files.data(), (unsigned) files.size()) == -1)
+      return false;
+
+   //
+   // Opening and closing direct descriptors requires Linux 5.15 or newer,
+   // and older kernels reject requests with unknown fields, so opening and
+   // closing the current directory tells whether linked file requests are
+   // supported.
+   //
+   io_uring_sqe& open_sqe = uring->GetSqe();
+
+   open_sqe.opcode = IORING_OP_OPENAT;
+   open_sqe.fd = AT_FDCWD;
+   open_sqe.addr = (uintptr_t) ".";
+   open_sqe.open_flags = O_RDONLY | O_DIRECTORY;
+   open_sqe.file_index = 1;
+   open_sqe.flags = IOSQE_IO_HARDLINK;
+
+   io_uring_sqe& close_sqe = uring->GetSqe();
+
+   close_sqe.opcode = IORING_OP_CLOSE;
+   close_sqe.file_index = 1;
+
+   try {
+      uring->Submit(2);
+   }
+   catch (const std::system_error&) {
+      return false;
+   }
+
+   bool supported = true;
+
+   for(unsigned completed = 0; completed < 2; ) {
+      unsigned cq_head = *uring->cq_head;
+      unsigned cq_tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+      for(; cq_head != cq_tail; cq_head++, completed++) {
+         if(uring->cqes[cq_head & *uring->cq_mask].res < 0)
+            supported = false;
+      }
+
+      __atomic_store_n(uring->cq_head, cq_head, __ATOMIC_RELEASE);
+
+      if(completed < 2 && syscall(__NR_io_uring_enter, uring->fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) == -1 && errno != EINTR)
+         return false;
+   }
+
+   return supported;
+}
+
+void FileReader::SubmitUringSlot(size_t index)
+{
+   slot_t& slot = slots[index];
+
+   // buffers grow to fit larger files and are reused for other files, which keeps two bytes for zero characters
+   slot.data.resize(std::max(slot.data.capacity(), min_read_size));
+
+   //
+   // Hard links are used because a read that returns fewer bytes than
+   // requested, which is the case for most files, breaks regular links,
+   // and because each file must be closed, even if reading it failed. If
+   // the file cannot be opened, the read fails on an empty descriptor.
+   //
+   io_uring_sqe& open_sqe = uring->GetSqe();
+
+   open_sqe.opcode = IORING_OP_OPENAT;
+   open_sqe.fd = AT_FDCWD;
+   open_sqe.addr = (uintptr_t) slot.path.c_str();
+   open_sqe.open_flags = O_RDONLY;
+   open_sqe.file_index = (uint32_t) index + 1;
+   open_sqe.flags = IOSQE_IO_HARDLINK;
+   open_sqe.user_data = index << uring_t::OP_BITS | uring_t::OP_OPEN;
+
+   io_uring_sqe& read_sqe = uring->GetSqe();
+
+   read_sqe.opcode = IORING_OP_READ;
+   read_sqe.fd = (int) index;
+   read_sqe.addr = (uintptr_t) &slot.data[0];
+   read_sqe.len = (uint32_t) std::min(slot.data.length() - 2, (size_t) UINT32_MAX);
+   read_sqe.off = 0;
+   read_sqe.flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+   read_sqe.user_data = index << uring_t::OP_BITS | uring_t::OP_READ;
+
+   io_uring_sqe& close_sqe = uring->GetSqe();
+
+   close_sqe.opcode = IORING_OP_CLOSE;
+   close_sqe.file_index = (uint32_t) index + 1;
+   close_sqe.user_data = index << uring_t::OP_BITS | uring_t::OP_CLOSE;
+
+   slot.pending = 3;
+}
+
+void FileReader::ReapUring(bool wait)
+{
+   if(wait)
+      uring->Submit(1);
+
+   unsigned cq_head = *uring->cq_head;
+   unsigned cq_tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+   for(; cq_head != cq_tail; cq_head++) {
+      const io_uring_cqe& cqe = uring->cqes[cq_head & *uring->cq_mask];
+      slot_t& slot = slots[cqe.user_data >> uring_t::OP_BITS];
+      uring_t::op_t op = (uring_t::op_t) (cqe.user_data & ((1 << uring_t::OP_BITS) - 1));
+
+      // the first error is reported, so a failed open is not masked by the read that follows it
+      if(cqe.res < 0 && !slot.error && op != uring_t::OP_CLOSE)
+         slot.error = -cqe.res;
+      else if(op == uring_t::OP_READ && cqe.res >= 0)
+         slot.length = (size_t) cqe.res;
+
+      if(--slot.pending == 0)
+         slot.done = true;
+   }
+
+   __atomic_store_n(uring->cq_head, cq_head, __ATOMIC_RELEASE);
+}
+#endif
+
+void FileReader::ReadSlot(slot_t& slot)
+{
+   FILE *file;
+
+   if((file = fopen(slot.path.c_str(), "r")) == nullptr) {
+      slot.error = errno;
+      return;
+   }
+
+   if(slot.length && fseek(file, (long) slot.length, SEEK_SET) != 0) {
+      slot.error = errno;
+      fclose(file);
+      return;
+   }
+
+   size_t size = std::max(slot.data.capacity(), min_read_size);
+
+   // double the buffer until a read returns fewer bytes than requested, at the end of the file or on an error
+   for(;;) {
+      slot.data.resize(size);
+
+      slot.length += fread(&slot.data[slot.length], 1, size - 2 - slot.length, file);
+
+      if(slot.length < size - 2)
+         break;
+
+      size *= 2;
+   }
+
+   if(ferror(file))
+      slot.error = errno ? errno : EIO;
+
+   fclose(file);
+}
+
+void FileReader::FillSlots(void)
+{
+   while(active < slots.size() && !queued.empty()) {
+      size_t index = (head + active) % slots.size();
+      slot_t& slot = slots[index];
+
+      slot.path = std::move(queued.front());
+      slot.length = 0;
+      slot.error = 0;
+      slot.done = false;
+
+      queued.pop_front();
+      active++;
+
+#if defined(__linux__)
+      if(uring) {
+         SubmitUringSlot(index);
+         continue;
+      }
+#endif
+
+      slot_t *slot_ptr = &slot;
+
+      workers->Submit([this, slot_ptr] (size_t)
+      {
+         ReadSlot(*slot_ptr);
+
+         {
+            std::lock_guard<std::mutex> lock(done_mtx);
+            slot_ptr->done = true;
+         }
+
+         done_cv.notify_all();
+      });
+   }
+
+#if defined(__linux__)
+   // requests for all new slots are submitted with a single call
+   if(uring && (uring->unpublished || uring->unsubmitted))
+      uring->Submit(0);
+#endif
+}
+
+void FileReader::Submit(std::string&& path)
+{
+   queued.push_back(std::move(path));
+
+   FillSlots();
+}
+
+int FileReader::Next(std::string& path, std::string& data)
+{
+   if(!active)
+      throw std::logic_error("No files are queued for reading");
+
+   slot_t& slot = slots[head];
+
+#if defined(__linux__)
+   if(uring) {
+      while(!slot.done)
+         ReapUring(true);
+
+      // a file that filled the buffer may be larger, so the rest of it is read synchronously
+      if(!slot.error && slot.length == slot.data.length() - 2)
+         ReadSlot(slot);
+   }
+   else
+#endif
+   {
+      std::unique_lock<std::mutex> lock(done_mtx);
+      done_cv.wait(lock, [&slot] {return slot.done;});
+   }
+
+   int error = slot.error;
+
+   if(!error) {
+      slot.data.resize(slot.length);
+      slot.data.append(2, '\0');
+   }
+
+   path.swap(slot.path);
+   data.swap(slot.data);
+
+   head = (head + 1) % slots.size();
+   active--;
+
+   // start reading the next file before the caller processes this one
+   FillSlots();
+
+   return error;
+}
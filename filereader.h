@@ -0,0 +1,130 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef FILEREADER_H
+#define FILEREADER_H
+
+#include "workerpool.h"
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+///
+/// @brief  Reads entire files asynchronously, keeping up to a fixed number
+///         of files in flight, and returns their contents in the order in
+///         which files were queued.
+///
+/// Each file being read occupies a slot with its own buffer, which is
+/// reused for another file once its contents are taken by the caller, so
+/// at most `depth` files are held in memory. Files are read while the
+/// caller processes contents of files that have been read before.
+///
+/// On Linux, files are read via io_uring, which opens, reads and closes
+/// each file with a chain of linked requests that are submitted for all
+/// free slots with a single system call. The first read of each file is
+/// sized to fit the slot buffer and the rest of larger files is read
+/// synchronously when the file is returned. If io_uring is not available,
+/// files are read with blocking calls on a pool of `depth` threads.
+///
+class FileReader {
+   public:
+      ///
+      /// @brief  Methods of reading files.
+      ///
+      enum backend_t {
+         BACKEND_URING,                      ///< Linked io_uring requests.
+         BACKEND_THREADS                     ///< Blocking reads on worker threads.
+      };
+
+   private:
+      struct uring_t;
+
+      ///
+      /// @brief  A file being read or waiting to be taken by the caller.
+      ///
+      struct slot_t {
+         std::string    path;                ///< File path.
+         std::string    data;                ///< File contents, followed by two zero characters when done.
+         size_t         length = 0;          ///< Number of bytes read.
+         int            error = 0;           ///< An `errno` value if the file could not be read.
+         size_t         pending = 0;         ///< Number of io_uring requests without completions.
+         bool           done = false;        ///< Set when the file has been read or has failed.
+      };
+
+   private:
+      static constexpr size_t min_read_size = 65536;
+
+      std::vector<slot_t>     slots;         ///< A ring of slots of files being read.
+      size_t                  head;          ///< Index of the oldest slot in use.
+      size_t                  active;        ///< Number of slots in use.
+
+      std::deque<std::string> queued;        ///< Paths of files waiting for a free slot.
+
+      backend_t               backend;       ///< Method of reading files.
+
+      std::unique_ptr<uring_t> uring;        ///< io_uring instance for `BACKEND_URING`.
+
+      std::mutex              done_mtx;      ///< Protects `done` flags of slots for `BACKEND_THREADS`.
+      std::condition_variable done_cv;       ///< Signals slots read by worker threads.
+
+      // must be declared after slots, so workers are stopped before slots are destroyed
+      std::unique_ptr<WorkerPool> workers;   ///< Reading threads for `BACKEND_THREADS`.
+
+   private:
+      /// Starts reading queued files into free slots.
+      void FillSlots(void);
+
+      /// Reads the file in the slot with blocking calls, from the offset `slot.length`.
+      static void ReadSlot(slot_t& slot);
+
+#if defined(__linux__)
+      /// Sets up io_uring and returns `false` if it is not available or does not support linked file requests.
+      bool SetupUring(void);
+
+      /// Queues io_uring requests to open, read and close the file in the slot `index`.
+      void SubmitUringSlot(size_t index);
+
+      /// Processes io_uring completions, waiting for at least one if `wait` is `true`.
+      void ReapUring(bool wait);
+#endif
+
+   public:
+      ///
+      /// @brief  Creates a reader with `depth` slots, which uses the backend
+      ///         `preferred` or, if io_uring is not available, worker threads.
+      ///
+      FileReader(backend_t preferred, size_t depth);
+
+      FileReader(const FileReader&) = delete;
+
+      /// Waits for all files being read and releases all resources.
+      ~FileReader(void);
+
+      FileReader& operator = (const FileReader&) = delete;
+
+      /// Returns the method used to read files.
+      backend_t GetBackend(void) const {return backend;}
+
+      /// Queues a file to be read.
+      void Submit(std::string&& path);
+
+      ///
+      /// @brief  Waits for the oldest queued file, which is returned in
+      ///         `path` and, followed by two zero characters, in `data`, and
+      ///         returns zero or an `errno` value if the file cannot be read.
+      ///
+      /// The buffer previously held in `data` is reused to read other files.
+      /// This method must not be called when no files are queued.
+      ///
+      int Next(std::string& path, std::string& data);
+};
+
+#endif // FILEREADER_H
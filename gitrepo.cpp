@@ -0,0 +1,893 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "gitrepo.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <dirent.h>
+#endif
+
+#include <zlib.h>
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+///
+/// @brief  Reads the entire file into `data`. Returns `false` if the file
+///         cannot be opened or read.
+///
+static bool ReadFileData(const std::string& filepath, std::string& data)
+{
+   char buffer[65536];
+   size_t length;
+   FILE *file;
+
+   if((file = fopen(filepath.c_str(), "rb")) == nullptr)
+      return false;
+
+   data.clear();
+
+   while((length = fread(buffer, 1, sizeof(buffer), file)) != 0)
+      data.append(buffer, length);
+
+   // directories may be opened on some systems, but cannot be read
+   bool read_error = ferror(file) != 0;
+
+   fclose(file);
+
+   return !read_error;
+}
+
+///
+/// @brief  Collects names of all entries in the directory, except `.` and
+///         `..`, in `names`. Returns `false` if the directory cannot be
+///         opened.
+///
+static bool ListDirectory(const std::string& dirpath, std::vector<std::string>& names)
+{
+   names.clear();
+
+#if defined(_WIN32)
+   struct _finddata_t fileinfo;
+   intptr_t fhandle;
+
+   if((fhandle = _findfirst((dirpath + "/*").c_str(), &fileinfo)) == -1)
+      return false;
+
+   do {
+      if(strcmp(fileinfo.name, ".") && strcmp(fileinfo.name, ".."))
+         names.push_back(fileinfo.name);
+   } while(_findnext(fhandle, &fileinfo) == 0);
+
+   _findclose(fhandle);
+#else
+   DIR *dir;
+   struct dirent *entry;
+
+   if((dir = opendir(dirpath.c_str())) == nullptr)
+      return false;
+
+   while((entry = readdir(dir)) != nullptr) {
+      if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+         names.push_back(entry->d_name);
+   }
+
+   closedir(dir);
+#endif
+
+   return true;
+}
+
+///
+/// @brief  Returns `str` without trailing white space.
+///
+static std::string TrimRight(std::string str)
+{
+   while(!str.empty() && strchr(" \t\r\n", str.back()))
+      str.pop_back();
+
+   return str;
+}
+
+///
+/// @brief  Returns the value of a hex digit or `-1` if `ch` is not one.
+///
+static int GetHexValue(char ch)
+{
+   if(ch >= '0' && ch <= '9')
+      return ch - '0';
+
+   if(ch >= 'a' && ch <= 'f')
+      return ch - 'a' + 10;
+
+   if(ch >= 'A' && ch <= 'F')
+      return ch - 'A' + 10;
+
+   return -1;
+}
+
+static uint32_t GetUInt32(const uint8_t *ptr)
+{
+   return (uint32_t) ptr[0] << 24 | (uint32_t) ptr[1] << 16 | (uint32_t) ptr[2] << 8 | (uint32_t) ptr[3];
+}
+
+static uint64_t GetUInt64(const uint8_t *ptr)
+{
+   return (uint64_t) GetUInt32(ptr) << 32 | GetUInt32(ptr + 4);
+}
+
+GitRepo::pack_t::~pack_t(void)
+{
+   if(packfile)
+      fclose(packfile);
+}
+
+GitRepo::GitRepo(const std::string& path)
+{
+   std::string data;
+
+   //
+   // Linked working trees and submodules have a .git file, which refers
+   // to the actual Git directory. Otherwise, look for a working tree with
+   // a .git directory and then for a bare repository.
+   //
+   if(ReadFileData(path + "/.git", data) && !data.compare(0, 8, "gitdir: ")) {
+      gitdir = TrimRight(data.substr(8));
+
+#if defined(_WIN32)
+      if(!strchr("\\/", gitdir[0]) && (gitdir.length() < 2 || gitdir[1] != ':'))
+#else
+      if(gitdir[0] != '/')
+#endif
+         gitdir = path + "/" + gitdir;
+   }
+   else if(ReadFileData(path + "/.git/HEAD", data))
+      gitdir = path + "/.git";
+   else if(ReadFileData(path + "/HEAD", data))
+      gitdir = path;
+   else
+      throw std::runtime_error("Not a Git repository: " + path);
+
+   // linked working trees keep objects and branches in the main Git directory
+   if(ReadFileData(gitdir + "/commondir", data)) {
+      commondir = TrimRight(data);
+
+#if defined(_WIN32)
+      if(!strchr("\\/", commondir[0]) && (commondir.length() < 2 || commondir[1] != ':'))
+#else
+      if(commondir[0] != '/')
+#endif
+         commondir = gitdir + "/" + commondir;
+   }
+   else
+      commondir = gitdir;
+
+   LoadPacks();
+}
+
+void GitRepo::LoadPacks(void)
+{
+   std::string packdir = commondir + "/objects/pack";
+   std::vector<std::string> names;
+
+   // a repository without packs has no pack directory
+   if(!ListDirectory(packdir, names))
+      return;
+
+   std::sort(names.begin(), names.end());
+
+   for(const std::string& name : names) {
+      if(name.length() <= 4 || name.compare(name.length() - 4, 4, ".idx"))
+         continue;
+
+      std::unique_ptr<pack_t> pack = std::make_unique<pack_t>();
+
+      pack->packpath = packdir + "/" + name.substr(0, name.length() - 4) + ".pack";
+
+      LoadPackIndex(packdir + "/" + name, *pack);
+
+      packs.push_back(std::move(pack));
+   }
+}
+
+void GitRepo::LoadPackIndex(const std::string& indexpath, pack_t& pack)
+{
+   // magic, version and fan-out table, followed by the pack and index checksums at the end
+   static constexpr size_t header_size = 8 + 256 * 4;
+   static constexpr size_t trailer_size = 2 * 20;
+
+   if(!ReadFileData(indexpath, pack.index))
+      throw std::runtime_error("Cannot read Git pack index " + indexpath);
+
+   const uint8_t *index = (const uint8_t*) pack.index.data();
+
+   if(pack.index.length() < header_size + trailer_size || memcmp(index, "\377tOc", 4) || GetUInt32(index + 4) != 2)
+      throw std::runtime_error("Unsupported Git pack index " + indexpath);
+
+   pack.fanout = index + 8;
+   pack.count = GetUInt32(pack.fanout + 255 * 4);
+
+   // object identifiers, CRC-32 values and 31-bit offsets, followed by 64-bit offsets
+   size_t table_size = (size_t) pack.count * (20 + 4 + 4);
+
+   if(pack.index.length() < header_size + table_size + trailer_size)
+      throw std::runtime_error("Invalid Git pack index " + indexpath);
+
+   pack.ids = index + header_size;
+   pack.offsets = pack.ids + (size_t) pack.count * (20 + 4);
+   pack.large_offsets = pack.offsets + (size_t) pack.count * 4;
+   pack.large_count = (pack.index.length() - header_size - table_size - trailer_size) / 8;
+}
+
+bool GitRepo::FindPackedObject(const pack_t& pack, const object_id_t& id, uint64_t& offset)
+{
+   size_t lo = id[0] ? GetUInt32(pack.fanout + (id[0] - 1) * 4) : 0;
+   size_t hi = GetUInt32(pack.fanout + id[0] * 4);
+
+   while(lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      int result = memcmp(pack.ids + mid * 20, id.data(), 20);
+
+      if(result < 0)
+         lo = mid + 1;
+      else if(result > 0)
+         hi = mid;
+      else {
+         offset = GetUInt32(pack.offsets + mid * 4);
+
+         // the high bit selects an entry in the 64-bit offset table
+         if(offset & 0x80000000) {
+            if((offset &= 0x7fffffff) >= pack.large_count)
+               throw std::runtime_error("Invalid Git pack index for " + pack.packpath);
+
+            offset = GetUInt64(pack.large_offsets + offset * 8);
+         }
+
+         return true;
+      }
+   }
+
+   return false;
+}
+
+GitRepo::object_type_t GitRepo::ReadLooseObject(const object_id_t& id, std::string& data) const
+{
+   std::string hex = FormatId(id);
+   std::string packed;
+
+   if(!ReadFileData(commondir + "/objects/" + hex.substr(0, 2) + "/" + hex.substr(2), packed))
+      return OBJ_NONE;
+
+   z_stream stream = {};
+   std::string object(packed.length() * 4 + 64, '\0');
+   int status;
+
+   if(inflateInit(&stream) != Z_OK)
+      throw std::runtime_error("Cannot initialize zlib");
+
+   stream.next_in = (Bytef*) packed.data();
+   stream.avail_in = (uInt) packed.length();
+
+   // loose objects store their size in the header, so inflate into a growing buffer
+   do {
+      if(stream.total_out == object.length())
+         object.resize(object.length() * 2);
+
+      stream.next_out = (Bytef*) &object[stream.total_out];
+      stream.avail_out = (uInt) (object.length() - stream.total_out);
+
+      status = inflate(&stream, Z_NO_FLUSH);
+   } while(status == Z_OK);
+
+   object.resize(stream.total_out);
+
+   inflateEnd(&stream);
+
+   if(status != Z_STREAM_END)
+      throw std::runtime_error("Cannot inflate Git object " + hex);
+
+   // the header is the object type, a space, the object size and a null character
+   size_t space = object.find(' ');
+   size_t null = object.find('\0');
+
+   if(space == std::string::npos || null == std::string::npos || space > null || strtoull(object.c_str() + space + 1, nullptr, 10) != object.length() - null - 1)
+      throw std::runtime_error("Invalid Git object " + hex);
+
+   object_type_t type;
+
+   if(!object.compare(0, space, "blob"))
+      type = OBJ_BLOB;
+   else if(!object.compare(0, space, "tree"))
+      type = OBJ_TREE;
+   else if(!object.compare(0, space, "commit"))
+      type = OBJ_COMMIT;
+   else if(!object.compare(0, space, "tag"))
+      type = OBJ_TAG;
+   else
+      throw std::runtime_error("Invalid Git object type in " + hex);
+
+   object.erase(0, null + 1);
+   data.swap(object);
+
+   return type;
+}
+
+void GitRepo::InflatePackData(pack_t& pack, uint64_t offset, size_t size, std::string& data)
+{
+   unsigned char buffer[16384];
+   z_stream stream = {};
+   int status = Z_OK;
+
+   if(size > UINT_MAX)
+      throw std::runtime_error("Git object is too large in " + pack.packpath);
+
+#if defined(_WIN32)
+   if(_fseeki64(pack.packfile, (int64_t) offset, SEEK_SET))
+#else
+   if(fseeko(pack.packfile, (off_t) offset, SEEK_SET))
+#endif
+      throw std::runtime_error("Cannot read Git pack " + pack.packpath);
+
+   data.resize(size);
+
+   if(inflateInit(&stream) != Z_OK)
+      throw std::runtime_error("Cannot initialize zlib");
+
+   stream.next_out = (Bytef*) &data[0];
+   stream.avail_out = (uInt) size;
+
+   while(status == Z_OK) {
+      if(stream.avail_in == 0) {
+         if((stream.avail_in = (uInt) fread(buffer, 1, sizeof(buffer), pack.packfile)) == 0)
+            break;
+
+         stream.next_in = buffer;
+      }
+
+      status = inflate(&stream, Z_NO_FLUSH);
+   }
+
+   inflateEnd(&stream);
+
+   if(status != Z_STREAM_END || stream.total_out != size)
+      throw std::runtime_error("Cannot inflate Git object in " + pack.packpath);
+}
+
+void GitRepo::ApplyDelta(const std::string& base, const std::string& delta, std::string& data)
+{
+   const uint8_t *ptr = (const uint8_t*) delta.data();
+   const uint8_t *end = ptr + delta.length();
+
+   // reads a variable-length size, 7 bits at a time, starting with the least significant bits
+   auto read_size = [&ptr, end] () -> uint64_t
+   {
+      uint64_t size = 0;
+      int shift = 0;
+
+      do {
+         if(ptr == end || shift > 63)
+            throw std::runtime_error("Invalid Git delta");
+
+         size |= (uint64_t) (*ptr & 0x7f) << shift;
+         shift += 7;
+      } while(*ptr++ & 0x80);
+
+      return size;
+   };
+
+   if(read_size() != base.length())
+      throw std::runtime_error("Git delta does not match its base");
+
+   uint64_t size = read_size();
+
+   data.clear();
+   data.reserve(size);
+
+   while(ptr < end) {
+      uint8_t cmd = *ptr++;
+
+      if(cmd & 0x80) {
+         // copy from the base, with offset and size bytes present only if their bits are set
+         uint64_t copy_offset = 0;
+         uint64_t copy_size = 0;
+
+         for(int i = 0; i < 4; i++) {
+            if(cmd & (1 << i)) {
+               if(ptr == end)
+                  throw std::runtime_error("Invalid Git delta");
+               copy_offset |= (uint64_t) *ptr++ << (i * 8);
+            }
+         }
+
+         for(int i = 0; i < 3; i++) {
+            if(cmd & (0x10 << i)) {
+               if(ptr == end)
+                  throw std::runtime_error("Invalid Git delta");
+               copy_size |= (uint64_t) *ptr++ << (i * 8);
+            }
+         }
+
+         if(copy_size == 0)
+            copy_size = 0x10000;
+
+         if(copy_offset + copy_size > base.length())
+            throw std::runtime_error("Invalid Git delta");
+
+         data.append(base, (size_t) copy_offset, (size_t) copy_size);
+      }
+      else if(cmd) {
+         // insert the command number of bytes that follow
+         if((size_t) (end - ptr) < cmd)
+            throw std::runtime_error("Invalid Git delta");
+
+         data.append((const char*) ptr, cmd);
+         ptr += cmd;
+      }
+      else
+         throw std::runtime_error("Invalid Git delta");
+   }
+
+   if(data.length() != size)
+      throw std::runtime_error("Git delta size does not match");
+}
+
+void GitRepo::CacheBase(const pack_t *pack, uint64_t offset, object_type_t type, const std::string& data)
+{
+   // large objects would evict many smaller bases
+   if(data.length() > max_base_cache_size / 8)
+      return;
+
+   if(base_cache_size + data.length() > max_base_cache_size) {
+      base_cache.clear();
+      base_cache_size = 0;
+   }
+
+   if(base_cache[pack].emplace(offset, base_t {type, data}).second)
+      base_cache_size += data.length();
+}
+
+GitRepo::object_type_t GitRepo::ReadPackedObject(pack_t *pack, uint64_t offset, std::string& data)
+{
+   // a delta that is not resolved yet
+   struct delta_t {
+      pack_t         *pack;                  // pack of the deltified object
+      uint64_t       offset;                 // offset of the deltified object
+      std::string    delta;                  // inflated delta data
+   };
+
+   std::vector<delta_t> chain;
+   object_type_t type;
+
+   //
+   // Follow the delta chain to the first object that is either stored
+   // whole or found in the base cache, and then apply deltas in reverse
+   // order. Resolved bases are cached, so later objects that are deltas
+   // against the same bases don't need to resolve the entire chain again.
+   //
+   for(;;) {
+      auto cached_pack = base_cache.find(pack);
+
+      if(cached_pack != base_cache.end()) {
+         auto cached = cached_pack->second.find(offset);
+
+         if(cached != cached_pack->second.end()) {
+            type = cached->second.type;
+            data = cached->second.data;
+            break;
+         }
+      }
+
+      if(!pack->packfile && (pack->packfile = fopen(pack->packpath.c_str(), "rb")) == nullptr)
+         throw std::system_error(errno, std::system_category(), "Cannot open Git pack " + pack->packpath);
+
+#if defined(_WIN32)
+      if(_fseeki64(pack->packfile, (int64_t) offset, SEEK_SET))
+#else
+      if(fseeko(pack->packfile, (off_t) offset, SEEK_SET))
+#endif
+         throw std::runtime_error("Cannot read Git pack " + pack->packpath);
+
+      // the longest header is a 10-byte size followed by a 20-byte base identifier
+      uint8_t header[32];
+      size_t length = fread(header, 1, sizeof(header), pack->packfile);
+      size_t pos = 0;
+
+      // object type and the inflated size, with 4 bits in the first byte and 7 bits in each following one
+      if(length == 0)
+         throw std::runtime_error("Invalid Git pack offset in " + pack->packpath);
+
+      uint8_t ch = header[pos++];
+      uint64_t size = ch & 0x0f;
+      int shift = 4;
+
+      type = (object_type_t) ((ch >> 4) & 0x07);
+
+      while(ch & 0x80) {
+         if(pos == length || shift > 57)
+            throw std::runtime_error("Invalid Git pack object header in " + pack->packpath);
+
+         ch = header[pos++];
+         size |= (uint64_t) (ch & 0x7f) << shift;
+         shift += 7;
+      }
+
+      if(type == OBJ_OFS_DELTA) {
+         // base offset is relative to this object and adds one for each continuation byte
+         if(pos == length)
+            throw std::runtime_error("Invalid Git pack object header in " + pack->packpath);
+
+         ch = header[pos++];
+         uint64_t base_offset = ch & 0x7f;
+
+         while(ch & 0x80) {
+            if(pos == length)
+               throw std::runtime_error("Invalid Git pack object header in " + pack->packpath);
+
+            ch = header[pos++];
+            base_offset = ((base_offset + 1) << 7) | (ch & 0x7f);
+         }
+
+         if(base_offset == 0 || base_offset > offset)
+            throw std::runtime_error("Invalid Git delta base offset in " + pack->packpath);
+
+         chain.push_back({pack, offset, std::string()});
+         InflatePackData(*pack, offset + pos, (size_t) size, chain.back().delta);
+
+         offset -= base_offset;
+         continue;
+      }
+
+      if(type == OBJ_REF_DELTA) {
+         object_id_t base_id;
+
+         if(length - pos < base_id.size())
+            throw std::runtime_error("Invalid Git pack object header in " + pack->packpath);
+
+         memcpy(base_id.data(), header + pos, base_id.size());
+         pos += base_id.size();
+
+         chain.push_back({pack, offset, std::string()});
+         InflatePackData(*pack, offset + pos, (size_t) size, chain.back().delta);
+
+         // bases of thin packs that were fixed may be in other packs or loose
+         bool found = false;
+
+         for(size_t index = 0; index < packs.size() && !found; index++) {
+            if(FindPackedObject(*packs[index], base_id, offset)) {
+               pack = packs[index].get();
+               found = true;
+            }
+         }
+
+         if(found)
+            continue;
+
+         if((type = ReadLooseObject(base_id, data)) == OBJ_NONE)
+            throw std::runtime_error("Cannot find Git delta base " + FormatId(base_id));
+
+         pack = nullptr;
+         break;
+      }
+
+      if(type < OBJ_COMMIT || type > OBJ_TAG)
+         throw std::runtime_error("Invalid Git pack object type in " + pack->packpath);
+
+      InflatePackData(*pack, offset + pos, (size_t) size, data);
+      break;
+   }
+
+   std::string object;
+
+   while(!chain.empty()) {
+      if(pack)
+         CacheBase(pack, offset, type, data);
+
+      ApplyDelta(data, chain.back().delta, object);
+
+      data.swap(object);
+
+      pack = chain.back().pack;
+      offset = chain.back().offset;
+
+      chain.pop_back();
+   }
+
+   return type;
+}
+
+GitRepo::object_type_t GitRepo::ReadObject(const object_id_t& id, std::string& data)
+{
+   uint64_t offset;
+   object_type_t type;
+
+   for(const std::unique_ptr<pack_t>& pack : packs) {
+      if(FindPackedObject(*pack, id, offset))
+         return ReadPackedObject(pack.get(), offset, data);
+   }
+
+   if((type = ReadLooseObject(id, data)) == OBJ_NONE)
+      throw std::runtime_error("Cannot find Git object " + FormatId(id));
+
+   return type;
+}
+
+void GitRepo::ReadTree(const object_id_t& id, std::vector<tree_entry_t>& entries)
+{
+   std::string data;
+
+   if(ReadObject(id, data) != OBJ_TREE)
+      throw std::runtime_error("Git object is not a tree: " + FormatId(id));
+
+   entries.clear();
+
+   // each entry is an octal mode, a space, a name, a null character and a binary identifier
+   size_t pos = 0;
+
+   while(pos < data.length()) {
+      tree_entry_t entry;
+      size_t space = data.find(' ', pos);
+      size_t null = data.find('\0', pos);
+
+      if(space == std::string::npos || null == std::string::npos || space > null || data.length() - null - 1 < entry.id.size())
+         throw std::runtime_error("Invalid Git tree " + FormatId(id));
+
+      entry.mode = (uint32_t) strtoul(data.c_str() + pos, nullptr, 8);
+      entry.name.assign(data, space + 1, null - space - 1);
+      memcpy(entry.id.data(), data.data() + null + 1, entry.id.size());
+
+      entries.push_back(std::move(entry));
+
+      pos = null + 1 + entries.back().id.size();
+   }
+}
+
+GitRepo::object_id_t GitRepo::GetTreeId(const object_id_t& id)
+{
+   object_id_t object_id = id;
+   std::string data;
+
+   // tags may refer to other tags
+   for(;;) {
+      switch(ReadObject(object_id, data)) {
+         case OBJ_TREE:
+            return object_id;
+         case OBJ_COMMIT:
+            if(data.compare(0, 5, "tree ") || !ParseId(std::string_view(data).substr(5, 40), object_id))
+               throw std::runtime_error("Invalid Git commit " + FormatId(object_id));
+            return object_id;
+         case OBJ_TAG:
+            if(data.compare(0, 7, "object ") || !ParseId(std::string_view(data).substr(7, 40), object_id))
+               throw std::runtime_error("Invalid Git tag " + FormatId(object_id));
+            break;
+         default:
+            throw std::runtime_error("Git object is not a tree or a commit: " + FormatId(object_id));
+      }
+   }
+}
+
+GitRepo::object_id_t GitRepo::GetParentId(const object_id_t& id, unsigned long number)
+{
+   object_id_t object_id = id;
+   object_type_t type;
+   std::string data;
+
+   while((type = ReadObject(object_id, data)) == OBJ_TAG) {
+      if(data.compare(0, 7, "object ") || !ParseId(std::string_view(data).substr(7, 40), object_id))
+         throw std::runtime_error("Invalid Git tag " + FormatId(object_id));
+   }
+
+   if(type != OBJ_COMMIT)
+      throw std::runtime_error("Git object is not a commit: " + FormatId(object_id));
+
+   // parent lines follow the tree line in the order of parents
+   for(size_t pos = data.find('\n'); pos != std::string::npos && !data.compare(pos + 1, 7, "parent "); pos = data.find('\n', pos + 1)) {
+      if(--number == 0) {
+         if(!ParseId(std::string_view(data).substr(pos + 8, 40), object_id))
+            throw std::runtime_error("Invalid Git commit " + FormatId(id));
+         return object_id;
+      }
+   }
+
+   throw std::runtime_error("Git commit has no such parent: " + FormatId(id));
+}
+
+bool GitRepo::ReadRef(const std::string& refname, object_id_t& id, int depth) const
+{
+   std::string data;
+
+   // symbolic references are not supposed to be nested deeper than this
+   if(depth > 5)
+      return false;
+
+   // per-worktree references, such as HEAD, are in the Git directory and branches are in the common one
+   if(ReadFileData(gitdir + "/" + refname, data) || (commondir != gitdir && ReadFileData(commondir + "/" + refname, data))) {
+      data = TrimRight(data);
+
+      if(!data.compare(0, 5, "ref: "))
+         return ReadRef(data.substr(5), id, depth + 1);
+
+      return ParseId(data, id);
+   }
+
+   // each packed reference is an identifier followed by a space and a reference name on the same line
+   if(!ReadFileData(commondir + "/packed-refs", data))
+      return false;
+
+   size_t pos = 0;
+
+   while(pos < data.length()) {
+      size_t end = data.find('\n', pos);
+
+      if(end == std::string::npos)
+         end = data.length();
+
+      std::string_view line(data.data() + pos, end - pos);
+
+      if(!line.empty() && line.back() == '\r')
+         line.remove_suffix(1);
+
+      if(line.length() == 41 + refname.length() && line[40] == ' ' && line.substr(41) == refname)
+         return ParseId(line.substr(0, 40), id);
+
+      pos = end + 1;
+   }
+
+   return false;
+}
+
+bool GitRepo::FindAbbreviatedId(const std::string& prefix, object_id_t& id) const
+{
+   std::vector<object_id_t> matches;
+   std::vector<std::string> names;
+   object_id_t match;
+
+   // returns true if the object identifier starts with the hex prefix
+   auto has_prefix = [&prefix] (const uint8_t *object_id) -> bool
+   {
+      for(size_t i = 0; i < prefix.length(); i++) {
+         if(GetHexValue(prefix[i]) != ((i & 1) ? object_id[i / 2] & 0x0f : object_id[i / 2] >> 4))
+            return false;
+      }
+      return true;
+   };
+
+   // loose objects are stored in directories named after the first two hex digits
+   if(ListDirectory(commondir + "/objects/" + prefix.substr(0, 2), names)) {
+      for(const std::string& name : names) {
+         if(!name.compare(0, prefix.length() - 2, prefix, 2) && ParseId(prefix.substr(0, 2) + name, match))
+            matches.push_back(match);
+      }
+   }
+
+   uint8_t first_byte = (uint8_t) (GetHexValue(prefix[0]) << 4 | GetHexValue(prefix[1]));
+
+   for(const std::unique_ptr<pack_t>& pack : packs) {
+      size_t lo = first_byte ? GetUInt32(pack->fanout + (first_byte - 1) * 4) : 0;
+      size_t hi = GetUInt32(pack->fanout + first_byte * 4);
+
+      for(size_t index = lo; index < hi; index++) {
+         if(has_prefix(pack->ids + index * 20)) {
+            memcpy(match.data(), pack->ids + index * 20, match.size());
+            matches.push_back(match);
+         }
+      }
+   }
+
+   // the same object may be both loose and packed, or in multiple packs
+   std::sort(matches.begin(), matches.end());
+   matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+   if(matches.size() > 1)
+      throw std::runtime_error("Ambiguous Git object identifier " + prefix);
+
+   if(matches.empty())
+      return false;
+
+   id = matches.front();
+
+   return true;
+}
+
+GitRepo::object_id_t GitRepo::ResolveRevision(const std::string& revision)
+{
+   static const char *ref_patterns[] = {"%s", "refs/%s", "refs/tags/%s", "refs/heads/%s", "refs/remotes/%s", "refs/remotes/%s/HEAD"};
+
+   size_t end = revision.find_first_of("^~");
+   std::string name = revision.substr(0, end);
+   object_id_t id;
+   bool found = false;
+
+   if(name.empty())
+      throw std::runtime_error("Invalid Git revision: " + revision);
+
+   // full identifiers take precedence over references, which take precedence over abbreviated identifiers
+   if(name.length() == 40)
+      found = ParseId(name, id);
+
+   for(size_t index = 0; index < sizeof(ref_patterns) / sizeof(ref_patterns[0]) && !found; index++) {
+      std::string refname(ref_patterns[index]);
+
+      refname.replace(refname.find("%s"), 2, name);
+
+      found = ReadRef(refname, id);
+   }
+
+   if(!found && name.length() >= 4 && name.length() < 40 && std::all_of(name.begin(), name.end(), [] (char ch) {return GetHexValue(ch) != -1;}))
+      found = FindAbbreviatedId(name, id);
+
+   if(!found)
+      throw std::runtime_error("Unknown Git revision: " + revision);
+
+   // ^n selects the n-th parent and ~n selects the n-th first-parent ancestor
+   while(end < revision.length()) {
+      char op = revision[end++];
+      unsigned long number = 1;
+
+      if(end < revision.length() && isdigit((unsigned char) revision[end])) {
+         char *endptr;
+
+         number = strtoul(revision.c_str() + end, &endptr, 10);
+         end = endptr - revision.c_str();
+      }
+
+      if(end < revision.length() && !strchr("^~", revision[end]))
+         throw std::runtime_error("Invalid Git revision: " + revision);
+
+      if(op == '^') {
+         // ^0 refers to the commit itself
+         if(number)
+            id = GetParentId(id, number);
+      }
+      else {
+         for(; number; number--)
+            id = GetParentId(id, 1);
+      }
+   }
+
+   return id;
+}
+
+std::string GitRepo::FormatId(const object_id_t& id)
+{
+   static const char hex_digits[] = "0123456789abcdef";
+   std::string hex;
+
+   hex.reserve(id.size() * 2);
+
+   for(uint8_t byte : id) {
+      hex.push_back(hex_digits[byte >> 4]);
+      hex.push_back(hex_digits[byte & 0x0f]);
+   }
+
+   return hex;
+}
+
+bool GitRepo::ParseId(std::string_view hex, object_id_t& id)
+{
+   if(hex.length() != id.size() * 2)
+      return false;
+
+   for(size_t index = 0; index < id.size(); index++) {
+      int hi = GetHexValue(hex[index * 2]);
+      int lo = GetHexValue(hex[index * 2 + 1]);
+
+      if(hi == -1 || lo == -1)
+         return false;
+
+      id[index] = (uint8_t) (hi << 4 | lo);
+   }
+
+   return true;
+}
@@ -0,0 +1,189 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef GITREPO_H
+#define GITREPO_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+///
+/// @brief  A read-only view of the object database of a local Git
+///         repository, which reads objects without a working tree.
+///
+/// Objects are read from loose object files and from pack files, which
+/// are located via their version 2 index files. Deltified pack objects
+/// are resolved against their bases, which are kept in a size-limited
+/// cache because consecutive trees and blobs in a pack tend to share
+/// the same bases.
+///
+/// Only SHA-1 repositories are supported. Object alternates and shallow
+/// clones with missing objects are not supported.
+///
+/// This class is not thread-safe.
+///
+class GitRepo {
+   public:
+      /// Object identifier, which is the SHA-1 hash of the object.
+      typedef std::array<uint8_t, 20> object_id_t;
+
+      ///
+      /// @brief  Hashes object identifiers, which are uniformly distributed.
+      ///
+      struct object_id_hash_t {
+         size_t operator () (const object_id_t& id) const
+         {
+            size_t hash;
+            memcpy(&hash, id.data(), sizeof(hash));
+            return hash;
+         }
+      };
+
+      ///
+      /// @brief  Object types, with values used in pack files.
+      ///
+      enum object_type_t {
+         OBJ_NONE = 0,
+         OBJ_COMMIT = 1,
+         OBJ_TREE = 2,
+         OBJ_BLOB = 3,
+         OBJ_TAG = 4,
+         OBJ_OFS_DELTA = 6,                  ///< Pack-only delta against an object at a relative offset.
+         OBJ_REF_DELTA = 7                   ///< Pack-only delta against an object with an identifier.
+      };
+
+      ///
+      /// @brief  A tree entry.
+      ///
+      struct tree_entry_t {
+         uint32_t    mode;                   ///< Entry mode (e.g. `040000` for trees, `100644` for blobs).
+         std::string name;                   ///< Entry name, without separators.
+         object_id_t id;                     ///< Identifier of the tree or the blob.
+
+         /// Returns `true` if the entry is a sub-tree.
+         bool IsTree(void) const {return (mode & 0170000) == 0040000;}
+
+         /// Returns `true` if the entry is a regular file (symbolic links and submodules are not).
+         bool IsFile(void) const {return (mode & 0170000) == 0100000;}
+      };
+
+   private:
+      ///
+      /// @brief  A pack file with its index.
+      ///
+      struct pack_t {
+         std::string             packpath;   ///< Pack file path.
+         std::string             index;      ///< Contents of the index file.
+         uint32_t                count = 0;  ///< Number of objects in the pack.
+         const uint8_t           *fanout = nullptr;   ///< Number of objects with the first byte less than or equal to each value.
+         const uint8_t           *ids = nullptr;      ///< Sorted object identifiers.
+         const uint8_t           *offsets = nullptr;  ///< 31-bit offsets or indexes of 64-bit offsets.
+         const uint8_t           *large_offsets = nullptr;  ///< 64-bit offsets.
+         size_t                  large_count = 0;     ///< Number of 64-bit offsets.
+         FILE                    *packfile = nullptr; ///< Pack file stream, opened when first read.
+
+         ~pack_t(void);
+      };
+
+      ///
+      /// @brief  A resolved delta base, identified by its pack and offset.
+      ///
+      struct base_t {
+         object_type_t  type;                ///< Object type.
+         std::string    data;                ///< Object contents.
+      };
+
+   private:
+      static constexpr size_t max_base_cache_size = 64 * 1024 * 1024;  ///< Size of all cached delta bases.
+
+      std::string          gitdir;           ///< Repository directory, with `HEAD`.
+      std::string          commondir;        ///< Directory with objects and shared references.
+
+      std::vector<std::unique_ptr<pack_t>> packs;  ///< Packs in the repository.
+
+      std::unordered_map<const pack_t*, std::unordered_map<uint64_t, base_t>> base_cache;  ///< Delta bases, by pack and offset.
+      size_t               base_cache_size = 0;     ///< Size of all cached delta bases, in bytes.
+
+   private:
+      /// Reads pack index files in the object directory.
+      void LoadPacks(void);
+
+      /// Reads the version 2 pack index file for the pack.
+      static void LoadPackIndex(const std::string& indexpath, pack_t& pack);
+
+      /// Returns the offset of the object in the pack via `offset`, or `false` if it's not in the pack.
+      static bool FindPackedObject(const pack_t& pack, const object_id_t& id, uint64_t& offset);
+
+      /// Reads a loose object. Returns `OBJ_NONE` if there is no such loose object.
+      object_type_t ReadLooseObject(const object_id_t& id, std::string& data) const;
+
+      /// Reads an object at the offset in the pack, resolving any deltas.
+      object_type_t ReadPackedObject(pack_t *pack, uint64_t offset, std::string& data);
+
+      /// Inflates exactly `size` bytes from the pack stream at `offset` into `data`.
+      static void InflatePackData(pack_t& pack, uint64_t offset, size_t size, std::string& data);
+
+      /// Applies the delta to the base and returns the resulting object in `data`.
+      static void ApplyDelta(const std::string& base, const std::string& delta, std::string& data);
+
+      /// Adds a resolved delta base to the cache, discarding all cached bases if the cache is full.
+      void CacheBase(const pack_t *pack, uint64_t offset, object_type_t type, const std::string& data);
+
+      /// Reads a reference, following symbolic references.
+      bool ReadRef(const std::string& refname, object_id_t& id, int depth = 0) const;
+
+      /// Finds a single object with an abbreviated identifier of at least 4 hex digits.
+      bool FindAbbreviatedId(const std::string& prefix, object_id_t& id) const;
+
+      /// Returns the identifier of the `number`-th parent of the commit, starting with one.
+      object_id_t GetParentId(const object_id_t& id, unsigned long number);
+
+   public:
+      ///
+      /// @brief  Opens the repository at `path`, which may be a working tree
+      ///         with a `.git` directory or file, or a Git directory.
+      ///
+      GitRepo(const std::string& path);
+
+      GitRepo(const GitRepo&) = delete;
+
+      GitRepo& operator = (const GitRepo&) = delete;
+
+      ///
+      /// @brief  Resolves a revision to an object identifier.
+      ///
+      /// A revision is a full or an abbreviated object identifier or a
+      /// reference name, such as `HEAD`, `main`, `v1.0` or `origin/main`,
+      /// optionally followed by any number of `^`, `^n`, `~` and `~n`
+      /// suffixes, which select commit parents and ancestors.
+      ///
+      object_id_t ResolveRevision(const std::string& revision);
+
+      /// Returns the identifier of the tree of a commit or of a tag that refers to a commit or a tree.
+      object_id_t GetTreeId(const object_id_t& id);
+
+      /// Reads the object and returns its type. Throws an exception if the object does not exist.
+      object_type_t ReadObject(const object_id_t& id, std::string& data);
+
+      /// Reads the tree and returns its entries in `entries`, in the order they are stored in the tree.
+      void ReadTree(const object_id_t& id, std::vector<tree_entry_t>& entries);
+
+      /// Returns the object identifier as 40 lowercase hex digits.
+      static std::string FormatId(const object_id_t& id);
+
+      /// Parses 40 hex digits into an object identifier. Returns `false` if `hex` is not a valid identifier.
+      static bool ParseId(std::string_view hex, object_id_t& id);
+};
+
+#endif // GITREPO_H
@@ -0,0 +1,68 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "languages.h"
+
+#include <cctype>
+#include <cstring>
+#include <string>
+
+namespace {
+
+//
+// Identifiers must match the position of each language in this list and
+// the language of unregistered extensions must be the last one.
+//
+const std::vector<language_t> Languages = {
+   {0,  "C/C++",        "cpp",         SimdLexer::PROFILE_C,      {"cpp", "cxx", "cc", "c++", "hpp", "hxx", "h++", "h", "c"}},
+   {1,  "Java",         "java",        SimdLexer::PROFILE_C,      {"java"}},
+   {2,  "C#",           "csharp",      SimdLexer::PROFILE_C,      {"cs"}},
+   {3,  "JavaScript",   "js",          SimdLexer::PROFILE_JS,     {"js", "mjs", "cjs", "jsx"}},
+   {4,  "TypeScript",   "ts",          SimdLexer::PROFILE_JS,     {"ts", "tsx"}},
+   {5,  "Shell",        "shell",       SimdLexer::PROFILE_HASH,   {"sh", "bash", "zsh", "ksh"}},
+   {6,  "Python",       "python",      SimdLexer::PROFILE_HASH,   {"py", "pyw"}},
+   {7,  "YAML",         "yaml",        SimdLexer::PROFILE_HASH,   {"yml", "yaml"}},
+   {8,  "Perl",         "perl",        SimdLexer::PROFILE_HASH,   {"pl", "pm"}},
+   {9,  "Ruby",         "ruby",        SimdLexer::PROFILE_HASH,   {"rb"}},
+   {10, "SQL",          "sql",         SimdLexer::PROFILE_SQL,    {"sql"}},
+   {11, "Lua",          "lua",         SimdLexer::PROFILE_LUA,    {"lua"}},
+   {12, "Other",        nullptr,       SimdLexer::PROFILE_C,      {}}
+};
+
+}
+
+const std::vector<language_t>& GetLanguages(void)
+{
+   return Languages;
+}
+
+const language_t *FindLanguage(const char *option)
+{
+   for(const language_t& language : Languages) {
+      if(language.option && !strcmp(language.option, option))
+         return &language;
+   }
+
+   return nullptr;
+}
+
+const language_t& GetExtensionLanguage(const char *ext)
+{
+   std::string lcext(ext);
+
+   for(char& chr : lcext)
+      chr = (char) tolower((unsigned char) chr);
+
+   for(const language_t& language : Languages) {
+      for(const char *langext : language.extensions) {
+         if(lcext == langext)
+            return language;
+      }
+   }
+
+   return Languages.back();
+}
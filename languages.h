@@ -0,0 +1,46 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef LANGUAGES_H
+#define LANGUAGES_H
+
+#include "simdlexer.h"
+
+#include <cstddef>
+#include <vector>
+
+///
+/// @brief  A source language, which selects the syntax profile for files
+///         with its extensions and groups their totals.
+///
+struct language_t {
+   size_t                     id;            ///< Index of the language in the registry.
+   const char                 *name;         ///< Name reported with language totals.
+   const char                 *option;       ///< Name used in `--lang`, or `nullptr` if none.
+   SimdLexer::profile_t       profile;       ///< Comment and string syntax profile.
+   std::vector<const char*>   extensions;    ///< Lowercase file extensions, without periods.
+};
+
+///
+/// @brief  Returns all registered languages, followed by the language of
+///         unregistered extensions. Language identifiers are indexes in
+///         the returned vector.
+///
+const std::vector<language_t>& GetLanguages(void);
+
+/// Returns the language with the `--lang` name `option` or `nullptr` if there is no such language.
+const language_t *FindLanguage(const char *option);
+
+///
+/// @brief  Returns the language of files with the extension, which is
+///         matched without regard to case.
+///
+/// Files with unregistered extensions are counted as C-like sources.
+///
+const language_t& GetExtensionLanguage(const char *ext);
+
+#endif // LANGUAGES_H
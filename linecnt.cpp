@@ -7,11 +7,14 @@
 */
 #if defined(_WIN32)
 #include <io.h>
+#include <fcntl.h>
 #include <direct.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
@@ -19,22 +22,47 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
-#include <list>
-#include <stack>
+#include <algorithm>
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <exception>
 #include <stdexcept>
 #include <system_error>
 
 #include "cpplexer.h"
+#include "simdlexer.h"
+#include "languages.h"
+#include "counter.h"
+#include "allocstats.h"
+#include "countcache.h"
+#include "contenthash.h"
+#include "totals.h"
+#include "runstats.h"
+#include "outputwriter.h"
+#include "gitrepo.h"
+#include "tarreader.h"
+#include "filereader.h"
+#include "namelist.h"
+#include "pathfilter.h"
+#if defined(__linux__)
+#include "treewatcher.h"
+#endif
 #include "version.h"
 
 #if defined(_WIN32)
-#define stricmp _stricmp
 #define getcwd _getcwd
 #else
-#define stricmp strcasecmp
 #define _MAX_PATH 4096
 #endif
 
@@ -48,27 +76,31 @@
 #endif
 
 ///
-/// @brief  Case-insensitive string comparison predicate.
+/// @brief  Methods of reading files when they are processed sequentially.
 ///
-struct less_stricmp {
-   bool operator () (const std::string& str1, const std::string& str2) const
-   {
-      return stricmp(str1.c_str(), str2.c_str()) < 0;
-   }
+enum io_t {
+   IO_SYNC,                               // each file is read after the previous one is counted
+   IO_URING,                              // files are read ahead via io_uring (FileReader)
+   IO_THREADS                             // files are read ahead on reading threads (FileReader)
 };
 
-//
-// Various counters
-//
-static int FileCount = 0;                 // total file count
-static int DirCount = 1;                  // total directory count
-static int LineCount = 0;                 // total source line count
-static int CppLineCount = 0;              // C++ -commented line count
-static int CLineCount = 0;                // C-commented line count
-static int CommentCount = 0;              // commented line count
-static int EmptyLineCount = 0;            // empty line count
-static int BraceLineCount = 0;            // brace-only line count
-static int CodeLineCount = 0;             // code line count
+///
+/// @brief  Handling of files with identical contents.
+///
+enum dedup_t {
+   DEDUP_NONE,                            // every file is parsed
+   DEDUP_REUSE,                           // line counts of the first identical file are reused
+   DEDUP_UNIQUE                           // same as DEDUP_REUSE, but duplicates are not included in totals
+};
+
+///
+/// @brief  Output formats.
+///
+enum format_t {
+   FORMAT_TABLE,                          // verbose output tables and a summary
+   FORMAT_JSONL,                          // a JSON object per file and one for totals
+   FORMAT_CSV                             // a CSV header and a CSV record per file
+};
 
 //
 // Run flags
@@ -76,254 +108,1140 @@ static int CodeLineCount = 0;             // code line count
 static bool VerboseOutput = false;
 static bool WalkTree = false;
 
-// a set of case-insensitive file extensions to process
-static std::set<std::string, less_stricmp>   ExtList;
+// output format (machine-readable formats always list all files)
+static format_t Format = FORMAT_TABLE;
+
+// duplicate file handling
+static dedup_t Dedup = DEDUP_NONE;
+
+// number of threads parsing source files (no worker threads are started if it's 1)
+static unsigned int JobCount = 1;
 
-void EnumDirectory(const std::string& dirname, std::list<std::string>& files, std::list<std::string>& subdirs);
+// method and queue depth of reading files ahead when a single thread counts lines
+static io_t IoMethod = IO_SYNC;
+static size_t IoDepth = 32;
+
+// line counting engine, memory mapping and chunking options, which are set on LineCounter after parsing all options
+static Counter::options_t CountOptions;
+
+// counts lines in files with extensions added from the command line
+static Counter LineCounter;
+
+// patterns of excluded (true) and included (false) paths, in the order they were specified
+static std::vector<std::pair<std::string, bool>> PathPatterns;
+
+// read patterns of excluded paths from .gitignore in the starting directory, but not in sub-directories
+static bool GitIgnore = false;
+
+// totals of each language, indexed by language identifiers
+static std::vector<Totals> LanguageTotals;
+
+// a list of files to process instead of scanning directories (- for stdin; empty - directories are scanned)
+static std::string FileListPath;
+
+// a Git revision to read files from instead of the working tree (empty - files are read from the file system)
+static std::string GitRevision;
+
+// a tar archive to read files from, optionally compressed with gzip (- for stdin; empty - files are read from the file system)
+static std::string TarPath;
+
+// per-file output, which is written only from the main thread and flushed after each directory
+static OutputWriter Output(stdout);
+
+// line counts cached between runs (no cache is used if the path is empty)
+static std::string CachePath;
+static std::unique_ptr<CountCache> Cache;
+
+// files are counted again when they change, until the directory goes away (Linux only)
+static bool Watch = false;
+
+// reads files ahead of counting lines on the main thread (files are read as they are counted if it's a null pointer)
+static std::unique_ptr<FileReader> Reader;
+
+// run statistics (no statistics are collected if it's a null pointer)
+static std::unique_ptr<RunStats> Stats;
+static std::string StatsPath;             // JSON report path (- for stdout; empty - text report)
+static bool StatsEnabled = false;
 
 ///
-/// @brief  Parses the specified file with a Flex parser and updates
-///         various counters.
-/// 
-/// When running in verbose mode, will print per-file counts.
+/// @brief  Identifies file contents for duplicate detection.
+///
+struct content_key_t {
+   uint64_t    hash;                      // XXH64 hash of file contents
+   uint64_t    size;                      // file size, which makes hash collisions less likely
+   SimdLexer::profile_t profile;          // identical contents are counted differently in other languages
+
+   bool operator == (const content_key_t& other) const
+   {
+      return hash == other.hash && size == other.size && profile == other.profile;
+   }
+};
+
+struct content_key_hash_t {
+   size_t operator () (const content_key_t& key) const
+   {
+      return (size_t) key.hash;
+   }
+};
+
+// line counts of the first file with specific contents (used with --dedup)
+static std::unordered_map<content_key_t, CppFlexLexer::Result, content_key_hash_t> ContentCounts;
+static std::mutex ContentMtx;
+
+///
+/// @brief  Adds totals of a single file in `language` to `totals` and to
+///         the totals of the language.
+///
+/// Line counts of files with duplicate contents are not added when only
+/// unique files are counted, but their number and size still are.
+///
+void AddFileTotals(Totals& totals, const Totals& file, const language_t& language)
+{
+   if(file.dupfilecnt && Dedup == DEDUP_UNIQUE) {
+      Totals dup = file;
+
+      dup.lines = CppFlexLexer::Result();
+
+      totals += dup;
+      LanguageTotals[language.id] += dup;
+   }
+   else {
+      totals += file;
+      LanguageTotals[language.id] += file;
+   }
+}
+
+///
+/// @brief  Counts lines in `length` characters in `buffer`, reusing line
+///         counts of a file with identical contents when `--dedup` is used.
 ///
-void ParseSourceFile(const std::string& dirname, const std::string& filename)
+/// Files with contents seen before are counted as duplicates. If two
+/// threads count identical files at the same time, both are parsed, but
+/// only the first one to finish is considered unique.
+///
+Totals CountBufferLines(char *buffer, size_t length, SimdLexer::profile_t profile)
 {
-   FILE *srcfile;
+   Totals totals;
+
+   totals.filecnt = 1;
+   totals.bytecnt = length;
+
+   if(Dedup == DEDUP_NONE) {
+      totals.lines = LineCounter.LexBuffer(buffer, length, profile);
+      return totals;
+   }
 
-   srcfile = fopen((dirname + DIRSEP + filename).c_str(), "r");
+   // hash the buffer before the Flex scanner modifies it
+   RunStats::PhaseTimer hash_timer(Stats.get(), RunStats::PHASE_HASH);
 
-   if(srcfile == nullptr)
-      throw std::system_error(errno, std::system_category(), filename);
+   content_key_t key = {HashContent(buffer, length), length, profile};
 
-   CppFlexLexer cpplex(std::move(srcfile));
+   hash_timer.Stop();
 
-   CppFlexLexer::Result counts = cpplex.CountLines();
+   {
+      std::lock_guard<std::mutex> lock(ContentMtx);
+
+      auto iter = ContentCounts.find(key);
+
+      if(iter != ContentCounts.end()) {
+         totals.lines = iter->second;
+         totals.dupfilecnt = 1;
+         totals.dupbytecnt = length;
+         return totals;
+      }
+   }
+
+   totals.lines = LineCounter.LexBuffer(buffer, length, profile);
 
-   if(VerboseOutput) {
-      char cpp_c_cnt[32];
-      // make a shared column for C and C++ commented line counts
-      sprintf(cpp_c_cnt, "%d/%d", counts.cppcnt, counts.ccnt); 
-      printf("   %5d  %5d      %5d  %10s  %5d  %5d  %s\n", counts.linecnt, counts.codecnt,
-                                                            counts.cmntcnt, cpp_c_cnt,
-                                                            counts.emptycnt, counts.bracecnt,
-                                                            filename.c_str());
+   std::lock_guard<std::mutex> lock(ContentMtx);
+
+   if(!ContentCounts.emplace(key, totals.lines).second) {
+      totals.dupfilecnt = 1;
+      totals.dupbytecnt = length;
    }
 
-   EmptyLineCount += counts.emptycnt;
-   BraceLineCount += counts.bracecnt;
-   LineCount += counts.linecnt;
-   CodeLineCount += counts.codecnt;
-   CppLineCount += counts.cppcnt;
-   CLineCount += counts.ccnt;
-   CommentCount += counts.cmntcnt;
+   return totals;
 }
 
 ///
-/// @brief  Processes all files in `files` in the specified directory.
-/// 
-void ProcessFileList(const std::string& dirname, std::list<std::string>&& files)
+/// @brief  Returns totals of the file `filepath` from the count cache
+///         or, if it's not cached or has changed, reads and counts it with
+///         `read` and updates the cache.
+///
+/// This function may be called concurrently from multiple threads.
+///
+Totals LookupCachedFile(const std::string& filepath, const language_t&, const std::function<Totals(void)>& read)
 {
-   bool header = false;
-   int filecnt = 0;
+   CountCache::file_info_t fileinfo;
+   bool cacheable;
+   Totals totals;
 
-   if(files.size() == 0)
-      return;
+   {
+      RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_CACHE);
 
-   for(const std::string& filename : files) {
-      if(VerboseOutput) {
-         if(!header) {
-            printf("Directory: %s\n\n", dirname.c_str());
-            printf("   Lines   Code  Commented     (C++/C)  Empty  Brace\n");
-            printf("  ------ ------ ---------- ----------- ------ ------\n");
-            header = true;
-         }
+      // files that cannot be looked up are reported when they are opened
+      cacheable = CountCache::GetFileInfo(filepath, fileinfo);
 
-         filecnt++;
+      // cached files are not hashed, so unique totals require reading all files
+      if(cacheable && Dedup != DEDUP_UNIQUE && Cache->Lookup(filepath, fileinfo, totals.lines)) {
+         totals.filecnt = 1;
+         totals.bytecnt = fileinfo.size;
+         totals.cachedcnt = 1;
+         return totals;
       }
+   }
+
+   totals = read();
+
+   if(cacheable) {
+      RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_CACHE);
 
-      ParseSourceFile(dirname, filename);
-      FileCount++;
+      Cache->Update(filepath, fileinfo, totals.lines);
    }
 
-   if(VerboseOutput && filecnt)
-      printf("\n");
+   return totals;
+}
 
-   files.clear();
+///
+/// @brief  Queues files in `dirpath` to be read by `Reader`, so they are
+///         read while preceding files are counted.
+///
+void SubmitReadAhead(const std::string& dirpath, const NameList& files)
+{
+   for(size_t index = 0; index < files.GetCount(); index++)
+      Reader->Submit(dirpath + DIRSEP + files[index]);
 }
 
 ///
-/// @brief  Processes files in `basedir` and all sub-directories in `dirs`.
+/// @brief  Counts lines of the next file returned by `Reader` in `language`,
+///         which is expected to be `filepath`, instead of reading the file.
+///
+/// Contents and the path of each file are exchanged for the buffers of
+/// the previous file, so buffers are reused by the reader.
 ///
-void ProcessDirList(const std::string& basedir, std::list<std::string>&& dirs)
+Totals ReadAheadFile(const std::string& filepath, const language_t& language, const std::function<Totals(void)>&)
 {
-   // processing state of a directory
-   struct state_t {
-      std::list<std::string>  subdirs;    // sub-directory names, no separators, under dirname
-      std::string             dirname;    // directory that is being processed
-   };
+   static std::string source;
+   static std::string readpath;
+
+   // time spent waiting for the reader to catch up
+   RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_READ);
 
-   std::string dirpath = basedir;
-   std::stack<state_t> stack;
-   std::list<std::string>::iterator iter;
+   int error = Reader->Next(readpath, source);
 
-   //
-   // Use the top state for the base directory and its sub-directories.
-   // It's worth noting that unlike other states, dirname in this one
-   // is a path and not just a name.
-   //
-   stack.push({std::move(dirs), dirpath});
+   timer.Stop();
 
-   std::list<std::string> *subdirs = &stack.top().subdirs;
+   if(error)
+      throw std::system_error(error, std::system_category(), filepath);
 
-   iter = subdirs->begin();
+   return CountBufferLines(source.data(), source.length() - 2, language.profile);
+}
+
+///
+/// @brief  Prints the verbose output header for the specified directory.
+///
+void PrintDirectoryHeader(const std::string& dirname)
+{
+   if(Format != FORMAT_TABLE)
+      return;
 
-   while(iter != subdirs->end()) {
+   Output.Write("Directory: ").Write(dirname).Write("\n\n");
+   Output.Write("   Lines   Code  Commented     (C++/C)  Empty  Brace\n");
+   Output.Write("  ------ ------ ---------- ----------- ------ ------\n");
+}
 
-      DirCount++;
+///
+/// @brief  Ends the verbose output for a directory and writes out all
+///         of its buffered records.
+///
+void PrintDirectoryFooter(void)
+{
+   if(Format == FORMAT_TABLE)
+      Output.Write('\n');
 
-      // add the new directory to the current path
-      dirpath += DIRSEP + *iter;
+   Output.Flush();
+}
 
-      // move the new directory name into the new top state
-      stack.push({std::list<std::string>(), std::move(*iter)});
+///
+/// @brief  Prints line counts for the specified file in verbose mode.
+///
+void PrintFileCounts(const std::string& dirname, const std::string_view& filename, const language_t& language, const CppFlexLexer::Result& counts)
+{
+   // reused for all records, which are printed only from the main thread
+   static std::string filepath;
 
-      // remove the empty directory node from the state list
-      subdirs->erase(iter);
+   switch(Format) {
+      case FORMAT_TABLE:
+         {
+            char cpp_c_cnt[48];
+            char *ptr = cpp_c_cnt;
 
-      // and assign the pointer to the new directory list
-      subdirs = &stack.top().subdirs;
+            // make a shared column for C and C++ commented line counts
+            ptr += OutputWriter::FormatUInt(counts.cppcnt, ptr);
+            *ptr++ = '/';
+            ptr += OutputWriter::FormatUInt(counts.ccnt, ptr);
 
-      // populate the directory list and the file list for the new directory
-      std::list<std::string> files;
-      EnumDirectory(dirpath, files, *subdirs);
+            Output.Write("   ").WriteUInt(counts.linecnt, 5).Write("  ").WriteUInt(counts.codecnt, 5);
+            Output.Write("      ").WriteUInt(counts.cmntcnt, 5).Write("  ");
 
-      // and process all files in the current directory
-      ProcessFileList(dirpath, std::move(files));
+            for(size_t width = ptr - cpp_c_cnt; width < 10; width++)
+               Output.Write(' ');
 
-      // pop all empty directory lists from the stack
-      while(subdirs->empty()) {
-         //
-         // The first stack frame contains the base directory and should not
-         // be erased below because its pattern doesn't follow the pattern
-         // of enumerated child directories, which is a separator followed
-         // by a directory name.
-         //
-         if(stack.size() > 1) {
-            // chop off the current directory from the path, along with the separator
-            dirpath.erase(dirpath.length() - stack.top().dirname.length() - 1);
+            Output.Write(std::string_view(cpp_c_cnt, ptr - cpp_c_cnt));
+            Output.Write("  ").WriteUInt(counts.emptycnt, 5).Write("  ").WriteUInt(counts.bracecnt, 5);
+            Output.Write("  ").Write(filename).Write('\n');
          }
+         break;
+      case FORMAT_JSONL:
+         filepath.assign(dirname).append(DIRSEP).append(filename);
+
+         Output.Write("{\"type\":\"file\",\"path\":").WriteJsonString(filepath);
+         Output.Write(",\"language\":").WriteJsonString(language.name);
+         Output.Write(",\"lines\":").WriteUInt(counts.linecnt);
+         Output.Write(",\"code\":").WriteUInt(counts.codecnt);
+         Output.Write(",\"comments\":").WriteUInt(counts.cmntcnt);
+         Output.Write(",\"cpp_comments\":").WriteUInt(counts.cppcnt);
+         Output.Write(",\"c_comments\":").WriteUInt(counts.ccnt);
+         Output.Write(",\"empty\":").WriteUInt(counts.emptycnt);
+         Output.Write(",\"braces\":").WriteUInt(counts.bracecnt);
+         Output.Write("}\n");
+         break;
+      case FORMAT_CSV:
+         filepath.assign(dirname).append(DIRSEP).append(filename);
+
+         Output.WriteCsvString(filepath);
+         Output.Write(',').WriteCsvString(language.name);
+         Output.Write(',').WriteUInt(counts.linecnt);
+         Output.Write(',').WriteUInt(counts.codecnt);
+         Output.Write(',').WriteUInt(counts.cmntcnt);
+         Output.Write(',').WriteUInt(counts.cppcnt);
+         Output.Write(',').WriteUInt(counts.ccnt);
+         Output.Write(',').WriteUInt(counts.emptycnt);
+         Output.Write(',').WriteUInt(counts.bracecnt);
+         Output.Write('\n');
+         break;
+   }
+}
 
-         stack.pop();
+///
+/// @brief  Returns options of counting trees and file lists, with hooks
+///         of the count cache, reading ahead and `--dedup`, as configured.
+///
+Counter::tree_options_t GetTreeOptions(void)
+{
+   Counter::tree_options_t tree_options;
 
-         if(stack.empty())
-            return;
+   tree_options.recursive = WalkTree;
+   tree_options.jobs = JobCount;
 
-         // reset the directory list to the parent directory at the top
-         subdirs = &stack.top().subdirs;
-      }
+   // files are read ahead only without the cache
+   if(Cache)
+      tree_options.lookup = LookupCachedFile;
+   else if(Reader) {
+      tree_options.lookup = ReadAheadFile;
+      tree_options.prefetch = SubmitReadAhead;
+   }
+
+   if(Dedup != DEDUP_NONE)
+      tree_options.count_buffer = [] (char *buffer, size_t length, const language_t& language) {return CountBufferLines(buffer, length, language.profile);};
+
+   return tree_options;
+}
+
+///
+/// @brief  Counts files with `count`, which calls `LineCounter` with the
+///         tree options and the callback it's given, reports each file and
+///         returns totals.
+///
+/// Verbose output of a directory starts with its first file and ends when
+/// files of another directory are reported or when counting ends, even if
+/// it ends with an error. Directories without files are not reported.
+///
+Totals ReportFiles(const std::function<Totals(const Counter::tree_options_t&, const Counter::file_callback_t&)>& count)
+{
+   std::string report_dir;                // directory of the last reported file (empty - none yet)
+   Totals totals;
+
+   try {
+      totals.dircnt = count(GetTreeOptions(), [&report_dir, &totals] (const std::string& dirpath, const char *filename, const language_t& language, const Totals& file)
+      {
+         if(VerboseOutput) {
+            if(report_dir != dirpath) {
+               if(!report_dir.empty())
+                  PrintDirectoryFooter();
+
+               PrintDirectoryHeader(dirpath);
+               report_dir = dirpath;
+            }
 
-      iter = subdirs->begin();
+            PrintFileCounts(dirpath, filename, language, file.lines);
+         }
+
+         AddFileTotals(totals, file, language);
+      }).dircnt;
    }
+   catch (...) {
+      if(!report_dir.empty())
+         PrintDirectoryFooter();
+      throw;
+   }
+
+   if(!report_dir.empty())
+      PrintDirectoryFooter();
+
+   return totals;
 }
 
 ///
-/// @brief  Enumerates files and directories in the specified directory.
+/// @brief  Processes files in the specified directory and, if requested,
+///         in all sub-directories and returns their totals.
 ///
-/// Enumerated files and directories are collected in `files` and `subdirs`.
-/// 
-/// Directories whose names begin with a period are skipped (e.g. `.`, `..`
-/// `.git`, `.vs`).
-/// 
-/// Only files with extensions matching those in the extension set are
-/// collected.
-/// 
-void EnumDirectory(const std::string& dirname, std::list<std::string>& files, std::list<std::string>& subdirs)
+Totals ProcessDirectory(const std::string& dirname)
+{
+   return ReportFiles([&dirname] (const Counter::tree_options_t& tree_options, const Counter::file_callback_t& callback)
+   {
+      return LineCounter.CountTree(dirname, tree_options, callback);
+   });
+}
+
+///
+/// @brief  Reads a list of file paths from the specified file or, if `-`
+///         is used, from the standard input.
+///
+/// Paths are separated by null characters if the list contains any, as
+/// produced by `git diff -z` or `find -print0`, and by new lines, which
+/// may be preceded by carriage returns, otherwise. Empty paths are
+/// ignored.
+///
+std::vector<std::string> ReadFileList(const std::string& listpath)
 {
-   files.clear();
-   subdirs.clear();
+   RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_ENUM);
 
+   std::vector<std::string> paths;
+   std::string list;
+   char buffer[65536];
+   size_t length;
+   FILE *listfile;
+
+   if(listpath == "-") {
 #if defined(_WIN32)
-   struct _finddata_t fileinfo;
-   intptr_t fhandle;
+      // keep carriage returns and Ctrl-Z characters in the list as-is
+      _setmode(_fileno(stdin), _O_BINARY);
+#endif
+      listfile = stdin;
+   }
+   else if((listfile = fopen(listpath.c_str(), "rb")) == nullptr)
+      throw std::system_error(errno, std::system_category(), "Cannot open a file list " + listpath);
 
-   // get all files and directories, except current and parent directories
-   std::string dirpat(dirname + DIRSEP + "*.*");
+   while((length = fread(buffer, 1, sizeof(buffer), listfile)) != 0)
+      list.append(buffer, length);
 
-   if((fhandle = _findfirst(dirpat.c_str(), &fileinfo)) == -1)
-      throw std::runtime_error("Cannot enumerate directory: " + dirname);
+   bool read_error = ferror(listfile) != 0;
 
-   do {
-      if(fileinfo.attrib & _A_SUBDIR) {
-         // skip any directory that starts with a period (e.g. ".", "..", ".git", ".vs", etc)
-         if(*fileinfo.name == '.')
-            continue;
+   if(listfile != stdin)
+      fclose(listfile);
 
-         if(*fileinfo.name)
-            subdirs.push_back(fileinfo.name);
-         continue;
+   if(read_error)
+      throw std::runtime_error("Cannot read a file list " + listpath);
+
+   char separator = list.find('\0') != std::string::npos ? '\0' : '\n';
+
+   for(size_t start = 0, end; start < list.length(); start = end + 1) {
+      if((end = list.find(separator, start)) == std::string::npos)
+         end = list.length();
+
+      size_t pathlen = end - start;
+
+      if(separator == '\n' && pathlen && list[end - 1] == '\r')
+         pathlen--;
+
+      if(pathlen)
+         paths.emplace_back(list, start, pathlen);
+   }
+
+   return paths;
+}
+
+///
+/// @brief  Processes files in the path list, without scanning any
+///         directories, and returns their totals.
+///
+/// Relative paths are resolved against `basedir`, unless it's empty.
+///
+Totals ProcessPathList(const std::string& basedir, const std::vector<std::string>& paths)
+{
+   return ReportFiles([&basedir, &paths] (const Counter::tree_options_t& tree_options, const Counter::file_callback_t& callback)
+   {
+      return LineCounter.CountFileList(basedir, paths, tree_options, callback);
+   });
+}
+
+///
+/// @brief  Line counts and the size of a Git blob.
+///
+struct blob_counts_t {
+   CppFlexLexer::Result    lines;         // line counts
+   uint64_t                size;          // blob size, in bytes
+   SimdLexer::profile_t    profile;       // syntax profile the blob was counted with
+};
+
+///
+/// @brief  Counts lines in a Git blob with the selected engine, unless
+///         it was counted before in this run or its line counts are in
+///         the count cache, and returns its totals.
+///
+/// Blobs with the same identifier have identical contents, so their line
+/// counts are reused without reading them again, unless the blob was
+/// counted with another syntax profile. Repeated blobs are only counted
+/// as duplicates when `--dedup` is used.
+///
+Totals CountGitBlob(GitRepo& repo, const GitRepo::object_id_t& id, const std::string& filepath, SimdLexer::profile_t profile, std::unordered_map<GitRepo::object_id_t, blob_counts_t, GitRepo::object_id_hash_t>& blob_counts)
+{
+   Totals totals;
+   std::string blobkey;
+   std::chrono::steady_clock::time_point start_time;
+
+   totals.filecnt = 1;
+
+   auto iter = blob_counts.find(id);
+
+   if(iter != blob_counts.end() && iter->second.profile == profile) {
+      totals.lines = iter->second.lines;
+      totals.bytecnt = iter->second.size;
+
+      if(Dedup != DEDUP_NONE) {
+         totals.dupfilecnt = 1;
+         totals.dupbytecnt = iter->second.size;
       }
 
-      if(*fileinfo.name) {
-         const char *ext = strrchr(fileinfo.name, '.');
+      return totals;
+   }
+
+   if(Stats)
+      start_time = std::chrono::steady_clock::now();
+
+   if(Cache) {
+      RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_CACHE);
 
-         if(ext && ExtList.find(++ext) != ExtList.end())
-            files.push_back(fileinfo.name);
+      // blob identifiers are hashes of their contents, so cached counts are valid for any revision
+      blobkey = "git:" + GitRepo::FormatId(id);
+
+      if(profile != SimdLexer::PROFILE_C)
+         blobkey += ":" + std::to_string(profile);
+
+      if(Cache->LookupContent(blobkey, totals.bytecnt, totals.lines)) {
+         totals.cachedcnt = 1;
+         blob_counts.emplace(id, blob_counts_t {totals.lines, totals.bytecnt, profile});
+         return totals;
       }
+   }
 
-   } while(_findnext(fhandle, &fileinfo) == 0);
+   // reused for all blobs, which are read only from the main thread
+   static std::string blob;
 
-   _findclose(fhandle);
-#else
-   DIR *dir;
-   struct dirent *entry;
-   struct stat statinfo;
+   RunStats::PhaseTimer read_timer(Stats.get(), RunStats::PHASE_READ);
+
+   if(repo.ReadObject(id, blob) != GitRepo::OBJ_BLOB)
+      throw std::runtime_error("Git object is not a blob: " + filepath);
+
+   read_timer.Stop();
+
+   totals.bytecnt = blob.length();
+
+   // two zero characters are required by the Flex scanner
+   blob.append(2, '\0');
+
+   totals.lines = LineCounter.LexBuffer(blob.data(), blob.length() - 2, profile);
+
+   blob_counts.emplace(id, blob_counts_t {totals.lines, totals.bytecnt, profile});
+
+   if(Cache) {
+      RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_CACHE);
+
+      CountCache::file_info_t fileinfo;
+
+      fileinfo.size = totals.bytecnt;
+
+      Cache->Update(blobkey, fileinfo, totals.lines);
+   }
+
+   if(Stats)
+      Stats->AddFile(filepath, totals.bytecnt, (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count());
+
+   return totals;
+}
+
+///
+/// @brief  Processes files in the tree of a revision in the Git repository
+///         in `repodir` and, if requested, in all of its sub-trees, and
+///         returns their totals.
+///
+/// Files are read from the object database, without a working tree, and
+/// are reported with paths under `repodir`, in the order of entries in
+/// Git trees, which are sorted by name, rather than in the inode order
+/// of scanned directories. Symbolic links and submodules are ignored.
+///
+/// Same as with directories, the state of each level of the tree is
+/// reused for all trees at that depth, so entry lists and paths stop
+/// allocating memory once they have grown to fit the largest trees.
+///
+Totals ProcessGitRevision(const std::string& repodir, const std::string& revision)
+{
+   // processing state of a level of the tree
+   struct level_t {
+      std::vector<GitRepo::tree_entry_t> entries;  // tree entries, sorted by name
+      size_t      next = 0;               // next entry to check for a sub-tree
+      std::string dirpath;                // path of this tree under repodir
+   };
+
+   std::unordered_map<GitRepo::object_id_t, blob_counts_t, GitRepo::object_id_hash_t> blob_counts;
+   std::vector<level_t> levels(1);
+   size_t depth = 0;
+   std::string filepath;
+   PathFilter::dir_state_t dir_state;
+   const PathFilter& path_filter = LineCounter.GetPathFilter();
+   Totals totals;
+
+   GitRepo repo(repodir);
 
-   if((dir = opendir(dirname.c_str())) == nullptr) 
-      throw std::runtime_error("Cannot open directory: " + dirname);
+   GitRepo::object_id_t tree_id = repo.GetTreeId(repo.ResolveRevision(revision));
 
-   while ((entry = readdir(dir)) != nullptr) {
+   levels[0].dirpath = repodir;
 
-      if(stat((dirname + DIRSEP + entry->d_name).c_str(), &statinfo) == -1)
-         throw std::runtime_error("Cannot stat directory: " + dirname);
+   for(;;) {
+      level_t& level = levels[depth];
 
-      if(S_ISDIR(statinfo.st_mode)) {
-         // skip any directory that starts with a period (e.g. ".", "..", ".git", ".vs", etc)
-         if(*entry->d_name == '.')
+      {
+         RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_ENUM);
+
+         repo.ReadTree(tree_id, level.entries);
+
+         // excluded entries are removed, so excluded sub-trees are never read
+         if(!path_filter.IsEmpty()) {
+            path_filter.EnterDirectory(std::string_view(level.dirpath).substr(repodir.length()), dir_state);
+
+            level.entries.erase(std::remove_if(level.entries.begin(), level.entries.end(), [&path_filter, &dir_state] (const GitRepo::tree_entry_t& entry)
+            {
+               return path_filter.IsExcluded(dir_state, entry.name, entry.IsTree());
+            }), level.entries.end());
+         }
+      }
+
+      totals.dircnt++;
+
+      bool has_files = false;
+
+      for(const GitRepo::tree_entry_t& entry : level.entries) {
+         if(!entry.IsFile() || !LineCounter.IsSourceFile(entry.name.c_str()))
             continue;
 
-         if(*entry->d_name)
-            subdirs.push_back(entry->d_name);
+         if(!has_files && VerboseOutput)
+            PrintDirectoryHeader(level.dirpath);
+
+         has_files = true;
+
+         const language_t& language = LineCounter.GetFileLanguage(entry.name.c_str());
+         filepath.assign(level.dirpath).append(DIRSEP).append(entry.name);
+
+         Totals file = CountGitBlob(repo, entry.id, filepath, language.profile, blob_counts);
+
+         if(VerboseOutput)
+            PrintFileCounts(level.dirpath, entry.name, language, file.lines);
+
+         AddFileTotals(totals, file, language);
+      }
+
+      if(has_files && VerboseOutput)
+         PrintDirectoryFooter();
+
+      if(!WalkTree)
+         break;
+
+      // find the next sub-tree, going back up the levels when all sub-trees of a tree are processed
+      for(;;) {
+         level_t& parent = levels[depth];
+
+         while(parent.next < parent.entries.size() && !parent.entries[parent.next].IsTree())
+            parent.next++;
+
+         if(parent.next < parent.entries.size() || depth == 0)
+            break;
+
+         depth--;
+      }
+
+      if(levels[depth].next == levels[depth].entries.size())
+         break;
+
+      tree_id = levels[depth].entries[levels[depth].next++].id;
+
+      // parent references are not used after this, so it's safe to add a level
+      if(++depth == levels.size())
+         levels.emplace_back();
+
+      const level_t& parent = levels[depth - 1];
+
+      levels[depth].next = 0;
+      levels[depth].dirpath.assign(parent.dirpath).append(DIRSEP).append(parent.entries[parent.next - 1].name);
+   }
+
+   return totals;
+}
+
+///
+/// @brief  Processes files in the tar archive at `tarpath`, or in the
+///         standard input if `-` is used, and returns their totals.
+///
+/// The archive is read in a single pass, while it's decompressed in
+/// another thread, and each file is counted in memory. Consecutive files
+/// in the same directory are reported together and directories are
+/// counted once, no matter how many times they appear in the archive.
+///
+Totals ProcessTarArchive(const std::string& tarpath)
+{
+   std::unordered_set<std::string> dirs;
+   std::string dirpath;
+   std::string filepath;
+   std::string source;
+   uint64_t size;
+   Totals totals;
+
+   TarReader tar(tarpath);
+
+   while(tar.NextFile(filepath, size)) {
+      size_t sep = filepath.rfind('/');
+      std::string filename = sep == std::string::npos ? filepath : filepath.substr(sep + 1);
+
+      if(!LineCounter.IsSourceFile(filename.c_str()) || LineCounter.GetPathFilter().IsPathExcluded(filepath, false))
          continue;
+
+      std::string filedir = sep == std::string::npos ? std::string(".") : filepath.substr(0, sep);
+
+      if(filedir != dirpath) {
+         if(!dirpath.empty() && VerboseOutput)
+            PrintDirectoryFooter();
+
+         dirpath = std::move(filedir);
+
+         if(dirs.insert(dirpath).second)
+            totals.dircnt++;
+
+         if(VerboseOutput)
+            PrintDirectoryHeader(dirpath);
+      }
+
+      std::chrono::steady_clock::time_point start_time;
+
+      if(Stats)
+         start_time = std::chrono::steady_clock::now();
+
+      RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_READ);
+
+      // two zero characters are required by the Flex scanner
+      source.reserve((size_t) size + 2);
+
+      tar.ReadFile(source);
+
+      timer.Stop();
+
+      source.append(2, '\0');
+
+      const language_t& language = LineCounter.GetFileLanguage(filename.c_str());
+      Totals file = CountBufferLines(source.data(), source.length() - 2, language.profile);
+
+      if(Stats)
+         Stats->AddFile(filepath, file.bytecnt, (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count());
+
+      if(VerboseOutput)
+         PrintFileCounts(dirpath, filename, language, file.lines);
+
+      AddFileTotals(totals, file, language);
+   }
+
+   if(!dirpath.empty() && VerboseOutput)
+      PrintDirectoryFooter();
+
+   return totals;
+}
+
+///
+/// @brief  Prints the summary of totals for the run.
+///
+void PrintTotals(const Totals& totals)
+{
+   printf("\n");
+   printf("Processed %" PRIu64 " files in %" PRIu64 " directories\n", totals.filecnt, totals.dircnt);
+
+   if(Cache)
+      printf("Reused line counts for %" PRIu64 " files from %s\n", totals.cachedcnt, CachePath.c_str());
+
+   if(Dedup != DEDUP_NONE) {
+      printf("Skipped %" PRIu64 " duplicate files (%" PRIu64 " bytes)%s\n", totals.dupfilecnt, totals.dupbytecnt,
+               Dedup == DEDUP_UNIQUE ? ", which are not included in totals" : "");
+   }
+
+   const CppFlexLexer::Result& lines = totals.lines;
+
+   // files with duplicate contents are not included in unique totals
+   uint64_t filecnt = Dedup == DEDUP_UNIQUE ? totals.filecnt - totals.dupfilecnt : totals.filecnt;
+
+   if(lines.linecnt) {
+      printf("\n");
+      printf("Total lines            : %" PRIu64 "\n", lines.linecnt);
+      printf("Code lines             : %" PRIu64 "\n", lines.codecnt);
+      printf("Commented lines        : %" PRIu64 " (C++: %" PRIu64 "; C: %" PRIu64 ")\n", lines.cmntcnt, lines.cppcnt, lines.ccnt);
+      printf("Empty Lines            : %" PRIu64 "\n", lines.emptycnt);
+      printf("Brace Lines            : %" PRIu64 "\n", lines.bracecnt);
+   }
+
+   if(lines.cmntcnt)
+      printf("Code/comments ratio    : %.2f\n", (double) lines.codecnt/lines.cmntcnt);
+
+   if(filecnt) {
+      printf("Lines per file         : %.2f\n", (double) lines.linecnt/filecnt);
+      printf("Code lines per file    : %.2f\n", (double) lines.codecnt/filecnt);
+      printf("Comment lines per file : %.2f\n", (double) lines.cmntcnt/filecnt);
+   }
+
+   // a breakdown by language is only useful if there is more than one
+   if(std::count_if(LanguageTotals.begin(), LanguageTotals.end(), [] (const Totals& langtotals) {return langtotals.filecnt != 0;}) > 1) {
+      printf("\n");
+      printf("  Language          Files      Lines       Code  Commented      Empty      Brace\n");
+      printf("  ------------ ---------- ---------- ---------- ---------- ---------- ----------\n");
+
+      for(const language_t& language : GetLanguages()) {
+         const Totals& langtotals = LanguageTotals[language.id];
+
+         if(!langtotals.filecnt)
+            continue;
+
+         printf("  %-12s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", language.name,
+                  langtotals.filecnt, langtotals.lines.linecnt, langtotals.lines.codecnt, langtotals.lines.cmntcnt, langtotals.lines.emptycnt, langtotals.lines.bracecnt);
       }
+   }
+
+   printf("\n");
+}
+
+///
+/// @brief  Prints totals of each language with files and totals for the
+///         run as JSON objects.
+///
+void PrintJsonTotals(const Totals& totals)
+{
+   const CppFlexLexer::Result& lines = totals.lines;
+
+   for(const language_t& language : GetLanguages()) {
+      const Totals& langtotals = LanguageTotals[language.id];
+
+      if(!langtotals.filecnt)
+         continue;
+
+      Output.Write("{\"type\":\"language\",\"name\":").WriteJsonString(language.name);
+      Output.Write(",\"files\":").WriteUInt(langtotals.filecnt);
+      Output.Write(",\"bytes\":").WriteUInt(langtotals.bytecnt);
+      Output.Write(",\"lines\":").WriteUInt(langtotals.lines.linecnt);
+      Output.Write(",\"code\":").WriteUInt(langtotals.lines.codecnt);
+      Output.Write(",\"comments\":").WriteUInt(langtotals.lines.cmntcnt);
+      Output.Write(",\"cpp_comments\":").WriteUInt(langtotals.lines.cppcnt);
+      Output.Write(",\"c_comments\":").WriteUInt(langtotals.lines.ccnt);
+      Output.Write(",\"empty\":").WriteUInt(langtotals.lines.emptycnt);
+      Output.Write(",\"braces\":").WriteUInt(langtotals.lines.bracecnt);
+      Output.Write("}\n");
+   }
+
+   Output.Write("{\"type\":\"totals\"");
+   Output.Write(",\"files\":").WriteUInt(totals.filecnt);
+   Output.Write(",\"directories\":").WriteUInt(totals.dircnt);
+   Output.Write(",\"bytes\":").WriteUInt(totals.bytecnt);
+   Output.Write(",\"cached_files\":").WriteUInt(totals.cachedcnt);
+   Output.Write(",\"duplicate_files\":").WriteUInt(totals.dupfilecnt);
+   Output.Write(",\"duplicate_bytes\":").WriteUInt(totals.dupbytecnt);
+   Output.Write(",\"lines\":").WriteUInt(lines.linecnt);
+   Output.Write(",\"code\":").WriteUInt(lines.codecnt);
+   Output.Write(",\"comments\":").WriteUInt(lines.cmntcnt);
+   Output.Write(",\"cpp_comments\":").WriteUInt(lines.cppcnt);
+   Output.Write(",\"c_comments\":").WriteUInt(lines.ccnt);
+   Output.Write(",\"empty\":").WriteUInt(lines.emptycnt);
+   Output.Write(",\"braces\":").WriteUInt(lines.bracecnt);
+   Output.Write("}\n");
+}
 
-      if(*entry->d_name) {
-         const char *ext = strrchr(entry->d_name, '.');
+#if defined(__linux__)
+///
+/// @brief  A file counted in the watch mode.
+///
+struct watched_file_t {
+   Totals               totals;           // line counts and size of the file
+   const language_t     *language;        // language of the file
+};
+
+// counted files by path, sorted, so files of a directory sub-tree are adjacent
+typedef std::map<std::string, watched_file_t> watched_files_t;
+
+///
+/// @brief  Adds `dirpath` and, if requested, all of its sub-directories
+///         to `watcher` and source files found in them to `changed`.
+///
+/// Each directory is watched before it's enumerated, so files created
+/// while it's enumerated are reported as changed, if they are missed.
+/// The first `root_length` characters of `dirpath` are the path of the
+/// watched directory, which is not matched against path patterns.
+///
+void ScanWatchedDirectory(TreeWatcher& watcher, const std::string& dirpath, size_t root_length, std::set<std::string>& changed)
+{
+   NameList files;
+   NameList subdirs;
+   std::vector<std::string> dirs = {dirpath};
+
+   while(!dirs.empty()) {
+      std::string path = std::move(dirs.back());
+
+      dirs.pop_back();
+
+      watcher.AddDirectory(path);
 
-         if(ext && ExtList.find(++ext) != ExtList.end())
-            files.push_back(entry->d_name);
+      LineCounter.EnumDirectory(path, std::string_view(path).substr(root_length), files, subdirs);
+
+      for(size_t index = 0; index < files.GetCount(); index++)
+         changed.insert(path + DIRSEP + files[index]);
+
+      if(WalkTree) {
+         for(size_t index = subdirs.GetCount(); index > 0; index--)
+            dirs.push_back(path + DIRSEP + subdirs[index - 1]);
       }
+   }
+}
 
+///
+/// @brief  Subtracts totals of a watched file from `totals` and from the
+///         totals of its language.
+///
+void SubtractFileTotals(Totals& totals, const watched_file_t& file)
+{
+   totals -= file.totals;
+   LanguageTotals[file.language->id] -= file.totals;
+}
+
+///
+/// @brief  Counts lines of the file `filepath` again, replacing its totals,
+///         and returns `true` if totals were changed.
+///
+/// Files that no longer exist are removed from totals. Files that cannot
+/// be counted are reported and are removed from totals as well, so they
+/// will be counted when they are changed next time.
+///
+bool UpdateWatchedFile(watched_files_t& files, const std::string& filepath, size_t root_length, Totals& totals)
+{
+   bool updated = false;
+   auto iter = files.find(filepath);
+
+   if(iter != files.end()) {
+      SubtractFileTotals(totals, iter->second);
+      files.erase(iter);
+      updated = true;
    }
 
-   closedir(dir);
+   size_t sep = filepath.rfind(*DIRSEP);
+   const char *filename = filepath.c_str() + sep + 1;
+
+   if(!LineCounter.IsSourceFile(filename) || LineCounter.GetPathFilter().IsPathExcluded(std::string_view(filepath).substr(root_length), false))
+      return updated;
+
+   try {
+      Totals file = LineCounter.CountFile(filepath);
+      const language_t& language = LineCounter.GetFileLanguage(filename);
+
+      AddFileTotals(totals, file, language);
+
+      files.emplace(filepath, watched_file_t {file, &language});
+
+      return true;
+   }
+   catch (const std::system_error& error) {
+      // files deleted or moved away are reported as changed and just need to be removed
+      if(error.code() != std::errc::no_such_file_or_directory && error.code() != std::errc::not_a_directory)
+         fprintf(stderr, "Cannot count lines in %s (%s)\n", filepath.c_str(), error.what());
+   }
+   catch (const std::exception& error) {
+      fprintf(stderr, "Cannot count lines in %s (%s)\n", filepath.c_str(), error.what());
+   }
+
+   return updated;
+}
+
+///
+/// @brief  Stops watching `dirpath` and its sub-directories and removes
+///         files in them from `totals`.
+///
+void RemoveWatchedDirectory(TreeWatcher& watcher, watched_files_t& files, const std::string& dirpath, Totals& totals)
+{
+   std::string prefix = dirpath + DIRSEP;
+
+   watcher.RemoveDirectory(dirpath);
+
+   // all files under the directory follow the directory path with the separator appended
+   auto iter = files.lower_bound(prefix);
+
+   while(iter != files.end() && !iter->first.compare(0, prefix.length(), prefix)) {
+      SubtractFileTotals(totals, iter->second);
+      iter = files.erase(iter);
+   }
+}
+
+///
+/// @brief  Prints totals in the selected format and flushes the output,
+///         so totals are available to readers of a pipe right away.
+///
+void PrintWatchTotals(const Totals& totals)
+{
+   if(Format == FORMAT_TABLE)
+      PrintTotals(totals);
+   else
+      PrintJsonTotals(totals);
+
+   Output.Flush();
+}
+
+///
+/// @brief  Counts files in the specified directory and, if requested, in
+///         all sub-directories and then counts again only files that change,
+///         printing updated totals after each batch of changes.
+///
+/// Changes usually come in bursts, such as when a branch is checked out,
+/// so changes are collected until none are made for a short time and
+/// each file is counted once per batch, no matter how many times it was
+/// changed. Files that change constantly delay counting by no more than
+/// a second.
+///
+/// Files are watched until the directory is deleted or moved, which is
+/// reported as an error. If inotify drops events because they weren't
+/// read fast enough, all known files are counted again and the tree is
+/// scanned for new ones.
+///
+void WatchDirectory(const std::string& dirname)
+{
+   // changes made within this time of each other are counted together, in milliseconds
+   const int settle_time = 100;
+
+   TreeWatcher watcher;
+   watched_files_t files;
+   std::set<std::string> changed;
+   std::vector<TreeWatcher::event_t> events;
+   Totals totals;
+
+   ScanWatchedDirectory(watcher, dirname, dirname.length(), changed);
+
+   while(true) {
+      bool updated = false;
+
+      for(const std::string& filepath : changed)
+         updated |= UpdateWatchedFile(files, filepath, dirname.length(), totals);
+
+      changed.clear();
+
+      if(updated || totals.dircnt != watcher.GetDirectoryCount()) {
+         totals.dircnt = watcher.GetDirectoryCount();
+         PrintWatchTotals(totals);
+      }
+
+      events.clear();
+
+      watcher.ReadEvents(events, -1);
+
+      std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+      while(std::chrono::steady_clock::now() < deadline && watcher.ReadEvents(events, settle_time));
+
+      for(const TreeWatcher::event_t& event : events) {
+         switch(event.type) {
+            case TreeWatcher::EVENT_FILE_CHANGED:
+               changed.insert(event.dirpath + DIRSEP + event.name);
+               break;
+            case TreeWatcher::EVENT_DIR_ADDED:
+               if(WalkTree) {
+                  std::string subdir = event.dirpath + DIRSEP + event.name;
+
+                  // skipped and excluded directories are not watched, same as when the tree was scanned
+                  if(Counter::IsSkippedDirectory(event.name.c_str()) || LineCounter.GetPathFilter().IsPathExcluded(std::string_view(subdir).substr(dirname.length()), true))
+                     break;
+
+                  try {
+                     ScanWatchedDirectory(watcher, subdir, dirname.length(), changed);
+                  }
+                  catch (const std::system_error& error) {
+                     // the directory went away before it was scanned, which is reported as another change
+                     if(error.code() != std::errc::no_such_file_or_directory && error.code() != std::errc::not_a_directory)
+                        throw;
+                  }
+               }
+               break;
+            case TreeWatcher::EVENT_DIR_REMOVED:
+               if(WalkTree)
+                  RemoveWatchedDirectory(watcher, files, event.dirpath + DIRSEP + event.name, totals);
+               break;
+            case TreeWatcher::EVENT_OVERFLOW:
+               for(const watched_files_t::value_type& file : files)
+                  changed.insert(file.first);
+
+               ScanWatchedDirectory(watcher, dirname, dirname.length(), changed);
+               break;
+            case TreeWatcher::EVENT_ROOT_REMOVED:
+               throw std::runtime_error("Watched directory was deleted or moved: " + dirname);
+         }
+      }
+   }
+}
 #endif
+
+///
+/// @brief  Returns `true` if `arg` is the long option `name`, which may
+///         be followed by `=` and a value.
+///
+bool IsLongOption(const char *arg, const char *name)
+{
+   size_t namelen = strlen(name);
+
+   return !strncmp(arg, "--", 2) && !strncmp(arg + 2, name, namelen) && (!arg[namelen + 2] || arg[namelen + 2] == '=');
 }
 
 ///
-/// @brief  Processes files in the specified directory and sub-directories.
+/// @brief  Returns the value of the long option `name` at `argptr`.
+///
+/// The value may follow the option name after `=` or in the next argument,
+/// in which case `argptr` is advanced to that argument. Returns `nullptr`
+/// if there is no value.
 ///
-void ProcessDirectory(const std::string& dirname)
+const char *GetLongOptionValue(const char * const *&argptr, const char *name)
 {
-   std::list<std::string> files;
-   std::list<std::string> subdirs;
+   const char *value = *argptr + 2 + strlen(name);
 
-   EnumDirectory(dirname, files, subdirs);
+   if(*value == '=')
+      return value + 1;
 
-   ProcessFileList(dirname, std::move(files));
+   return *(++argptr);
+}
 
-   if(WalkTree)
-      ProcessDirList(dirname, std::move(subdirs));
+///
+/// @brief  Returns `true` if the arguments select a machine-readable output
+///         format, which cannot be mixed with any other output.
+///
+bool HasRecordFormat(const char * const *argptr)
+{
+   bool records = false;
+
+   for(; *argptr; argptr++) {
+      if(IsLongOption(*argptr, "format")) {
+         const char *format = GetLongOptionValue(argptr, "format");
+
+         records = format && strcmp(format, "table");
+
+         if(!*argptr)
+            break;
+      }
+   }
+
+   return records;
 }
 
 ///
@@ -339,21 +1257,56 @@ void PrintCopyrightLine(void)
 ///
 void PrintUsage(void)
 {
-   printf("Syntax: linecnt [-s] [-v] [-d dir-name] [-c] [-j] [ext [ext [ ...]]]\n\n");
+   printf("Syntax: linecnt [-s] [-v] [-d dir-name] [-J jobs] [-M size] [-c] [-j] [--engine=name] [--cache file] [--dedup[=unique]] [--stats[=file]] [--format=name] [--files-from path] [--git-rev rev] [--tar file] [--io=name] [--io-depth n] [--chunk-size n] [--exclude pattern] [--include pattern] [--gitignore] [--watch] [--lang names] [ext [ext [ ...]]]\n\n");
 
    printf("  -s    Process files in the current directory and all subdirectories\n");
    printf("  -v    Produce verbose output\n");
    printf("  -d    Start in the specified directory\n");
+   printf("  -J    Process files in the specified number of threads (0 - one per CPU)\n");
+#if !defined(_WIN32)
+   printf("  -M    Memory-map files of the specified size in KB or larger\n");
+#endif
    printf("  -c    Add common C/C++ extensions to the list\n");
    printf("  -j    Add common Java extensions to the list\n");
+   printf("  -@    Same as --files-from\n");
    printf("  -V    Print version information\n");
    printf("  -W    Print warranty information\n");
    printf("  -h    Print this help\n");
    printf("\n");
 
+   printf("  --engine=name   Count lines with the flex (default), simd or dfa engine\n");
+   printf("  --cache file    Reuse line counts of unchanged files from a cache file\n");
+   printf("  --dedup         Reuse line counts of files with identical contents\n");
+   printf("  --dedup=unique  Same as --dedup, but count identical files only once\n");
+   printf("  --stats         Print processing time and throughput statistics\n");
+   printf("  --stats=file    Write statistics in JSON to a file (- for standard output)\n");
+   printf("  --format=name   Print per-file records as a table (default), jsonl or csv\n");
+   printf("  --files-from f  Process files listed in a file (- for standard input)\n");
+   printf("  --git-rev rev   Read files of a revision from the Git repository in -d\n");
+   printf("  --tar file      Read files from a tar or tar.gz archive (- for standard input)\n");
+   printf("  --io=name       Read files ahead with uring or threads, unless -J or --cache is used\n");
+   printf("  --io-depth n    Number of files read ahead with --io (default 32)\n");
+   printf("  --chunk-size n  Count C-like files of twice this size in KB in chunks (0 - never)\n");
+   printf("  --exclude pat   Skip files and directories matching a .gitignore-style pattern\n");
+   printf("  --include pat   Count paths matching a pattern, even if excluded by earlier ones\n");
+   printf("  --gitignore     Skip paths matching the .gitignore of the starting directory only\n");
+#if defined(__linux__)
+   printf("  --watch         Print updated totals whenever files change, until interrupted\n");
+#endif
+   printf("  --lang names    Add extensions of comma-separated languages to the list:\n");
+   printf("                 ");
+
+   for(const language_t& language : GetLanguages()) {
+      if(language.option)
+         printf(" %s", language.option);
+   }
+
+   printf("\n\n");
+
    printf("Examples:\n");
-   printf("  linecnt cpp c h    ; Count lines in .cpp, .c and .h files\n");
-   printf("  linecnt -c -j inc  ; Count lines in C/C++, Java and .inc files\n");
+   printf("  linecnt cpp c h     ; Count lines in .cpp, .c and .h files\n");
+   printf("  linecnt -c -j inc   ; Count lines in C/C++, Java and .inc files\n");
+   printf("  linecnt --lang=sql  ; Count lines in SQL files\n");
 }
 
 ///
@@ -363,18 +1316,18 @@ void PrintUsage(void)
 /// Returned extensions are prefixed with a period and the last one is
 /// separated from the rest with `and`.
 ///
-std::string GetFileExtensions(const std::set<std::string, less_stricmp>& extlist)
+std::string GetFileExtensions(const std::vector<std::string>& extlist)
 {
    std::string extstr;
-   std::set<std::string, less_stricmp>::const_iterator iter;
-   int extcnt = 1;
+   std::vector<std::string>::const_iterator iter;
+   size_t extcnt = 1;
 
    for(iter = extlist.begin(); iter != extlist.end(); extcnt++, iter++) {
       if(extcnt > 1) 
          extstr += (extcnt == extlist.size()) ? " and " : ", ";
 
       extstr += ".";
-      extstr += (*iter).c_str();
+      extstr += iter->c_str();
    }
 
    return extstr;
@@ -404,11 +1357,14 @@ void PrintWarranty(void)
 int main(int argc, const char *argv[])
 {
    const char *dirname = nullptr;
+   char cur_dir[_MAX_PATH];      // dirname points here if no directory was provided
    const char * const *argptr = &argv[0];
    int comments = 0;
 
    try {
-      PrintCopyrightLine();
+      // the copyright line would precede machine-readable records
+      if(!HasRecordFormat(argv + 1))
+         PrintCopyrightLine();
 
       if(argc > 1) {
          // skip the executable's name
@@ -432,22 +1388,60 @@ int main(int argc, const char *argv[])
                         }
                      }
                      break;
+                  case 'J':
+                     {
+                        // check if a number follows -J without a space
+                        const char *jobs = *(*argptr+2) ? *argptr+2 : *(++argptr);
+                        char *endptr = nullptr;
+
+                        if(!jobs || !*jobs || (JobCount = (unsigned int) strtoul(jobs, &endptr, 10), *endptr)) {
+                           printf("You must supply a number of parsing threads\n");
+                           exit(1);
+                        }
+
+                        if(JobCount == 0)
+                           JobCount = std::max(std::thread::hardware_concurrency(), 1u);
+                     }
+                     break;
+#if !defined(_WIN32)
+                  case 'M':
+                     {
+                        // check if a size follows -M without a space
+                        const char *size = *(*argptr+2) ? *argptr+2 : *(++argptr);
+                        char *endptr = nullptr;
+
+                        if(!size || !*size || (CountOptions.map_min_size = (size_t) strtoul(size, &endptr, 10) * 1024, *endptr)) {
+                           printf("You must supply a minimum size of memory-mapped files\n");
+                           exit(1);
+                        }
+
+                        // zero means any size, but a zero map_min_size would disable mapping
+                        if(CountOptions.map_min_size == 0)
+                           CountOptions.map_min_size = 1;
+                     }
+                     break;
+#endif
+                  case '@':
+                     {
+                        // check if a path follows -@ without a space
+                        const char *listpath = *(*argptr+2) ? *argptr+2 : *(++argptr);
+
+                        if(!listpath || !*listpath) {
+                           printf("You must supply a file list path\n");
+                           exit(1);
+                        }
+
+                        FileListPath = listpath;
+                     }
+                     break;
                   case 's':
                      WalkTree = true;
                      break;
                   case 'c':
-                     ExtList.insert("cpp");
-                     ExtList.insert("cxx");
-                     ExtList.insert("cc");
-                     ExtList.insert("c++");
-                     ExtList.insert("hpp");
-                     ExtList.insert("hxx");
-                     ExtList.insert("h++");
-                     ExtList.insert("h");
-                     ExtList.insert("c");
+                     LineCounter.AddLanguage(*FindLanguage("cpp"));
                      break;
                   case 'j':
-                     ExtList.insert("java");
+                     LineCounter.AddLanguage(*FindLanguage("java"));
                      break;
                   case 'v':
                      VerboseOutput = true;
@@ -462,6 +1456,187 @@ int main(int argc, const char *argv[])
                   case '?':
                      PrintUsage();
                      exit(0);
+                  case '-':
+                     if(IsLongOption(*argptr, "engine")) {
+                        const char *engine = GetLongOptionValue(argptr, "engine");
+
+                        if(engine && !strcmp(engine, "flex"))
+                           CountOptions.engine = Counter::ENGINE_FLEX;
+                        else if(engine && !strcmp(engine, "simd"))
+                           CountOptions.engine = Counter::ENGINE_SIMD;
+                        else if(engine && !strcmp(engine, "dfa"))
+                           CountOptions.engine = Counter::ENGINE_DFA;
+                        else {
+                           printf("Unknown line counting engine: %s\n", engine ? engine : "");
+                           exit(1);
+                        }
+                        break;
+                     }
+                     // --dedup takes an optional value, which cannot be in the next argument
+                     if(!strcmp(*argptr, "--dedup") || !strcmp(*argptr, "--dedup=reuse")) {
+                        Dedup = DEDUP_REUSE;
+                        break;
+                     }
+                     if(!strcmp(*argptr, "--dedup=unique")) {
+                        Dedup = DEDUP_UNIQUE;
+                        break;
+                     }
+                     // --stats takes an optional value, which cannot be in the next argument
+                     if(IsLongOption(*argptr, "stats")) {
+                        const char *statspath = *argptr + 7;
+
+                        if(*statspath == '=' && !*++statspath) {
+                           printf("You must supply a statistics file path\n");
+                           exit(1);
+                        }
+
+                        StatsEnabled = true;
+                        StatsPath = statspath;
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "format")) {
+                        const char *format = GetLongOptionValue(argptr, "format");
+
+                        if(format && !strcmp(format, "table"))
+                           Format = FORMAT_TABLE;
+                        else if(format && !strcmp(format, "jsonl"))
+                           Format = FORMAT_JSONL;
+                        else if(format && !strcmp(format, "csv"))
+                           Format = FORMAT_CSV;
+                        else {
+                           printf("Unknown output format: %s\n", format ? format : "");
+                           exit(1);
+                        }
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "files-from")) {
+                        const char *listpath = GetLongOptionValue(argptr, "files-from");
+
+                        if(!listpath || !*listpath) {
+                           printf("You must supply a file list path\n");
+                           exit(1);
+                        }
+
+                        FileListPath = listpath;
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "git-rev")) {
+                        const char *revision = GetLongOptionValue(argptr, "git-rev");
+
+                        if(!revision || !*revision) {
+                           printf("You must supply a Git revision\n");
+                           exit(1);
+                        }
+
+                        GitRevision = revision;
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "tar")) {
+                        const char *tarpath = GetLongOptionValue(argptr, "tar");
+
+                        if(!tarpath || !*tarpath) {
+                           printf("You must supply an archive path\n");
+                           exit(1);
+                        }
+
+                        TarPath = tarpath;
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "io")) {
+                        const char *method = GetLongOptionValue(argptr, "io");
+
+                        if(method && !strcmp(method, "sync"))
+                           IoMethod = IO_SYNC;
+                        else if(method && !strcmp(method, "uring"))
+                           IoMethod = IO_URING;
+                        else if(method && !strcmp(method, "threads"))
+                           IoMethod = IO_THREADS;
+                        else {
+                           printf("Unknown file reading method: %s\n", method ? method : "");
+                           exit(1);
+                        }
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "io-depth")) {
+                        const char *depth = GetLongOptionValue(argptr, "io-depth");
+                        char *endptr = nullptr;
+
+                        if(!depth || !*depth || (IoDepth = (size_t) strtoul(depth, &endptr, 10), *endptr) || !IoDepth) {
+                           printf("You must supply a number of files to read ahead\n");
+                           exit(1);
+                        }
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "chunk-size")) {
+                        const char *size = GetLongOptionValue(argptr, "chunk-size");
+                        char *endptr = nullptr;
+
+                        if(!size || !*size || (CountOptions.chunk_size = (uint64_t) strtoull(size, &endptr, 10) * 1024, *endptr)) {
+                           printf("You must supply a chunk size\n");
+                           exit(1);
+                        }
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "lang")) {
+                        const char *names = GetLongOptionValue(argptr, "lang");
+
+                        if(!names || !*names) {
+                           printf("You must supply a list of languages\n");
+                           exit(1);
+                        }
+
+                        for(const char *name = names; *name; ) {
+                           const char *sep = strchr(name, ',');
+                           std::string option(name, sep ? sep - name : strlen(name));
+                           const language_t *language = FindLanguage(option.c_str());
+
+                           if(!language) {
+                              printf("Unknown language: %s\n", option.c_str());
+                              exit(1);
+                           }
+
+                           LineCounter.AddLanguage(*language);
+
+                           name += option.length() + (sep ? 1 : 0);
+                        }
+                        break;
+                     }
+                     if(IsLongOption(*argptr, "exclude") || IsLongOption(*argptr, "include")) {
+                        bool exclude = IsLongOption(*argptr, "exclude");
+                        const char *pattern = GetLongOptionValue(argptr, exclude ? "exclude" : "include");
+
+                        if(!pattern || !*pattern) {
+                           printf("You must supply a path pattern\n");
+                           exit(1);
+                        }
+
+                        PathPatterns.emplace_back(pattern, exclude);
+                        break;
+                     }
+                     if(!strcmp(*argptr, "--gitignore")) {
+                        GitIgnore = true;
+                        break;
+                     }
+#if defined(__linux__)
+                     if(!strcmp(*argptr, "--watch")) {
+                        Watch = true;
+                        break;
+                     }
+#endif
+                     if(IsLongOption(*argptr, "cache")) {
+                        const char *cachepath = GetLongOptionValue(argptr, "cache");
+
+                        if(!cachepath || !*cachepath) {
+                           printf("You must supply a cache file path\n");
+                           exit(1);
+                        }
+
+                        CachePath = cachepath;
+                        break;
+                     }
+                     printf("Unknown option: %s\n\n", *argptr);
+                     PrintUsage();
+                     exit(1);
                   default:
                      printf("Unknown option: %s\n\n", *argptr);
                      PrintUsage();
@@ -471,24 +1646,65 @@ int main(int argc, const char *argv[])
                continue;
             }
 
-            ExtList.insert(*argptr++);
+            LineCounter.AddExtension(*argptr, GetExtensionLanguage(*argptr));
+            argptr++;
          }
       }
 
-      if(ExtList.size() == 0) {
+      if(LineCounter.GetExtensions().empty()) {
          printf("The extension list is empty. At least one extension must be specified.\n\n");
          PrintUsage();
          exit(1);
       }
 
+      if(!FileListPath.empty() + !GitRevision.empty() + !TarPath.empty() > 1) {
+         printf("Only one of a file list, a Git revision or an archive may be used\n");
+         exit(1);
+      }
+
+      // only directories can be watched and totals are updated without tracking duplicate or cached files
+      if(Watch && (!FileListPath.empty() || !GitRevision.empty() || !TarPath.empty() || !CachePath.empty() || Dedup != DEDUP_NONE || Format == FORMAT_CSV)) {
+         printf("--watch cannot be used with a file list, a Git revision, an archive, --cache, --dedup or --format=csv\n");
+         exit(1);
+      }
+
+      // a JSON report cannot be mixed with CSV records
+      if(StatsPath == "-" && Format == FORMAT_CSV) {
+         printf("--stats=- cannot be used with --format=csv\n");
+         exit(1);
+      }
+
+      // machine-readable formats list all files
+      if(Format != FORMAT_TABLE)
+         VerboseOutput = true;
+
       //
       //
       //
-      printf("Processing files with extensions %s\n\n", GetFileExtensions(ExtList).c_str());
+      if(Format == FORMAT_TABLE)
+         printf("Processing files with extensions %s\n\n", GetFileExtensions(LineCounter.GetExtensions()).c_str());
+      else if(Format == FORMAT_CSV)
+         Output.Write("path,language,lines,code,comments,cpp_comments,c_comments,empty,braces\n");
+
+      LanguageTotals.resize(GetLanguages().size());
+
+      if(StatsEnabled)
+         Stats = std::make_unique<RunStats>(GetAllocationCount);
+
+      // large files are split into as many chunks as there are threads
+      CountOptions.chunk_jobs = JobCount;
+      CountOptions.stats = Stats.get();
+
+      LineCounter.SetOptions(CountOptions);
+
+      // relative paths in the file list are resolved against the directory provided on the command line
+      std::vector<std::string> filelist;
+
+      if(!FileListPath.empty())
+         filelist = ReadFileList(FileListPath);
 
       // use the current directory if none was provided on the command line
-      if(!dirname || !*dirname)   {
-         char cur_dir[_MAX_PATH];
+      if(FileListPath.empty() && (!dirname || !*dirname))   {
          if(!getcwd(cur_dir, sizeof(cur_dir))) {
             printf("Cannot obtain the current working directory\n");
             exit(2);
@@ -496,41 +1712,96 @@ int main(int argc, const char *argv[])
          dirname = cur_dir;
       }
 
-      if(!dirname || !*dirname)
+      if(FileListPath.empty() && (!dirname || !*dirname))
          throw std::runtime_error("Directory name cannot be empty");
 
-      ProcessDirectory(dirname);
+      if(GitIgnore || !PathPatterns.empty()) {
+         PathFilter path_filter;
 
-      //
-      //
-      //
-      printf("\n");
-      printf("Processed %d files in %d directories\n", FileCount, DirCount);
-
-      if(LineCount) {
-         printf("\n");
-         printf("Total lines            : %d\n", LineCount);
-         printf("Code lines             : %d\n", CodeLineCount);
-         printf("Commented lines        : %d (C++: %d; C: %d)\n", CommentCount, CppLineCount, CLineCount);
-         printf("Empty Lines            : %d\n", EmptyLineCount);
-         printf("Brace Lines            : %d\n", BraceLineCount);
+         // patterns on the command line follow .gitignore patterns, so they take precedence
+         if(GitIgnore)
+            path_filter.ReadIgnoreFile(std::string(dirname && *dirname ? dirname : ".") + DIRSEP + ".gitignore");
+
+         for(const std::pair<std::string, bool>& pattern : PathPatterns)
+            path_filter.AddPattern(pattern.first, pattern.second);
+
+         LineCounter.SetPathFilter(path_filter);
       }
 
-      if(CommentCount)
-         printf("Code/comments ratio    : %.2f\n", (double) CodeLineCount/CommentCount);
+      if(!CachePath.empty()) {
+         RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_CACHE);
 
-      if(FileCount) {
-         printf("Lines per file         : %.2f\n", (double) LineCount/FileCount);
-         printf("Code lines per file    : %.2f\n", (double) CodeLineCount/FileCount);
-         printf("Comment lines per file : %.2f\n", (double) CommentCount/FileCount);
+         Cache = std::make_unique<CountCache>();
+         Cache->Load(CachePath);
       }
 
-      printf("\n");
+      // worker threads read their own files and cached files are looked up before they are read
+      if(IoMethod != IO_SYNC && JobCount == 1 && !Cache && !Watch)
+         Reader = std::make_unique<FileReader>(IoMethod == IO_URING ? FileReader::BACKEND_URING : FileReader::BACKEND_THREADS, IoDepth);
+
+      Totals totals;
+
+      if(!FileListPath.empty())
+         totals = ProcessPathList(dirname ? dirname : "", filelist);
+      else if(!GitRevision.empty())
+         totals = ProcessGitRevision(dirname, GitRevision);
+      else if(!TarPath.empty())
+         totals = ProcessTarArchive(TarPath);
+#if defined(__linux__)
+      else if(Watch) {
+         // returns only by throwing an exception if the directory goes away
+         WatchDirectory(dirname);
+      }
+#endif
+      else
+         totals = ProcessDirectory(dirname);
+
+      if(Cache) {
+         RunStats::PhaseTimer timer(Stats.get(), RunStats::PHASE_CACHE);
+
+         Cache->Save(CachePath);
+      }
+
+      Output.Flush();
+
+      if(Format == FORMAT_TABLE)
+         PrintTotals(totals);
+      else if(Format == FORMAT_JSONL)
+         PrintJsonTotals(totals);
+
+      Output.Flush();
+
+      if(Stats) {
+         // keep record output parseable, with JSON Lines statistics in their own record
+         if(StatsPath.empty())
+            Stats->PrintReport(Format == FORMAT_TABLE ? stdout : stderr);
+         else if(StatsPath == "-")
+            Stats->PrintJsonReport(stdout, Format == FORMAT_JSONL);
+         else {
+            FILE *statsfile = fopen(StatsPath.c_str(), "w");
+
+            if(!statsfile)
+               throw std::system_error(errno, std::system_category(), "Cannot create a statistics file " + StatsPath);
+
+            Stats->PrintJsonReport(statsfile);
+
+            if(fclose(statsfile) != 0)
+               throw std::runtime_error("Cannot write a statistics file " + StatsPath);
+         }
+      }
 
       return 0;
    }
    catch (const std::exception& ex) {
-      printf("Unexpected error (%s)\n", ex.what());
+      // write out records of files processed before the error
+      try {
+         Output.Flush();
+      }
+      catch (const std::exception&) {
+      }
+
+      // keep machine-readable output parseable
+      fprintf(Format == FORMAT_TABLE ? stdout : stderr, "Unexpected error (%s)\n", ex.what());
       return 1;
    }
 }
@@ -0,0 +1,62 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "mappedfile.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <system_error>
+
+MappedFile::MappedFile(int &&fd, size_t arg_length) :
+      data(nullptr),
+      length(arg_length),
+      map_size(0)
+{
+   size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+   void *base;
+
+   //
+   // Reserve zero-filled anonymous memory for the file and two trailing
+   // zero characters, rounded up to the page size, and then map the file
+   // over the start of this range. Bytes past the end of the file in its
+   // last page are zero-filled by the system and if the file size is too
+   // close to the page boundary, the trailing characters are found in the
+   // next anonymous page, which could not be mapped from the file without
+   // raising SIGBUS when accessed.
+   //
+   map_size = (length + 2 + page_size - 1) / page_size * page_size;
+
+   if((base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+      int error = errno;
+      close(fd);
+      throw std::system_error(error, std::system_category(), "Cannot reserve memory for a file mapping");
+   }
+
+   if(length && mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      int error = errno;
+      munmap(base, map_size);
+      close(fd);
+      throw std::system_error(error, std::system_category(), "Cannot map a file");
+   }
+
+   // the mapping remains valid after the descriptor is closed
+   close(fd);
+
+   // source files are scanned start to finish exactly once
+   if(length)
+      madvise(base, length, MADV_SEQUENTIAL);
+
+   data = (char*) base;
+}
+
+MappedFile::~MappedFile(void)
+{
+   munmap(data, map_size);
+}
@@ -0,0 +1,53 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+///
+/// @brief  A private writable memory mapping of a file, which is followed
+///         by at least two zero characters.
+///
+/// The mapping is laid out as required by the in-place constructor of
+/// `CppFlexLexer`. Writes into the mapping are never written back to
+/// the file.
+///
+/// This class is only available on POSIX systems.
+///
+class MappedFile {
+   private:
+      char     *data;                        ///< File contents.
+      size_t   length;                       ///< File size, in bytes.
+      size_t   map_size;                     ///< Size of the mapped address range.
+
+   public:
+      ///
+      /// @brief  Maps `arg_length` bytes of the file open as `fd` and closes
+      ///         the file descriptor, even if mapping fails.
+      ///
+      /// The length is passed in because callers typically need to know
+      /// the file size before deciding whether to map the file or not.
+      ///
+      MappedFile(int &&fd, size_t arg_length);
+
+      MappedFile(const MappedFile&) = delete;
+
+      /// Unmaps the file.
+      ~MappedFile(void);
+
+      MappedFile& operator = (const MappedFile&) = delete;
+
+      /// Returns a pointer to the file contents.
+      char *GetData(void) {return data;}
+
+      /// Returns the length of the file, not including trailing zero characters.
+      size_t GetLength(void) const {return length;}
+};
+
+#endif // MAPPEDFILE_H
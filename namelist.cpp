@@ -0,0 +1,36 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "namelist.h"
+
+#include <algorithm>
+
+void NameList::Add(const std::string_view& name, uint64_t key)
+{
+   entries.push_back({chars.length(), key});
+
+   chars.append(name).append(1, '\0');
+}
+
+void NameList::Clear(void)
+{
+   chars.clear();
+   entries.clear();
+}
+
+///
+/// Offsets grow in the order names are added, so comparing them for
+/// names with the same key makes the sort stable, without the temporary
+/// buffer `std::stable_sort` would allocate.
+///
+void NameList::SortByKey(void)
+{
+   std::sort(entries.begin(), entries.end(), [] (const entry_t& entry1, const entry_t& entry2)
+   {
+      return entry1.key < entry2.key || (entry1.key == entry2.key && entry1.offset < entry2.offset);
+   });
+}
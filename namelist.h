@@ -0,0 +1,65 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef NAMELIST_H
+#define NAMELIST_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+///
+/// @brief  A list of names, such as directory entries, which are stored
+///         back to back in a single buffer.
+///
+/// Clearing the list keeps its memory, so a list that is reused for
+/// many directories stops allocating memory once it has grown to fit
+/// the largest directory. Names are null-terminated and pointers to
+/// them remain valid until the list is changed.
+///
+/// Each name may have a sort key, such as an inode number, and sorting
+/// the list reorders only offsets of names, which are never moved.
+///
+class NameList {
+   private:
+      ///
+      /// @brief  Location and sort key of a name.
+      ///
+      struct entry_t {
+         size_t         offset;              ///< Offset of the name in `chars`.
+         uint64_t       key;                 ///< Sort key of the name.
+      };
+
+   private:
+      std::string          chars;            ///< Null-terminated names.
+      std::vector<entry_t> entries;          ///< Names in list order.
+
+   public:
+      /// Appends a name with an optional sort key to the list.
+      void Add(const std::string_view& name, uint64_t key = 0);
+
+      /// Removes all names, but keeps allocated memory.
+      void Clear(void);
+
+      ///
+      /// @brief  Sorts names by their keys, keeping names with the same key
+      ///         in the order they were added, without allocating memory.
+      ///
+      void SortByKey(void);
+
+      /// Returns the number of names in the list.
+      size_t GetCount(void) const {return entries.size();}
+
+      /// Returns `true` if the list has no names.
+      bool IsEmpty(void) const {return entries.empty();}
+
+      /// Returns the name at `index`.
+      const char *operator [] (size_t index) const {return chars.data() + entries[index].offset;}
+};
+
+#endif // NAMELIST_H
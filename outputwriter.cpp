@@ -0,0 +1,153 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "outputwriter.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+OutputWriter::OutputWriter(FILE *arg_output, size_t arg_bufsize) :
+      output(arg_output),
+      buffer(std::make_unique<char[]>(arg_bufsize)),
+      bufsize(arg_bufsize),
+      length(0)
+{
+}
+
+OutputWriter::~OutputWriter(void)
+{
+   if(length)
+      fwrite(buffer.get(), 1, length, output);
+
+   fflush(output);
+}
+
+void OutputWriter::WriteBuffer(void)
+{
+   size_t count = length;
+
+   // reset the buffer first, so a failed write is not repeated in the destructor
+   length = 0;
+
+   if(fwrite(buffer.get(), 1, count, output) != count)
+      throw std::runtime_error("Cannot write output");
+}
+
+OutputWriter& OutputWriter::Write(const std::string_view& str)
+{
+   const char *ptr = str.data();
+   size_t count = str.length();
+
+   while(count) {
+      if(length == bufsize)
+         WriteBuffer();
+
+      size_t chunk = std::min(count, bufsize - length);
+
+      memcpy(buffer.get() + length, ptr, chunk);
+
+      length += chunk;
+      ptr += chunk;
+      count -= chunk;
+   }
+
+   return *this;
+}
+
+size_t OutputWriter::FormatUInt(uint64_t value, char *buffer)
+{
+   char digits[20];
+   char *ptr = digits + sizeof(digits);
+
+   // format digits from the end of the array
+   do {
+      *--ptr = (char) ('0' + value % 10);
+      value /= 10;
+   } while(value);
+
+   size_t count = digits + sizeof(digits) - ptr;
+
+   memcpy(buffer, ptr, count);
+
+   return count;
+}
+
+OutputWriter& OutputWriter::WriteUInt(uint64_t value, size_t width)
+{
+   char digits[20];
+   size_t count = FormatUInt(value, digits);
+
+   for(; width > count; width--)
+      Write(' ');
+
+   return Write(std::string_view(digits, count));
+}
+
+OutputWriter& OutputWriter::WriteJsonString(const std::string_view& str)
+{
+   static const char hex_digits[] = "0123456789abcdef";
+
+   Write('"');
+
+   for(char chr : str) {
+      switch(chr) {
+         case '"':
+            Write("\\\"");
+            break;
+         case '\\':
+            Write("\\\\");
+            break;
+         case '\n':
+            Write("\\n");
+            break;
+         case '\r':
+            Write("\\r");
+            break;
+         case '\t':
+            Write("\\t");
+            break;
+         default:
+            if((unsigned char) chr < 0x20) {
+               Write("\\u00");
+               Write(hex_digits[(unsigned char) chr >> 4]);
+               Write(hex_digits[(unsigned char) chr & 0xF]);
+            }
+            else
+               Write(chr);
+            break;
+      }
+   }
+
+   return Write('"');
+}
+
+OutputWriter& OutputWriter::WriteCsvString(const std::string_view& str)
+{
+   if(str.find_first_of(",\"\r\n") == std::string_view::npos)
+      return Write(str);
+
+   // quote the field and double any quotes within it
+   Write('"');
+
+   for(char chr : str) {
+      if(chr == '"')
+         Write('"');
+      Write(chr);
+   }
+
+   return Write('"');
+}
+
+void OutputWriter::Flush(void)
+{
+   if(length)
+      WriteBuffer();
+
+   if(fflush(output) != 0)
+      throw std::runtime_error("Cannot write output");
+}
@@ -0,0 +1,90 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <memory>
+
+///
+/// @brief  A buffered writer for per-file output records.
+///
+/// Text is collected in a large buffer, which is reused for the lifetime
+/// of the writer and is written into the output stream when it's full or
+/// when `Flush` is called. Integers are formatted directly into the buffer,
+/// without going through `printf`.
+///
+/// Callers mixing this writer with other output into the same stream must
+/// flush the writer first. This class is not thread-safe.
+///
+class OutputWriter {
+   private:
+      FILE                    *output;       ///< Output stream.
+      std::unique_ptr<char[]> buffer;        ///< Output buffer.
+      size_t                  bufsize;       ///< Size of the output buffer.
+      size_t                  length;        ///< Number of characters in the buffer.
+
+   private:
+      /// Writes buffered characters into the output stream.
+      void WriteBuffer(void);
+
+   public:
+      OutputWriter(FILE *output, size_t bufsize = 65536);
+
+      OutputWriter(const OutputWriter&) = delete;
+
+      /// Writes out any buffered characters, ignoring errors.
+      ~OutputWriter(void);
+
+      OutputWriter& operator = (const OutputWriter&) = delete;
+
+      /// Appends a single character.
+      OutputWriter& Write(char chr)
+      {
+         if(length == bufsize)
+            WriteBuffer();
+
+         buffer[length++] = chr;
+
+         return *this;
+      }
+
+      /// Appends a string.
+      OutputWriter& Write(const std::string_view& str);
+
+      ///
+      /// @brief  Appends a decimal number, right-aligned with spaces in a
+      ///         field of `width` characters, if it's shorter than that.
+      ///
+      OutputWriter& WriteUInt(uint64_t value, size_t width = 0);
+
+      ///
+      /// @brief  Formats a decimal number into `buffer`, which must have room
+      ///         for at least 20 characters, and returns the number of
+      ///         characters. The number is not terminated with a zero.
+      ///
+      static size_t FormatUInt(uint64_t value, char *buffer);
+
+      /// Appends a string as a quoted JSON string.
+      OutputWriter& WriteJsonString(const std::string_view& str);
+
+      /// Appends a string as a CSV field, quoted only if necessary.
+      OutputWriter& WriteCsvString(const std::string_view& str);
+
+      ///
+      /// @brief  Writes buffered characters into the output stream and
+      ///         flushes the stream. Throws `std::runtime_error` if the
+      ///         output cannot be written.
+      ///
+      void Flush(void);
+};
+
+#endif // OUTPUTWRITER_H
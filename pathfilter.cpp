@@ -0,0 +1,398 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "pathfilter.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+//
+// Directory name separators in paths being matched, which may be mixed
+// on Windows.
+//
+#if defined(_WIN32)
+#define PATHSEPS "\\/"
+#else
+#define PATHSEPS "/"
+#endif
+
+///
+/// @brief  Extracts the next path component from `path` into `name` and
+///         returns `false` if there are no more components.
+///
+/// Empty components and references to the current directory are skipped.
+///
+static bool NextComponent(std::string_view& path, std::string_view& name)
+{
+   while(!path.empty()) {
+      size_t sep = path.find_first_of(PATHSEPS);
+
+      name = path.substr(0, sep);
+      path.remove_prefix(sep == std::string_view::npos ? path.length() : sep + 1);
+
+      if(!name.empty() && name != ".")
+         return true;
+   }
+
+   return false;
+}
+
+///
+/// @brief  Matches a single pattern character at `pos`, which may be
+///         `?`, a bracket expression or an escaped character, against `ch`
+///         and returns the position of the next pattern character, or
+///         `npos` if `ch` does not match.
+///
+static size_t MatchChar(const std::string_view& pattern, size_t pos, char ch)
+{
+   if(pattern[pos] == '?')
+      return pos + 1;
+
+   if(pattern[pos] == '\\' && pos + 1 < pattern.length())
+      return pattern[pos + 1] == ch ? pos + 2 : std::string_view::npos;
+
+   if(pattern[pos] == '[') {
+      size_t end = pos + 1;
+      bool negate = end < pattern.length() && (pattern[end] == '!' || pattern[end] == '^');
+      bool matched = false;
+
+      if(negate)
+         end++;
+
+      // a closing bracket right after the opening one is a literal character
+      size_t first = end;
+
+      while(end < pattern.length() && (pattern[end] != ']' || end == first)) {
+         char low = pattern[end];
+
+         if(end + 2 < pattern.length() && pattern[end + 1] == '-' && pattern[end + 2] != ']') {
+            matched |= ch >= low && ch <= pattern[end + 2];
+            end += 3;
+         }
+         else {
+            matched |= ch == low;
+            end++;
+         }
+      }
+
+      // an unterminated bracket expression is matched as a literal bracket
+      if(end < pattern.length())
+         return matched != negate ? end + 1 : std::string_view::npos;
+   }
+
+   return pattern[pos] == ch ? pos + 1 : std::string_view::npos;
+}
+
+PathFilter::PathFilter(void) :
+      nodes(1)
+{
+}
+
+///
+/// The star in the pattern that was seen last is extended by one character
+/// whenever the rest of the pattern fails to match, which is sufficient
+/// because stars cannot match separators within a path component.
+///
+bool PathFilter::MatchGlob(const std::string_view& pattern, const std::string_view& name)
+{
+   size_t pos = 0;
+   size_t index = 0;
+   size_t star = std::string_view::npos;
+   size_t star_index = 0;
+
+   while(index < name.length()) {
+      if(pos < pattern.length() && pattern[pos] == '*') {
+         star = ++pos;
+         star_index = index;
+         continue;
+      }
+
+      size_t next = pos < pattern.length() ? MatchChar(pattern, pos, name[index]) : std::string_view::npos;
+
+      if(next != std::string_view::npos) {
+         pos = next;
+         index++;
+         continue;
+      }
+
+      if(star == std::string_view::npos)
+         return false;
+
+      pos = star;
+      index = ++star_index;
+   }
+
+   while(pos < pattern.length() && pattern[pos] == '*')
+      pos++;
+
+   return pos == pattern.length();
+}
+
+uint32_t PathFilter::AddChild(uint32_t node, const std::string_view& name)
+{
+   std::string literal;
+
+   // remove escapes from components without wildcards, so they can be looked up
+   for(size_t index = 0; index < name.length(); index++) {
+      if(name[index] == '\\' && index + 1 < name.length())
+         index++;
+      else if(strchr("*?[", name[index])) {
+         literal.clear();
+         break;
+      }
+
+      literal += name[index];
+   }
+
+   if(!literal.empty()) {
+      auto iter = nodes[node].literals.find(literal);
+
+      if(iter != nodes[node].literals.end())
+         return iter->second;
+
+      uint32_t child = (uint32_t) nodes.size();
+
+      nodes.emplace_back();
+      nodes[node].literals.emplace(std::move(literal), child);
+
+      return child;
+   }
+
+   for(const std::pair<std::string, uint32_t>& glob : nodes[node].globs) {
+      if(glob.first == name)
+         return glob.second;
+   }
+
+   uint32_t child = (uint32_t) nodes.size();
+
+   nodes.emplace_back();
+   nodes[node].globs.emplace_back(name, child);
+
+   return child;
+}
+
+uint32_t PathFilter::AddAnyChild(uint32_t node)
+{
+   // consecutive `**` components match the same paths as one
+   if(nodes[node].any_loop)
+      return node;
+
+   if(nodes[node].any == no_node) {
+      nodes[node].any = (uint32_t) nodes.size();
+
+      nodes.emplace_back();
+      nodes.back().any_loop = true;
+   }
+
+   return nodes[node].any;
+}
+
+void PathFilter::AddPattern(std::string_view pattern, bool exclude)
+{
+   bool dir_only = false;
+
+   while(!pattern.empty() && pattern.back() == '/') {
+      dir_only = true;
+      pattern.remove_suffix(1);
+   }
+
+   if(pattern.empty())
+      return;
+
+   // a pattern without a separator matches a name at any depth, as if it started with `**/`
+   uint32_t node = pattern.find('/') == std::string_view::npos ? AddAnyChild(0) : 0;
+
+   while(!pattern.empty()) {
+      size_t sep = pattern.find('/');
+      std::string_view name = pattern.substr(0, sep);
+
+      pattern.remove_prefix(sep == std::string_view::npos ? pattern.length() : sep + 1);
+
+      if(name.empty())
+         continue;
+
+      if(name == "**") {
+         // a trailing `**` matches everything inside a directory, but not the directory itself
+         if(pattern.empty())
+            node = AddChild(node, "*");
+
+         node = AddAnyChild(node);
+      }
+      else
+         node = AddChild(node, name);
+   }
+
+   int32_t rule = (int32_t) rules.size();
+
+   rules.push_back(exclude);
+
+   if(dir_only)
+      nodes[node].dir_rule = rule;
+   else
+      nodes[node].rule = rule;
+}
+
+bool PathFilter::ReadIgnoreFile(const std::string& filepath)
+{
+   FILE *file = fopen(filepath.c_str(), "rb");
+
+   if(!file) {
+      if(errno == ENOENT)
+         return false;
+
+      throw std::system_error(errno, std::system_category(), filepath);
+   }
+
+   std::string text;
+   char buffer[4096];
+   size_t length;
+
+   while((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      text.append(buffer, length);
+
+   bool failed = ferror(file) != 0;
+
+   fclose(file);
+
+   if(failed)
+      throw std::runtime_error("Cannot read file " + filepath);
+
+   std::string_view lines(text);
+
+   while(!lines.empty()) {
+      size_t eol = lines.find('\n');
+      std::string_view line = lines.substr(0, eol);
+
+      lines.remove_prefix(eol == std::string_view::npos ? lines.length() : eol + 1);
+
+      if(!line.empty() && line.back() == '\r')
+         line.remove_suffix(1);
+
+      // trailing spaces are ignored, unless they are escaped
+      while(!line.empty() && line.back() == ' ' && (line.length() < 2 || line[line.length() - 2] != '\\'))
+         line.remove_suffix(1);
+
+      if(line.empty() || line.front() == '#')
+         continue;
+
+      if(line.front() == '!')
+         AddPattern(line.substr(1), false);
+      else
+         AddPattern(line, true);
+   }
+
+   return true;
+}
+
+int32_t PathFilter::Step(const dir_state_t& from, const std::string_view& name, bool is_dir, dir_state_t *to) const
+{
+   int32_t rule = -1;
+
+   // adds a matching node and nodes that follow it through `**`, which may match no components
+   auto enter = [&] (uint32_t index)
+   {
+      for(; index != no_node; index = nodes[index].any) {
+         const node_t& node = nodes[index];
+
+         rule = std::max(rule, is_dir ? std::max(node.rule, node.dir_rule) : node.rule);
+
+         if(to)
+            to->push_back(index);
+      }
+   };
+
+   for(uint32_t index : from) {
+      const node_t& node = nodes[index];
+
+      if(node.any_loop)
+         enter(index);
+
+      auto literal = node.literals.find(name);
+
+      if(literal != node.literals.end())
+         enter(literal->second);
+
+      for(const std::pair<std::string, uint32_t>& glob : node.globs) {
+         if(MatchGlob(glob.first, name))
+            enter(glob.second);
+      }
+   }
+
+   return rule;
+}
+
+void PathFilter::EnterDirectory(const std::string_view& relpath, dir_state_t& state) const
+{
+   static thread_local dir_state_t next;
+
+   std::string_view path = relpath;
+   std::string_view name;
+
+   state.clear();
+
+   for(uint32_t index = 0; index != no_node; index = nodes[index].any)
+      state.push_back(index);
+
+   while(NextComponent(path, name)) {
+      next.clear();
+
+      Step(state, name, true, &next);
+
+      // the same node may be reached through different pattern prefixes
+      std::sort(next.begin(), next.end());
+      next.erase(std::unique(next.begin(), next.end()), next.end());
+
+      state.swap(next);
+   }
+}
+
+bool PathFilter::IsExcluded(const dir_state_t& state, const std::string_view& name, bool is_dir) const
+{
+   int32_t rule = Step(state, name, is_dir, nullptr);
+
+   return rule >= 0 && rules[rule];
+}
+
+bool PathFilter::IsPathExcluded(const std::string_view& relpath, bool is_dir) const
+{
+   static thread_local dir_state_t state;
+   static thread_local dir_state_t next;
+
+   std::string_view path = relpath;
+   std::string_view name;
+   std::string_view next_name;
+
+   if(!NextComponent(path, name))
+      return false;
+
+   EnterDirectory(std::string_view(), state);
+
+   for(;;) {
+      // all components but the last one are directories, which exclude everything in them
+      bool last = !NextComponent(path, next_name);
+
+      next.clear();
+
+      int32_t rule = Step(state, name, last ? is_dir : true, last ? nullptr : &next);
+
+      if(rule >= 0 && rules[rule])
+         return true;
+
+      if(last)
+         return false;
+
+      std::sort(next.begin(), next.end());
+      next.erase(std::unique(next.begin(), next.end()), next.end());
+
+      state.swap(next);
+      name = next_name;
+   }
+}
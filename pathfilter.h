@@ -0,0 +1,127 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef PATHFILTER_H
+#define PATHFILTER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <functional>
+
+///
+/// @brief  Excludes files and directories whose paths match glob patterns
+///         in the `.gitignore` syntax.
+///
+/// Patterns are matched against paths relative to the root of the tree
+/// being counted. A pattern without a separator, other than a trailing
+/// one, matches a name at any depth, a pattern with a separator matches
+/// a path from the root, `*`, `?` and `[...]` match within a path
+/// component, `**` matches any number of path components and a trailing
+/// separator matches only directories. When a path matches multiple
+/// patterns, the last one decides whether it's excluded or included.
+///
+/// Patterns are compiled into a trie of path components, with literal
+/// components in sorted maps and wildcard ones in lists, which is walked
+/// as a non-deterministic automaton, one path component at a time. The
+/// automaton state of a directory is computed once and is then used to
+/// match all entries of that directory.
+///
+/// Directories are expected to be pruned when they are excluded, so the
+/// path of a directory passed to `EnterDirectory` is not matched itself.
+/// A filter may be shared by multiple threads once all patterns are added.
+///
+class PathFilter {
+   public:
+      ///
+      /// @brief  Automaton state of a directory, which is a list of trie
+      ///         nodes matching the directory path.
+      ///
+      typedef std::vector<uint32_t> dir_state_t;
+
+   private:
+      static constexpr uint32_t no_node = UINT32_MAX;
+
+      ///
+      /// @brief  A trie node, which matches a pattern prefix.
+      ///
+      struct node_t {
+         std::map<std::string, uint32_t, std::less<>> literals;       ///< Child nodes for literal components.
+         std::vector<std::pair<std::string, uint32_t>> globs;         ///< Child nodes for wildcard components.
+         uint32_t       any = no_node;       ///< Child node for `**`, which is matched without consuming a component.
+         bool           any_loop = false;    ///< Set for `**` nodes, which match any component and remain in the state.
+         int32_t        rule = -1;           ///< The last rule of a pattern ending at this node.
+         int32_t        dir_rule = -1;       ///< The last rule of a directory-only pattern ending at this node.
+      };
+
+   private:
+      std::vector<node_t>  nodes;            ///< Trie nodes, the first one being the root.
+      std::vector<bool>    rules;            ///< Exclusion flags of rules, indexed by the order of patterns.
+
+   private:
+      /// Returns the child node of `node` for the component `name`, adding it if needed.
+      uint32_t AddChild(uint32_t node, const std::string_view& name);
+
+      /// Returns the `**` child node of `node`, adding it if needed.
+      uint32_t AddAnyChild(uint32_t node);
+
+      ///
+      /// @brief  Moves the state `from` past the path component `name`,
+      ///         appending new state nodes to `to`, if it's not `nullptr`,
+      ///         and returns the last rule matching `name`, or `-1`.
+      ///
+      int32_t Step(const dir_state_t& from, const std::string_view& name, bool is_dir, dir_state_t *to) const;
+
+      /// Returns `true` if the glob `pattern` matches the path component `name`.
+      static bool MatchGlob(const std::string_view& pattern, const std::string_view& name);
+
+   public:
+      /// Creates a filter that matches no paths.
+      PathFilter(void);
+
+      /// Returns `true` if no patterns were added.
+      bool IsEmpty(void) const {return rules.empty();}
+
+      ///
+      /// @brief  Adds a pattern in the `.gitignore` syntax, without the `!`
+      ///         prefix, which excludes matching paths if `exclude` is `true`
+      ///         and includes them otherwise.
+      ///
+      /// Patterns use `/` as a separator, on all platforms. Empty patterns
+      /// are ignored.
+      ///
+      void AddPattern(std::string_view pattern, bool exclude);
+
+      ///
+      /// @brief  Adds patterns from the `.gitignore` file at `filepath`
+      ///         and returns `false` if the file does not exist.
+      ///
+      /// Blank lines and comments are ignored and patterns prefixed with
+      /// `!` include paths excluded by preceding patterns.
+      ///
+      bool ReadIgnoreFile(const std::string& filepath);
+
+      ///
+      /// @brief  Computes the automaton state of the directory `relpath`,
+      ///         relative to the root of the tree, which is empty for the
+      ///         root itself.
+      ///
+      void EnterDirectory(const std::string_view& relpath, dir_state_t& state) const;
+
+      /// Returns `true` if the entry `name` of the directory in `state` is excluded.
+      bool IsExcluded(const dir_state_t& state, const std::string_view& name, bool is_dir) const;
+
+      ///
+      /// @brief  Returns `true` if the path `relpath`, relative to the root of
+      ///         the tree, or any of its parent directories is excluded.
+      ///
+      bool IsPathExcluded(const std::string_view& relpath, bool is_dir) const;
+};
+
+#endif // PATHFILTER_H
@@ -0,0 +1,403 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "runstats.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include <cinttypes>
+#include <atomic>
+#include <algorithm>
+
+//
+// Per-thread counters are located via a thread-local pointer and the
+// instance identifier prevents a thread from using counters of a stats
+// instance that no longer exists.
+//
+static std::atomic<uint64_t> NextInstanceId(1);
+
+thread_local RunStats::thread_counters_t RunStats::thread_counters;
+
+///
+/// @brief  Orders slowest files, so the fastest one is at the top of the heap.
+///
+template <typename file_time_t>
+static bool IsSlowerFile(const file_time_t& file1, const file_time_t& file2)
+{
+   return file1.wall_ns > file2.wall_ns;
+}
+
+RunStats::PhaseTimer::PhaseTimer(RunStats *arg_stats, phase_t arg_phase) :
+      stats(arg_stats),
+      phase(arg_phase)
+{
+   if(stats)
+      wall_start = std::chrono::steady_clock::now();
+}
+
+RunStats::PhaseTimer::~PhaseTimer(void)
+{
+   Stop();
+}
+
+void RunStats::PhaseTimer::Stop(void)
+{
+   if(!stats)
+      return;
+
+   phase_stats_t& phase_stats = stats->GetThreadStats().phases[phase];
+
+   phase_stats.calls++;
+   phase_stats.wall_ns += (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wall_start).count();
+
+   stats = nullptr;
+}
+
+RunStats::thread_counters_t::~thread_counters_t(void)
+{
+   RecordCpuTime();
+}
+
+void RunStats::thread_counters_t::RecordCpuTime(void)
+{
+   // counters are shared with their instance, so they are still around if the instance is gone
+   if(stats && !stats->cpu_recorded) {
+      stats->cpu_ns = GetThreadCpuTime() - stats->cpu_start_ns;
+      stats->cpu_recorded = true;
+   }
+}
+
+RunStats::RunStats(uint64_t (*arg_alloc_counter)(void)) :
+      instance_id(NextInstanceId++),
+      start_time(std::chrono::steady_clock::now()),
+      start_cpu_ns(GetProcessCpuTime()),
+      alloc_counter(arg_alloc_counter),
+      start_allocs(arg_alloc_counter ? arg_alloc_counter() : 0)
+{
+}
+
+uint64_t RunStats::GetThreadCpuTime(void)
+{
+#if defined(_WIN32)
+   FILETIME creation_time, exit_time, kernel_time, user_time;
+
+   if(!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+      return 0;
+
+   // FILETIME values are in 100-nanosecond intervals
+   return ((((uint64_t) kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime) +
+            (((uint64_t) user_time.dwHighDateTime << 32) | user_time.dwLowDateTime)) * 100;
+#else
+   struct timespec cputime;
+
+   if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cputime) == -1)
+      return 0;
+
+   return (uint64_t) cputime.tv_sec * 1000000000 + (uint64_t) cputime.tv_nsec;
+#endif
+}
+
+uint64_t RunStats::GetProcessCpuTime(void)
+{
+#if defined(_WIN32)
+   FILETIME creation_time, exit_time, kernel_time, user_time;
+
+   if(!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+      return 0;
+
+   return ((((uint64_t) kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime) +
+            (((uint64_t) user_time.dwHighDateTime << 32) | user_time.dwLowDateTime)) * 100;
+#else
+   struct rusage usage;
+
+   if(getrusage(RUSAGE_SELF, &usage) == -1)
+      return 0;
+
+   return ((uint64_t) usage.ru_utime.tv_sec + (uint64_t) usage.ru_stime.tv_sec) * 1000000000 +
+            ((uint64_t) usage.ru_utime.tv_usec + (uint64_t) usage.ru_stime.tv_usec) * 1000;
+#endif
+}
+
+RunStats::thread_stats_t& RunStats::GetThreadStats(void)
+{
+   if(thread_counters.instance_id != instance_id) {
+      std::shared_ptr<thread_stats_t> stats = std::make_shared<thread_stats_t>();
+
+      stats->cpu_start_ns = GetThreadCpuTime();
+
+      {
+         std::lock_guard<std::mutex> lock(threads_mtx);
+         threads.push_back(stats);
+      }
+
+      thread_counters.RecordCpuTime();
+
+      thread_counters.instance_id = instance_id;
+      thread_counters.stats = std::move(stats);
+   }
+
+   return *thread_counters.stats;
+}
+
+size_t RunStats::GetSizeBucket(uint64_t size)
+{
+   size_t bucket = 0;
+
+   for(uint64_t limit = 1024; bucket < size_bucket_count - 1 && size >= limit; limit *= 4)
+      bucket++;
+
+   return bucket;
+}
+
+uint64_t RunStats::GetSizeBucketMin(size_t bucket)
+{
+   return bucket ? (uint64_t) 1024 << (2 * (bucket - 1)) : 0;
+}
+
+void RunStats::AddFile(const std::string_view& filepath, uint64_t size, uint64_t wall_ns)
+{
+   thread_stats_t& stats = GetThreadStats();
+
+   stats.filecnt++;
+   stats.bytecnt += size;
+   stats.size_buckets[GetSizeBucket(size)]++;
+
+   // keep only the slowest files, with the fastest of them at the top of the heap
+   if(stats.slowest.size() < slowest_count) {
+      stats.slowest.push_back({std::string(filepath), size, wall_ns});
+      std::push_heap(stats.slowest.begin(), stats.slowest.end(), IsSlowerFile<file_time_t>);
+   }
+   else if(wall_ns > stats.slowest.front().wall_ns) {
+      std::pop_heap(stats.slowest.begin(), stats.slowest.end(), IsSlowerFile<file_time_t>);
+      stats.slowest.back().filepath.assign(filepath);
+      stats.slowest.back().size = size;
+      stats.slowest.back().wall_ns = wall_ns;
+      std::push_heap(stats.slowest.begin(), stats.slowest.end(), IsSlowerFile<file_time_t>);
+   }
+}
+
+void RunStats::MergeThreadStats(thread_stats_t& totals) const
+{
+   for(const std::shared_ptr<thread_stats_t>& stats : threads) {
+      for(size_t phase = 0; phase < PHASE_COUNT; phase++) {
+         totals.phases[phase].calls += stats->phases[phase].calls;
+         totals.phases[phase].wall_ns += stats->phases[phase].wall_ns;
+      }
+
+      // CPU time of the reporting thread is sampled now and other running threads are skipped
+      if(stats->cpu_recorded) {
+         totals.cpu_ns += stats->cpu_ns;
+         totals.threadcnt++;
+      }
+      else if(stats == thread_counters.stats) {
+         totals.cpu_ns += GetThreadCpuTime() - stats->cpu_start_ns;
+         totals.threadcnt++;
+      }
+
+      totals.filecnt += stats->filecnt;
+      totals.bytecnt += stats->bytecnt;
+
+      for(size_t bucket = 0; bucket < size_bucket_count; bucket++)
+         totals.size_buckets[bucket] += stats->size_buckets[bucket];
+
+      totals.slowest.insert(totals.slowest.end(), stats->slowest.begin(), stats->slowest.end());
+   }
+
+   // sort the slowest files of all threads from the slowest one down
+   std::sort(totals.slowest.begin(), totals.slowest.end(), IsSlowerFile<file_time_t>);
+
+   if(totals.slowest.size() > slowest_count)
+      totals.slowest.resize(slowest_count);
+}
+
+const char *RunStats::GetPhaseName(phase_t phase)
+{
+   switch(phase) {
+      case PHASE_ENUM:
+         return "enumerate";
+      case PHASE_OPEN:
+         return "open";
+      case PHASE_READ:
+         return "read";
+      case PHASE_LEX:
+         return "lex";
+      case PHASE_HASH:
+         return "hash";
+      case PHASE_CACHE:
+         return "cache";
+      default:
+         return "unknown";
+   }
+}
+
+std::string RunStats::JsonString(const std::string& str)
+{
+   std::string json = "\"";
+
+   for(char chr : str) {
+      switch(chr) {
+         case '"':
+            json += "\\\"";
+            break;
+         case '\\':
+            json += "\\\\";
+            break;
+         case '\n':
+            json += "\\n";
+            break;
+         case '\r':
+            json += "\\r";
+            break;
+         case '\t':
+            json += "\\t";
+            break;
+         default:
+            if((unsigned char) chr < 0x20) {
+               char escape[8];
+               snprintf(escape, sizeof(escape), "\\u%04x", (unsigned int) (unsigned char) chr);
+               json += escape;
+            }
+            else
+               json += chr;
+            break;
+      }
+   }
+
+   return json += "\"";
+}
+
+void RunStats::PrintReport(FILE *output) const
+{
+   thread_stats_t totals;
+
+   MergeThreadStats(totals);
+
+   double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+   double cpu_time = (double) (GetProcessCpuTime() - start_cpu_ns) / 1e9;
+
+   fprintf(output, "Statistics:\n\n");
+   fprintf(output, "   Phase          Calls   Wall (ms)\n");
+   fprintf(output, "   ---------- ---------- -----------\n");
+
+   for(size_t phase = 0; phase < PHASE_COUNT; phase++) {
+      fprintf(output, "   %-10s %10" PRIu64 " %11.3f\n", GetPhaseName((phase_t) phase), totals.phases[phase].calls,
+                        (double) totals.phases[phase].wall_ns / 1e6);
+   }
+
+   fprintf(output, "\n");
+   fprintf(output, "Elapsed time           : %.3f s\n", elapsed);
+   fprintf(output, "CPU time               : %.3f s\n", cpu_time);
+   fprintf(output, "Thread CPU time        : %.3f s (%zu threads)\n", (double) totals.cpu_ns / 1e9, totals.threadcnt);
+   fprintf(output, "Files read             : %" PRIu64 "\n", totals.filecnt);
+   fprintf(output, "Bytes read             : %" PRIu64 "\n", totals.bytecnt);
+
+   if(alloc_counter) {
+      uint64_t allocs = alloc_counter() - start_allocs;
+
+      fprintf(output, "Allocations            : %" PRIu64 "\n", allocs);
+
+      if(totals.filecnt)
+         fprintf(output, "Allocations per file   : %.2f\n", (double) allocs / (double) totals.filecnt);
+   }
+
+   if(elapsed > 0) {
+      fprintf(output, "Files per second       : %.2f\n", (double) totals.filecnt / elapsed);
+      fprintf(output, "MB per second          : %.2f\n", (double) totals.bytecnt / (1024. * 1024.) / elapsed);
+   }
+
+   if(!totals.slowest.empty()) {
+      fprintf(output, "\nSlowest files:\n\n");
+      fprintf(output, "     Time (ms)        Size  File\n");
+      fprintf(output, "   ----------- -----------  ----\n");
+
+      for(const file_time_t& file : totals.slowest)
+         fprintf(output, "   %11.3f %11" PRIu64 "  %s\n", (double) file.wall_ns / 1e6, file.size, file.filepath.c_str());
+   }
+
+   fprintf(output, "\nFile sizes:\n\n");
+
+   for(size_t bucket = 0; bucket < size_bucket_count; bucket++) {
+      if(bucket < size_bucket_count - 1)
+         fprintf(output, "   <  %6" PRIu64 " KB : %" PRIu64 "\n", GetSizeBucketMin(bucket + 1) / 1024, totals.size_buckets[bucket]);
+      else
+         fprintf(output, "   >= %6" PRIu64 " KB : %" PRIu64 "\n", GetSizeBucketMin(bucket) / 1024, totals.size_buckets[bucket]);
+   }
+
+   fprintf(output, "\n");
+}
+
+///
+/// A record has the same members as a report, in a single line, without
+/// spaces, with a `type` member in front, same as other JSON Lines records.
+///
+void RunStats::PrintJsonReport(FILE *output, bool record) const
+{
+   thread_stats_t totals;
+
+   MergeThreadStats(totals);
+
+   double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+   uint64_t cpu_ns = GetProcessCpuTime() - start_cpu_ns;
+
+   // line breaks with indentation at each level and a separator after names
+   const char *nl1 = record ? "" : "\n  ";
+   const char *nl2 = record ? "" : "\n    ";
+   const char *nl = record ? "" : "\n";
+   const char *sep = record ? ":" : ": ";
+   const char *space = record ? "" : " ";
+
+   fprintf(output, record ? "{\"type\":\"stats\"," : "{");
+   fprintf(output, "%s\"elapsed_ns\"%s%" PRIu64 ",", nl1, sep, (uint64_t) (elapsed * 1e9));
+   fprintf(output, "%s\"cpu_ns\"%s%" PRIu64 ",", nl1, sep, cpu_ns);
+   fprintf(output, "%s\"thread_cpu_ns\"%s%" PRIu64 ",", nl1, sep, totals.cpu_ns);
+   fprintf(output, "%s\"threads\"%s%zu,", nl1, sep, totals.threadcnt);
+   fprintf(output, "%s\"files\"%s%" PRIu64 ",", nl1, sep, totals.filecnt);
+   fprintf(output, "%s\"bytes\"%s%" PRIu64 ",", nl1, sep, totals.bytecnt);
+
+   if(alloc_counter)
+      fprintf(output, "%s\"allocations\"%s%" PRIu64 ",", nl1, sep, alloc_counter() - start_allocs);
+
+   fprintf(output, "%s\"files_per_second\"%s%.2f,", nl1, sep, elapsed > 0 ? (double) totals.filecnt / elapsed : 0.);
+   fprintf(output, "%s\"mb_per_second\"%s%.2f,", nl1, sep, elapsed > 0 ? (double) totals.bytecnt / (1024. * 1024.) / elapsed : 0.);
+
+   fprintf(output, "%s\"phases\"%s{", nl1, sep);
+
+   for(size_t phase = 0; phase < PHASE_COUNT; phase++) {
+      fprintf(output, "%s\"%s\"%s{\"calls\"%s%" PRIu64 ",%s\"wall_ns\"%s%" PRIu64 "}%s", nl2, GetPhaseName((phase_t) phase), sep,
+                        sep, totals.phases[phase].calls, space, sep, totals.phases[phase].wall_ns,
+                        phase < PHASE_COUNT - 1 ? "," : "");
+   }
+
+   fprintf(output, "%s},", nl1);
+
+   fprintf(output, "%s\"slowest_files\"%s[", nl1, sep);
+
+   for(size_t index = 0; index < totals.slowest.size(); index++) {
+      const file_time_t& file = totals.slowest[index];
+
+      fprintf(output, "%s%s{\"path\"%s%s,%s\"size\"%s%" PRIu64 ",%s\"wall_ns\"%s%" PRIu64 "}", index ? "," : "", nl2,
+                        sep, JsonString(file.filepath).c_str(), space, sep, file.size, space, sep, file.wall_ns);
+   }
+
+   fprintf(output, "%s],", totals.slowest.empty() ? "" : nl1);
+
+   // each bucket is described by its lower bound, in bytes
+   fprintf(output, "%s\"size_histogram\"%s[", nl1, sep);
+
+   for(size_t bucket = 0; bucket < size_bucket_count; bucket++) {
+      fprintf(output, "%s%s{\"min_size\"%s%" PRIu64 ",%s\"files\"%s%" PRIu64 "}", bucket ? "," : "", nl2,
+                        sep, GetSizeBucketMin(bucket), space, sep, totals.size_buckets[bucket]);
+   }
+
+   fprintf(output, "%s]", nl1);
+   fprintf(output, "%s}\n", nl);
+}
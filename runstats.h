@@ -0,0 +1,195 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef RUNSTATS_H
+#define RUNSTATS_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+///
+/// @brief  Run statistics, which track time spent in each processing
+///         phase, file throughput, the slowest files and file sizes.
+///
+/// Each thread records statistics into its own counters, without any
+/// locking, and counters of all threads are merged when the report is
+/// generated. Wall time of each phase is the sum of wall times of all
+/// threads, which may be greater than the elapsed time of the run when
+/// multiple threads are used.
+///
+/// Phases are timed with a steady clock, which doesn't require a system
+/// call. CPU time of each thread is sampled only when the thread records
+/// its first statistics and when it exits, or, for the thread generating
+/// a report, when the report is generated. Threads that are still running
+/// when a report is generated are not included in thread CPU time.
+///
+/// Reports must not be generated while other threads record statistics.
+///
+class RunStats {
+   public:
+      ///
+      /// @brief  Processing phases.
+      ///
+      enum phase_t {
+         PHASE_ENUM,                         ///< Enumerating directories.
+         PHASE_OPEN,                         ///< Opening and mapping files.
+         PHASE_READ,                         ///< Reading files into memory.
+         PHASE_LEX,                          ///< Counting lines.
+         PHASE_HASH,                         ///< Hashing file contents for `--dedup`.
+         PHASE_CACHE,                        ///< Looking up and updating cached line counts.
+         PHASE_COUNT
+      };
+
+      ///
+      /// @brief  Measures time spent in a phase from construction until
+      ///         `Stop` is called or until destruction. Does nothing if
+      ///         `stats` is `nullptr`.
+      ///
+      class PhaseTimer {
+         private:
+            RunStats    *stats;
+            phase_t     phase;
+            std::chrono::steady_clock::time_point wall_start;
+
+         public:
+            PhaseTimer(RunStats *stats, phase_t phase);
+
+            PhaseTimer(const PhaseTimer&) = delete;
+
+            ~PhaseTimer(void);
+
+            PhaseTimer& operator = (const PhaseTimer&) = delete;
+
+            /// Records time spent in the phase so far and stops the timer.
+            void Stop(void);
+      };
+
+   private:
+      /// Number of slowest files that are reported.
+      static constexpr size_t slowest_count = 10;
+
+      /// Number of file size histogram buckets, each 4 times larger than the previous one, starting with 1 KB.
+      static constexpr size_t size_bucket_count = 8;
+
+      ///
+      /// @brief  Time spent in one phase.
+      ///
+      struct phase_stats_t {
+         uint64_t    calls = 0;              ///< Number of times the phase was entered.
+         uint64_t    wall_ns = 0;            ///< Wall time, in nanoseconds.
+      };
+
+      ///
+      /// @brief  Time spent processing one file.
+      ///
+      struct file_time_t {
+         std::string filepath;               ///< File path.
+         uint64_t    size;                   ///< File size, in bytes.
+         uint64_t    wall_ns;                ///< Wall time, in nanoseconds.
+      };
+
+      ///
+      /// @brief  Counters of a single thread.
+      ///
+      struct thread_stats_t {
+         phase_stats_t  phases[PHASE_COUNT];             ///< Per-phase times.
+         uint64_t       filecnt = 0;                     ///< Number of files read.
+         uint64_t       bytecnt = 0;                     ///< Number of bytes read.
+         uint64_t       size_buckets[size_bucket_count] = {};  ///< File size histogram.
+         std::vector<file_time_t> slowest;               ///< Slowest files, as a min-heap by time.
+         uint64_t       cpu_start_ns = 0;                ///< Thread CPU time when counters were created.
+         uint64_t       cpu_ns = 0;                      ///< Thread CPU time used since counters were created.
+         bool           cpu_recorded = false;            ///< Set when `cpu_ns` was recorded.
+         size_t         threadcnt = 0;                   ///< Number of threads with recorded CPU time.
+      };
+
+      ///
+      /// @brief  Counters of the current thread, which record CPU time of
+      ///         the thread when it exits or starts using another instance.
+      ///
+      struct thread_counters_t {
+         uint64_t       instance_id = 0;                 ///< Instance that owns `stats`.
+         std::shared_ptr<thread_stats_t> stats;          ///< Counters of the current thread.
+
+         ~thread_counters_t(void);
+
+         /// Records CPU time used by the current thread since its counters were created.
+         void RecordCpuTime(void);
+      };
+
+   private:
+      std::vector<std::shared_ptr<thread_stats_t>> threads; ///< Per-thread counters.
+      std::mutex     threads_mtx;            ///< Protects `threads`.
+
+      uint64_t       instance_id;            ///< Identifies per-thread counters of this instance.
+
+      std::chrono::steady_clock::time_point start_time;  ///< Time when statistics were started.
+      uint64_t       start_cpu_ns;           ///< Process CPU time when statistics were started.
+      uint64_t       (*alloc_counter)(void); ///< Returns the number of memory allocations made so far, if set.
+      uint64_t       start_allocs;           ///< Number of memory allocations when statistics were started.
+
+      static thread_local thread_counters_t thread_counters;   ///< Counters of the current thread.
+
+   private:
+      /// Returns counters of the calling thread, creating them if needed.
+      thread_stats_t& GetThreadStats(void);
+
+      /// Merges counters of all threads into `totals`.
+      void MergeThreadStats(thread_stats_t& totals) const;
+
+      /// Returns the bucket index of the file size histogram for `size`.
+      static size_t GetSizeBucket(uint64_t size);
+
+      /// Returns the lower bound of the file size histogram bucket, in bytes.
+      static uint64_t GetSizeBucketMin(size_t bucket);
+
+      /// Returns CPU time used by the calling thread, in nanoseconds.
+      static uint64_t GetThreadCpuTime(void);
+
+      /// Returns CPU time used by this process, in nanoseconds.
+      static uint64_t GetProcessCpuTime(void);
+
+      /// Returns the name of `phase` used in reports.
+      static const char *GetPhaseName(phase_t phase);
+
+      /// Returns `str` as a quoted JSON string.
+      static std::string JsonString(const std::string& str);
+
+   public:
+      ///
+      /// @brief  Starts collecting statistics for the run.
+      ///
+      /// Allocations are reported only if `alloc_counter` is provided,
+      /// because counting them requires replacing global `operator new`,
+      /// which is left to executables.
+      ///
+      RunStats(uint64_t (*alloc_counter)(void) = nullptr);
+
+      RunStats(const RunStats&) = delete;
+
+      RunStats& operator = (const RunStats&) = delete;
+
+      /// Records that a file of `size` bytes was read and processed in `wall_ns` nanoseconds.
+      void AddFile(const std::string_view& filepath, uint64_t size, uint64_t wall_ns);
+
+      /// Prints a human-readable report to `output`.
+      void PrintReport(FILE *output) const;
+
+      ///
+      /// @brief  Prints a JSON report to `output`, which is a single line
+      ///         with `"type":"stats"` if `record` is `true`.
+      ///
+      void PrintJsonReport(FILE *output, bool record = false) const;
+};
+
+#endif // RUNSTATS_H
@@ -0,0 +1,864 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "simdlexer.h"
+#include "cpplexer_scanner.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMDLEXER_SSE2
+#include <emmintrin.h>
+
+// AVX2 is detected at run time, which is only implemented for GCC and Clang
+#if defined(__GNUC__)
+#define SIMDLEXER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+///
+/// @brief  Returns `true` for characters matched by `WS` in `cpplexer_scanner.l`.
+///
+inline bool IsSpace(char chr)
+{
+   unsigned char uchr = (unsigned char) chr;
+
+   return uchr == 0x09 || uchr == 0x0B || uchr == 0x0C || (uchr >= 0x0E && uchr <= 0x20);
+}
+
+///
+/// @brief  Returns `true` for characters matched by `CODE` in `cpplexer_scanner.l`.
+///
+inline bool IsCode(char chr)
+{
+   return !IsSpace(chr) && chr != '\r' && chr != '\n';
+}
+
+///
+/// @brief  Returns the length of the end-of-line sequence at `ptr` or zero
+///         if there is none.
+///
+inline size_t GetEOLLength(const char *ptr, const char *end)
+{
+   if(*ptr == '\n')
+      return 1;
+
+   if(*ptr == '\r')
+      return ptr + 1 < end && ptr[1] == '\n' ? 2 : 1;
+
+   return 0;
+}
+
+///
+/// @brief  Returns `true` if the characters at `ptr` start with a non-empty
+///         `token`.
+///
+inline bool StartsWith(const char *ptr, const char *end, std::string_view token)
+{
+   return !token.empty() && (size_t) (end - ptr) >= token.length() && !memcmp(ptr, token.data(), token.length());
+}
+
+///
+/// @brief  Returns the length of a Lua long bracket at `ptr`, which is two
+///         `bracket` characters with any number of equal signs between them,
+///         such as `[==[`, or zero if there is none.
+///
+/// The number of equal signs is stored in `level`. Opening and closing
+/// long brackets match only if they are of the same level.
+///
+inline size_t GetLongBracketLength(const char *ptr, const char *end, char bracket, size_t& level)
+{
+   if(ptr == end || *ptr != bracket)
+      return 0;
+
+   const char *eqptr = ptr + 1;
+
+   while(eqptr < end && *eqptr == '=')
+      eqptr++;
+
+   if(eqptr == end || *eqptr != bracket)
+      return 0;
+
+   level = eqptr - ptr - 1;
+
+   return eqptr - ptr + 1;
+}
+
+///
+/// @brief  Returns the length of the delimiter at `ptr`, which is known to
+///         start with `quote`, if it closes a multi-line string opened with
+///         `quote` and a long bracket `level`, or zero otherwise.
+///
+inline size_t GetLongStringCloseLength(const char *ptr, const char *end, char quote, size_t level)
+{
+   if(quote == '`')
+      return 1;
+
+   if(quote == ']') {
+      size_t close_level = 0;
+      size_t length = GetLongBracketLength(ptr, end, ']', close_level);
+
+      return close_level == level ? length : 0;
+   }
+
+   // triple-quoted strings
+   return end - ptr >= 3 && ptr[1] == quote && ptr[2] == quote ? 3 : 0;
+}
+
+///
+/// @brief  Adds a line of the type identified by a Flex token to line counts.
+///
+void CountLine(CppFlexLexer::Result& counts, int token)
+{
+   counts.linecnt++;
+
+   switch (token) {
+      case TOKEN_EMPTY_LINE:
+         counts.emptycnt++;
+         break;
+      case TOKEN_BRACE_LINE:
+         counts.bracecnt++;
+         break;
+      case TOKEN_CODE_EOL:
+         counts.codecnt++;
+         break;
+      case TOKEN_C_COMMENT_EOL:
+         counts.ccnt++;
+         counts.cmntcnt++;
+         break;
+      case TOKEN_CPP_COMMENT_EOL:
+         counts.cppcnt++;
+         counts.cmntcnt++;
+         break;
+      case TOKEN_C_CPP_COMMENT_EOL:
+         counts.cppcnt++;
+         counts.ccnt++;
+         counts.cmntcnt++;
+         break;
+      case TOKEN_CODE_C_COMMENT_EOL:
+         counts.ccnt++;
+         counts.codecnt++;
+         counts.cmntcnt++;
+         break;
+      case TOKEN_CODE_CPP_COMMENT_EOL:
+         counts.cppcnt++;
+         counts.codecnt++;
+         counts.cmntcnt++;
+         break;
+      case TOKEN_CODE_C_CPP_COMMENT_EOL:
+         counts.ccnt++;
+         counts.cppcnt++;
+         counts.codecnt++;
+         counts.cmntcnt++;
+         break;
+   }
+}
+
+///
+/// @brief  Returns the index of the lowest set bit in a non-zero mask.
+///
+template <typename mask_t>
+inline size_t GetFirstSetBit(mask_t mask)
+{
+#if defined(_MSC_VER)
+   unsigned long index;
+
+   if constexpr (sizeof(mask_t) == sizeof(uint64_t))
+      _BitScanForward64(&index, mask);
+   else
+      _BitScanForward(&index, mask);
+
+   return index;
+#else
+   if constexpr (sizeof(mask_t) == sizeof(uint64_t))
+      return (size_t) __builtin_ctzll(mask);
+   else
+      return (size_t) __builtin_ctz(mask);
+#endif
+}
+
+///
+/// @brief  Returns a pointer to the first of any of `chars` in the range
+///         or `end` if none is found, one character at a time.
+///
+template <char ...chars>
+inline const char *FindAnyScalar(const char *ptr, const char *end)
+{
+   while(ptr < end && !((*ptr == chars) || ...))
+      ptr++;
+
+   return ptr;
+}
+
+#if defined(SIMDLEXER_SSE2)
+///
+/// @brief  Returns a mask of bytes in `block` that are equal to any of `chars`.
+///
+template <char ...chars>
+inline __m128i MatchAny(__m128i block)
+{
+   __m128i mask = _mm_setzero_si128();
+
+   ((mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8(chars)))), ...);
+
+   return mask;
+}
+
+///
+/// @brief  Returns a pointer to the first of any of `chars` in the range
+///         or `end` if none is found, 32 characters at a time.
+///
+template <char ...chars>
+const char *FindAnySSE2(const char *ptr, const char *end)
+{
+   while(end - ptr >= 32) {
+      __m128i lo = _mm_loadu_si128((const __m128i*) ptr);
+      __m128i hi = _mm_loadu_si128((const __m128i*) (ptr + 16));
+
+      uint32_t mask = (uint32_t) _mm_movemask_epi8(MatchAny<chars...>(lo)) |
+                        (uint32_t) _mm_movemask_epi8(MatchAny<chars...>(hi)) << 16;
+
+      if(mask)
+         return ptr + GetFirstSetBit(mask);
+
+      ptr += 32;
+   }
+
+   return FindAnyScalar<chars...>(ptr, end);
+}
+#endif
+
+#if defined(SIMDLEXER_AVX2)
+///
+/// @brief  Returns a mask of bytes in `block` that are equal to any of `chars`.
+///
+template <char ...chars>
+__attribute__((target("avx2")))
+inline __m256i MatchAny(__m256i block)
+{
+   __m256i mask = _mm256_setzero_si256();
+
+   ((mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(chars)))), ...);
+
+   return mask;
+}
+
+///
+/// @brief  Returns a pointer to the first of any of `chars` in the range
+///         or `end` if none is found, 64 characters at a time.
+///
+template <char ...chars>
+__attribute__((target("avx2")))
+const char *FindAnyAVX2(const char *ptr, const char *end)
+{
+   while(end - ptr >= 64) {
+      __m256i lo = _mm256_loadu_si256((const __m256i*) ptr);
+      __m256i hi = _mm256_loadu_si256((const __m256i*) (ptr + 32));
+
+      uint64_t mask = (uint64_t) (uint32_t) _mm256_movemask_epi8(MatchAny<chars...>(lo)) |
+                        (uint64_t) (uint32_t) _mm256_movemask_epi8(MatchAny<chars...>(hi)) << 32;
+
+      if(mask)
+         return ptr + GetFirstSetBit(mask);
+
+      ptr += 64;
+   }
+
+   return FindAnySSE2<chars...>(ptr, end);
+}
+
+///
+/// @brief  Returns `true` if the processor supports AVX2 instructions.
+///
+bool HasAVX2(void)
+{
+   static const bool has_avx2 = [] {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") != 0;
+   }();
+
+   return has_avx2;
+}
+#endif
+
+///
+/// @brief  Returns a pointer to the first of any of `chars` in the range
+///         or `end` if none is found, using the widest instructions the
+///         processor supports.
+///
+template <char ...chars>
+inline const char *FindAny(const char *ptr, const char *end)
+{
+#if defined(SIMDLEXER_AVX2)
+   if(HasAVX2())
+      return FindAnyAVX2<chars...>(ptr, end);
+#endif
+
+#if defined(SIMDLEXER_SSE2)
+   return FindAnySSE2<chars...>(ptr, end);
+#else
+   return FindAnyScalar<chars...>(ptr, end);
+#endif
+}
+
+//
+// Syntax profiles describe comment delimiters and provide a search for
+// characters that may change the state within code, which includes the
+// first characters of comment delimiters and of string literals. An
+// empty delimiter means that there is no such comment in the language.
+//
+// Multi-line strings are enclosed in backticks in template literals, in
+// triple quotes in Python and in long brackets in Lua, which are also
+// used for Lua long comments.
+//
+
+///
+/// @brief  Comment syntax of C, C++ and Java.
+///
+struct c_syntax_t {
+   static constexpr std::string_view line_comment = "//";
+   static constexpr std::string_view block_open = "/*";
+   static constexpr std::string_view block_close = "*/";
+   static constexpr bool template_literals = false;
+   static constexpr bool triple_quotes = false;
+   static constexpr bool long_brackets = false;
+   static constexpr bool parameter_hash = false;
+
+   static const char *FindCodeBreak(const char *ptr, const char *end)
+   {
+      return FindAny<'"', '\'', '/', '\r', '\n'>(ptr, end);
+   }
+};
+
+///
+/// @brief  Comment syntax of JavaScript and TypeScript, which have template
+///         literals enclosed in backticks that may span multiple lines.
+///
+struct js_syntax_t : c_syntax_t {
+   static constexpr bool template_literals = true;
+
+   static const char *FindCodeBreak(const char *ptr, const char *end)
+   {
+      return FindAny<'"', '\'', '`', '/', '\r', '\n'>(ptr, end);
+   }
+};
+
+///
+/// @brief  Comment syntax of shell scripts, Python, YAML, Perl and Ruby,
+///         with Python triple-quoted strings. A `#` right after `$` or `${`,
+///         such as in `$#` or `${#name}`, is not a comment.
+///
+struct hash_syntax_t {
+   static constexpr std::string_view line_comment = "#";
+   static constexpr std::string_view block_open = "";
+   static constexpr std::string_view block_close = "";
+   static constexpr bool template_literals = false;
+   static constexpr bool triple_quotes = true;
+   static constexpr bool long_brackets = false;
+   static constexpr bool parameter_hash = true;
+
+   static const char *FindCodeBreak(const char *ptr, const char *end)
+   {
+      return FindAny<'"', '\'', '#', '\r', '\n'>(ptr, end);
+   }
+};
+
+///
+/// @brief  Comment syntax of SQL.
+///
+struct sql_syntax_t {
+   static constexpr std::string_view line_comment = "--";
+   static constexpr std::string_view block_open = "/*";
+   static constexpr std::string_view block_close = "*/";
+   static constexpr bool template_literals = false;
+   static constexpr bool triple_quotes = false;
+   static constexpr bool long_brackets = false;
+   static constexpr bool parameter_hash = false;
+
+   static const char *FindCodeBreak(const char *ptr, const char *end)
+   {
+      return FindAny<'"', '\'', '-', '/', '\r', '\n'>(ptr, end);
+   }
+};
+
+///
+/// @brief  Comment syntax of Lua. Long comments and long strings may have
+///         equal signs between brackets, such as `--[==[` and `[==[`, and
+///         end only with a closing bracket of the same level.
+///
+struct lua_syntax_t {
+   static constexpr std::string_view line_comment = "--";
+   static constexpr std::string_view block_open = "--[[";
+   static constexpr std::string_view block_close = "]]";
+   static constexpr bool template_literals = false;
+   static constexpr bool triple_quotes = false;
+   static constexpr bool long_brackets = true;
+   static constexpr bool parameter_hash = false;
+
+   static const char *FindCodeBreak(const char *ptr, const char *end)
+   {
+      return FindAny<'"', '\'', '-', '[', '\r', '\n'>(ptr, end);
+   }
+};
+
+///
+/// @brief  Returns the length of a block comment delimiter at `ptr`, or zero
+///         if there is none, and stores the level of a Lua long comment in
+///         `level`.
+///
+template <typename syntax_t>
+inline size_t GetBlockOpenLength(const char *ptr, const char *end, size_t& level)
+{
+   if constexpr (syntax_t::long_brackets) {
+      size_t length;
+
+      if(StartsWith(ptr, end, syntax_t::line_comment) && (length = GetLongBracketLength(ptr + syntax_t::line_comment.length(), end, '[', level)) != 0)
+         return syntax_t::line_comment.length() + length;
+
+      return 0;
+   }
+   else
+      return StartsWith(ptr, end, syntax_t::block_open) ? syntax_t::block_open.length() : 0;
+}
+
+///
+/// @brief  Returns the length of a delimiter at `ptr` that closes a block
+///         comment of the long bracket `level`, or zero if there is none.
+///
+template <typename syntax_t>
+inline size_t GetBlockCloseLength(const char *ptr, const char *end, size_t level)
+{
+   if constexpr (syntax_t::long_brackets)
+      return GetLongStringCloseLength(ptr, end, ']', level);
+   else
+      return StartsWith(ptr, end, syntax_t::block_close) ? syntax_t::block_close.length() : 0;
+}
+
+///
+/// @brief  Returns the length of a delimiter at `ptr` that opens a multi-line
+///         string, or zero if there is none, and stores the character that
+///         closes the string in `quote` and the long bracket level in `level`.
+///
+template <typename syntax_t>
+inline size_t GetLongStringOpenLength(const char *ptr, const char *end, char& quote, size_t& level)
+{
+   if constexpr (syntax_t::template_literals) {
+      if(*ptr == '`') {
+         quote = '`';
+         return 1;
+      }
+   }
+
+   if constexpr (syntax_t::triple_quotes) {
+      if((*ptr == '"' || *ptr == '\'') && end - ptr >= 3 && ptr[1] == *ptr && ptr[2] == *ptr) {
+         quote = *ptr;
+         return 3;
+      }
+   }
+
+   if constexpr (syntax_t::long_brackets) {
+      size_t length = GetLongBracketLength(ptr, end, '[', level);
+
+      if(length) {
+         quote = ']';
+         return length;
+      }
+   }
+
+   return 0;
+}
+
+///
+/// @brief  Returns `true` if there is a line comment delimiter at `ptr`.
+///
+template <typename syntax_t>
+inline bool IsLineComment(const char *begin, const char *ptr, const char *end)
+{
+   if(!StartsWith(ptr, end, syntax_t::line_comment))
+      return false;
+
+   if constexpr (syntax_t::parameter_hash) {
+      // $# and ${#name} are parameters
+      if(ptr > begin && (ptr[-1] == '$' || (ptr[-1] == '{' && ptr - 1 > begin && ptr[-2] == '$')))
+         return false;
+   }
+
+   return true;
+}
+
+}
+
+SimdLexer::SimdLexer(const std::string_view& source, profile_t profile) :
+      source(source),
+      profile(profile)
+{
+}
+
+bool SimdLexer::IsVectorized(void)
+{
+#if defined(SIMDLEXER_SSE2)
+   return true;
+#else
+   return false;
+#endif
+}
+
+//
+// Comments in this method refer to rules in `cpplexer_scanner.l`, which
+// are matched by Flex using the longest match, with ties resolved in the
+// order rules are listed in the scanner file.
+//
+// Rules anchored with `^` match only at the beginning of the source or
+// right after a new line character, which means that they do not match
+// after a line ending with a lone carriage return. Flex keeps track of
+// this in the buffer's `yy_at_bol`, which is equivalent to checking the
+// preceding character.
+//
+// Characters not matched by any rule in the current state are discarded,
+// which includes the line feed character in the `BOL` state, which is
+// not matched by any of the `BOL` rules when it's not at the beginning
+// of a line.
+//
+// Other syntax profiles follow the same rules, with their own comment
+// delimiters in place of `//`, `/*` and `*/`.
+//
+template <typename syntax_t>
+CppFlexLexer::Result SimdLexer::CountSyntaxLines(void) const
+{
+   CppFlexLexer::Result counts;
+
+   const char *begin = source.data();
+   const char *end = begin + source.length();
+   const char *ptr = begin;
+
+   state_t state = INITIAL;
+   size_t eol;
+   size_t length;
+
+   // closing quote character and long bracket level of the current multi-line string or comment
+   char quote = 0;
+   size_t level = 0;
+
+   while(ptr < end) {
+      switch (state) {
+         case INITIAL:
+         case BOL:
+            if(ptr == begin || ptr[-1] == '\n') {
+               const char *wsptr = ptr;
+
+               while(wsptr < end && IsSpace(*wsptr))
+                  wsptr++;
+
+               // ^{WS}*[\{\}]{WS}* is longer than ^{WS}+ if there's a brace
+               if(wsptr < end && (*wsptr == '{' || *wsptr == '}')) {
+                  for(ptr = wsptr + 1; ptr < end && IsSpace(*ptr); ptr++);
+                  state = BRL;
+                  break;
+               }
+
+               if(wsptr > ptr) {
+                  ptr = wsptr;
+                  state = LWS;
+                  break;
+               }
+
+               if((eol = GetEOLLength(ptr, end)) != 0) {
+                  ptr += eol;
+                  CountLine(counts, TOKEN_EMPTY_LINE);
+                  state = BOL;
+                  break;
+               }
+            }
+            // continue with rules that are not anchored
+            [[fallthrough]];
+         case LWS:
+         case BRL:
+            if((length = GetLongStringOpenLength<syntax_t>(ptr, end, quote, level)) != 0) {
+               ptr += length - 1;
+               state = TQSTR;
+            }
+            else if(*ptr == '"')
+               state = DQSTR;
+            else if(*ptr == '\'')
+               state = SQSTR;
+            else if((state == LWS || state == BRL) && (eol = GetEOLLength(ptr, end)) != 0) {
+               CountLine(counts, state == LWS ? TOKEN_EMPTY_LINE : TOKEN_BRACE_LINE);
+               ptr += eol;
+               state = BOL;
+               break;
+            }
+            // block comments are checked first because a Lua block comment starts like a line comment
+            else if((length = GetBlockOpenLength<syntax_t>(ptr, end, level)) != 0) {
+               ptr += length - 1;
+               state = C_COMMENT_OPEN;
+            }
+            else if(IsLineComment<syntax_t>(begin, ptr, end)) {
+               ptr += syntax_t::line_comment.length() - 1;
+               state = CPP_COMMENT;
+            }
+            else if(IsCode(*ptr))
+               state = CODE;
+
+            ptr++;
+            break;
+
+         case CODE:
+         case CODE_C_COMMENT:
+            // skip characters discarded by <*>.
+            if((ptr = syntax_t::FindCodeBreak(ptr, end)) == end)
+               break;
+
+            if((length = GetLongStringOpenLength<syntax_t>(ptr, end, quote, level)) != 0) {
+               ptr += length - 1;
+               state = state == CODE ? TQSTR : TQSTR_C_COMMENT;
+            }
+            else if(*ptr == '"')
+               state = state == CODE ? DQSTR : DQSTR_C_COMMENT;
+            else if(*ptr == '\'')
+               state = state == CODE ? SQSTR : SQSTR_C_COMMENT;
+            else if((length = GetBlockOpenLength<syntax_t>(ptr, end, level)) != 0) {
+               ptr += length - 1;
+               state = CODE_C_COMMENT_OPEN;
+            }
+            else if(IsLineComment<syntax_t>(begin, ptr, end)) {
+               ptr += syntax_t::line_comment.length() - 1;
+               state = state == CODE ? CODE_CPP_COMMENT : CODE_C_CPP_COMMENT;
+            }
+            else if((eol = GetEOLLength(ptr, end)) != 0) {
+               CountLine(counts, state == CODE ? TOKEN_CODE_EOL : TOKEN_CODE_C_COMMENT_EOL);
+               ptr += eol;
+               state = BOL;
+               break;
+            }
+
+            ptr++;
+            break;
+
+         case C_COMMENT:
+            if((length = GetLongStringOpenLength<syntax_t>(ptr, end, quote, level)) != 0) {
+               ptr += length - 1;
+               state = TQSTR_C_COMMENT;
+            }
+            else if(*ptr == '"')
+               state = DQSTR_C_COMMENT;
+            else if(*ptr == '\'')
+               state = SQSTR_C_COMMENT;
+            else if((length = GetBlockOpenLength<syntax_t>(ptr, end, level)) != 0) {
+               ptr += length - 1;
+               state = C_COMMENT_OPEN;
+            }
+            else if(IsLineComment<syntax_t>(begin, ptr, end)) {
+               ptr += syntax_t::line_comment.length() - 1;
+               state = C_CPP_COMMENT;
+            }
+            else if(IsCode(*ptr))
+               state = CODE_C_COMMENT;
+            else if((eol = GetEOLLength(ptr, end)) != 0) {
+               CountLine(counts, TOKEN_C_COMMENT_EOL);
+               ptr += eol;
+               state = BOL;
+               break;
+            }
+
+            ptr++;
+            break;
+
+         case CPP_COMMENT:
+         case CODE_CPP_COMMENT:
+         case CODE_C_CPP_COMMENT:
+         case C_CPP_COMMENT:
+            {
+               //
+               // .*{EOL} extends to the first new line character, if there
+               // is one. Otherwise, the longest match ends at the last lone
+               // carriage return and if there is none, remaining characters
+               // are discarded by <*>. and the line is counted at the end.
+               //
+               const char *eolptr = (const char*) memchr(ptr, '\n', end - ptr);
+
+               if(!eolptr) {
+                  for(eolptr = end; eolptr > ptr && eolptr[-1] != '\r'; eolptr--);
+
+                  if(eolptr == ptr) {
+                     ptr = end;
+                     break;
+                  }
+
+                  eolptr--;
+               }
+
+               CountLine(counts, state == CPP_COMMENT ? TOKEN_CPP_COMMENT_EOL :
+                                 state == CODE_CPP_COMMENT ? TOKEN_CODE_CPP_COMMENT_EOL :
+                                 state == CODE_C_CPP_COMMENT ? TOKEN_CODE_C_CPP_COMMENT_EOL : TOKEN_C_CPP_COMMENT_EOL);
+               ptr = eolptr + 1;
+               state = BOL;
+            }
+            break;
+
+         case C_COMMENT_OPEN:
+         case CODE_C_COMMENT_OPEN:
+            // these states are not reachable in profiles without block comments
+            if constexpr (!syntax_t::block_close.empty()) {
+               if((ptr = FindAny<syntax_t::block_close[0], '\r', '\n'>(ptr, end)) == end)
+                  break;
+
+               if(*ptr == syntax_t::block_close[0]) {
+                  if((length = GetBlockCloseLength<syntax_t>(ptr, end, level)) != 0) {
+                     ptr += length - 1;
+                     state = state == C_COMMENT_OPEN ? C_COMMENT : CODE_C_COMMENT;
+                  }
+                  ptr++;
+                  break;
+               }
+
+               // lines within an open comment do not change the state
+               CountLine(counts, state == C_COMMENT_OPEN ? TOKEN_C_COMMENT_EOL : TOKEN_CODE_C_COMMENT_EOL);
+               ptr += GetEOLLength(ptr, end);
+            }
+            break;
+
+         case DQSTR:
+         case DQSTR_C_COMMENT:
+         case SQSTR:
+         case SQSTR_C_COMMENT:
+            if(state == DQSTR || state == DQSTR_C_COMMENT)
+               ptr = FindAny<'\\', '"', '\r', '\n'>(ptr, end);
+            else
+               ptr = FindAny<'\\', '\'', '\r', '\n'>(ptr, end);
+
+            if(ptr == end)
+               break;
+
+            // \\{EOL} and \\. consume the next character or the entire EOL
+            if(*ptr == '\\') {
+               ptr++;
+               if(ptr < end)
+                  ptr += *ptr == '\r' || *ptr == '\n' ? GetEOLLength(ptr, end) : 1;
+               break;
+            }
+
+            if((eol = GetEOLLength(ptr, end)) != 0) {
+               CountLine(counts, state == DQSTR || state == SQSTR ? TOKEN_CODE_EOL : TOKEN_CODE_C_COMMENT_EOL);
+               ptr += eol;
+               state = BOL;
+               break;
+            }
+
+            state = state == DQSTR || state == SQSTR ? CODE : CODE_C_COMMENT;
+            ptr++;
+            break;
+
+         case TQSTR:
+         case TQSTR_C_COMMENT:
+            // Lua long strings have no escape sequences
+            if(quote == ']')
+               ptr = FindAny<']', '\r', '\n'>(ptr, end);
+            else if(quote == '"')
+               ptr = FindAny<'\\', '"', '\r', '\n'>(ptr, end);
+            else if(quote == '\'')
+               ptr = FindAny<'\\', '\'', '\r', '\n'>(ptr, end);
+            else
+               ptr = FindAny<'\\', '`', '\r', '\n'>(ptr, end);
+
+            if(ptr == end)
+               break;
+
+            if(*ptr == '\\') {
+               ptr++;
+               if(ptr < end)
+                  ptr += *ptr == '\r' || *ptr == '\n' ? GetEOLLength(ptr, end) : 1;
+               break;
+            }
+
+            // lines within a multi-line string are counted as code and do not end the string
+            if((eol = GetEOLLength(ptr, end)) != 0) {
+               CountLine(counts, state == TQSTR ? TOKEN_CODE_EOL : TOKEN_CODE_C_COMMENT_EOL);
+               ptr += eol;
+               state = TQSTR;
+               break;
+            }
+
+            // a quote or a bracket that does not close the string is a part of it
+            if((length = GetLongStringCloseLength(ptr, end, quote, level)) != 0) {
+               ptr += length - 1;
+               state = state == TQSTR ? CODE : CODE_C_COMMENT;
+            }
+
+            ptr++;
+            break;
+      }
+   }
+
+   // count the last line according to <<EOF>> rules
+   switch (state) {
+      case INITIAL:
+         break;
+      case BOL:
+      case LWS:
+         CountLine(counts, TOKEN_EMPTY_LINE);
+         break;
+      case BRL:
+         CountLine(counts, TOKEN_BRACE_LINE);
+         break;
+      case CODE:
+      case DQSTR:
+      case SQSTR:
+      case TQSTR:
+         CountLine(counts, TOKEN_CODE_EOL);
+         break;
+      case C_COMMENT:
+      case C_COMMENT_OPEN:
+         CountLine(counts, TOKEN_C_COMMENT_EOL);
+         break;
+      case CPP_COMMENT:
+         CountLine(counts, TOKEN_CPP_COMMENT_EOL);
+         break;
+      case C_CPP_COMMENT:
+         CountLine(counts, TOKEN_C_CPP_COMMENT_EOL);
+         break;
+      case CODE_C_COMMENT:
+      case CODE_C_COMMENT_OPEN:
+      case DQSTR_C_COMMENT:
+      case SQSTR_C_COMMENT:
+      case TQSTR_C_COMMENT:
+         CountLine(counts, TOKEN_CODE_C_COMMENT_EOL);
+         break;
+      case CODE_CPP_COMMENT:
+         CountLine(counts, TOKEN_CODE_CPP_COMMENT_EOL);
+         break;
+      case CODE_C_CPP_COMMENT:
+         CountLine(counts, TOKEN_CODE_C_CPP_COMMENT_EOL);
+         break;
+   }
+
+   return counts;
+}
+
+CppFlexLexer::Result SimdLexer::CountLines(void)
+{
+   switch (profile) {
+      case PROFILE_JS:
+         return CountSyntaxLines<js_syntax_t>();
+      case PROFILE_HASH:
+         return CountSyntaxLines<hash_syntax_t>();
+      case PROFILE_SQL:
+         return CountSyntaxLines<sql_syntax_t>();
+      case PROFILE_LUA:
+         return CountSyntaxLines<lua_syntax_t>();
+      default:
+         return CountSyntaxLines<c_syntax_t>();
+   }
+}
@@ -0,0 +1,95 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef SIMDLEXER_H
+#define SIMDLEXER_H
+
+#include "cpplexer.h"
+
+#include <string_view>
+
+///
+/// @brief  A hand-written line counter for C-like languages that skips
+///         runs of characters without any significance in bulk.
+///
+/// This lexer implements the same state machine as the Flex scanner in
+/// `cpplexer_scanner.l` and produces identical counts, but instead of
+/// matching one token at a time, it looks for the next character that
+/// may change the current state, such as a quote or an end of line
+/// within code, and skips everything in between with SSE2 or AVX2
+/// instructions, 32 or 64 characters at a time. Other processors use
+/// a portable scalar loop.
+///
+/// The state machine is compiled separately for each comment syntax
+/// profile, with comment delimiters and characters to look for known
+/// at compile time, and a profile is selected once per source text.
+/// Line comments are counted as C++ comments and block comments are
+/// counted as C comments in all profiles.
+///
+/// Unlike the Flex scanner, this lexer requires the entire source in
+/// memory.
+///
+class SimdLexer {
+   public:
+      ///
+      /// @brief  Comment and string syntax profiles.
+      ///
+      enum profile_t {
+         PROFILE_C,                          ///< `//` and `/* */` comments (C, C++, Java).
+         PROFILE_JS,                         ///< Same as `PROFILE_C`, plus multi-line template literals.
+         PROFILE_HASH,                       ///< `#` comments and triple-quoted strings (shell, Python, YAML).
+         PROFILE_SQL,                        ///< `--` and `/* */` comments.
+         PROFILE_LUA                         ///< `--` and `--[[ ]]` comments and `[[ ]]` strings, with levels.
+      };
+
+   private:
+      ///
+      /// @brief  Lexer states, named after Flex start conditions.
+      ///
+      enum state_t {
+         INITIAL,
+         BOL,
+         LWS,
+         BRL,
+         CODE,
+         C_COMMENT,
+         CPP_COMMENT,
+         CODE_C_COMMENT,
+         CODE_CPP_COMMENT,
+         CODE_C_CPP_COMMENT,
+         C_CPP_COMMENT,
+         C_COMMENT_OPEN,
+         CODE_C_COMMENT_OPEN,
+         DQSTR,
+         DQSTR_C_COMMENT,
+         SQSTR,
+         SQSTR_C_COMMENT,
+         TQSTR,
+         TQSTR_C_COMMENT
+      };
+
+   private:
+      std::string_view  source;              ///< Source text.
+      profile_t         profile;             ///< Comment and string syntax of the source text.
+
+   private:
+      /// Counts lines in the source text with the state machine compiled for `syntax_t`.
+      template <typename syntax_t>
+      CppFlexLexer::Result CountSyntaxLines(void) const;
+
+   public:
+      /// Constructs a lexer for the specified source text, which is not copied.
+      SimdLexer(const std::string_view& source, profile_t profile = PROFILE_C);
+
+      /// Counts lines in the source text according to the syntax profile.
+      CppFlexLexer::Result CountLines(void);
+
+      /// Returns `true` if this lexer was built with SIMD instructions, `false` otherwise.
+      static bool IsVectorized(void);
+};
+
+#endif // SIMDLEXER_H
@@ -0,0 +1,398 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "tarreader.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include <zlib.h>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <string_view>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+TarReader::TarReader(const std::string& tarpath) :
+      tarpath(tarpath),
+      input(nullptr),
+      end_of_input(false),
+      stopping(false),
+      current_pos(0),
+      remaining(0),
+      padding(0)
+{
+   if(tarpath == "-") {
+#if defined(_WIN32)
+      _setmode(_fileno(stdin), _O_BINARY);
+#endif
+      input = stdin;
+   }
+   else if((input = fopen(tarpath.c_str(), "rb")) == nullptr)
+      throw std::system_error(errno, std::system_category(), "Cannot open archive " + tarpath);
+
+   reader = std::thread(&TarReader::ReadInput, this);
+}
+
+TarReader::~TarReader(void)
+{
+   {
+      std::lock_guard<std::mutex> lock(chunks_mtx);
+      stopping = true;
+   }
+
+   chunks_cv.notify_all();
+
+   reader.join();
+
+   if(input != stdin)
+      fclose(input);
+}
+
+bool TarReader::GetFreeChunk(std::vector<char>& chunk)
+{
+   std::unique_lock<std::mutex> lock(chunks_mtx);
+
+   chunks_cv.wait(lock, [this] {return stopping || chunks.size() < max_chunks;});
+
+   if(stopping)
+      return false;
+
+   if(!free_chunks.empty()) {
+      chunk = std::move(free_chunks.back());
+      free_chunks.pop_back();
+   }
+
+   chunk.resize(chunk_size);
+
+   return true;
+}
+
+void TarReader::PutChunk(std::vector<char>&& chunk)
+{
+   {
+      std::lock_guard<std::mutex> lock(chunks_mtx);
+      chunks.push_back(std::move(chunk));
+   }
+
+   chunks_cv.notify_all();
+}
+
+void TarReader::ReadInput(void)
+{
+   try {
+      unsigned char buffer[65536];
+      std::vector<char> chunk;
+      size_t chunk_pos = 0;
+      size_t length;
+      z_stream stream = {};
+      bool first_read = true;
+      bool gzip = false;
+      bool trailer = false;
+      int status = Z_OK;
+
+      if(!GetFreeChunk(chunk))
+         return;
+
+      while(!trailer && (length = fread(buffer, 1, sizeof(buffer), input)) != 0) {
+         // a gzip stream starts with a two-byte signature, which cannot start a tar header
+         if(first_read && length >= 2 && buffer[0] == 0x1f && buffer[1] == 0x8b) {
+            // add 16 to the window size to decode gzip headers and trailers
+            if(inflateInit2(&stream, 15 + 16) != Z_OK)
+               throw std::runtime_error("Cannot initialize zlib");
+
+            gzip = true;
+         }
+
+         first_read = false;
+
+         stream.next_in = buffer;
+         stream.avail_in = (uInt) length;
+
+         while(stream.avail_in) {
+            if(chunk_pos == chunk.size()) {
+               PutChunk(std::move(chunk));
+
+               if(!GetFreeChunk(chunk)) {
+                  if(gzip)
+                     inflateEnd(&stream);
+                  return;
+               }
+
+               chunk_pos = 0;
+            }
+
+            if(!gzip) {
+               size_t copy_size = std::min((size_t) stream.avail_in, chunk.size() - chunk_pos);
+
+               memcpy(&chunk[chunk_pos], stream.next_in, copy_size);
+
+               stream.next_in += copy_size;
+               stream.avail_in -= (uInt) copy_size;
+               chunk_pos += copy_size;
+               continue;
+            }
+
+            if(status == Z_STREAM_END) {
+               // concatenated gzip members are decompressed as one stream, but anything else is ignored, like gzip does
+               if(*stream.next_in != 0x1f) {
+                  trailer = true;
+                  break;
+               }
+
+               inflateReset(&stream);
+            }
+
+            stream.next_out = (Bytef*) &chunk[chunk_pos];
+            stream.avail_out = (uInt) (chunk.size() - chunk_pos);
+
+            status = inflate(&stream, Z_NO_FLUSH);
+
+            if(status != Z_OK && status != Z_STREAM_END) {
+               inflateEnd(&stream);
+               throw std::runtime_error("Cannot decompress archive " + tarpath);
+            }
+
+            chunk_pos = chunk.size() - stream.avail_out;
+         }
+      }
+
+      if(gzip)
+         inflateEnd(&stream);
+
+      if(ferror(input))
+         throw std::runtime_error("Cannot read archive " + tarpath);
+
+      if(gzip && status != Z_STREAM_END)
+         throw std::runtime_error("Compressed archive is truncated: " + tarpath);
+
+      chunk.resize(chunk_pos);
+
+      PutChunk(std::move(chunk));
+   }
+   catch (...) {
+      std::lock_guard<std::mutex> lock(chunks_mtx);
+      error = std::current_exception();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(chunks_mtx);
+      end_of_input = true;
+   }
+
+   chunks_cv.notify_all();
+}
+
+size_t TarReader::ReadData(char *buffer, size_t size)
+{
+   size_t total = 0;
+
+   while(total < size) {
+      if(current_pos == current.size()) {
+         std::unique_lock<std::mutex> lock(chunks_mtx);
+
+         // return the consumed chunk to the reader thread
+         if(current.capacity()) {
+            free_chunks.push_back(std::move(current));
+            current = std::vector<char>();
+            chunks_cv.notify_all();
+         }
+
+         chunks_cv.wait(lock, [this] {return end_of_input || !chunks.empty();});
+
+         if(chunks.empty()) {
+            if(error)
+               std::rethrow_exception(error);
+            return total;
+         }
+
+         current = std::move(chunks.front());
+         chunks.pop_front();
+         current_pos = 0;
+
+         chunks_cv.notify_all();
+
+         continue;
+      }
+
+      size_t copy_size = std::min(size - total, current.size() - current_pos);
+
+      if(buffer)
+         memcpy(buffer + total, &current[current_pos], copy_size);
+
+      current_pos += copy_size;
+      total += copy_size;
+   }
+
+   return total;
+}
+
+void TarReader::SkipData(uint64_t size)
+{
+   while(size) {
+      size_t skip_size = (size_t) std::min(size, (uint64_t) chunk_size);
+
+      if(ReadData(nullptr, skip_size) != skip_size)
+         throw std::runtime_error("Archive is truncated: " + tarpath);
+
+      size -= skip_size;
+   }
+}
+
+void TarReader::ReadMetadata(uint64_t size, std::string& data)
+{
+   // metadata is expected to be small
+   if(size > 1024 * 1024)
+      throw std::runtime_error("Invalid extended header in archive " + tarpath);
+
+   data.resize((size_t) size);
+
+   if(ReadData(&data[0], data.length()) != data.length())
+      throw std::runtime_error("Archive is truncated: " + tarpath);
+
+   SkipData((block_size - size % block_size) % block_size);
+}
+
+uint64_t TarReader::ParseNumber(const char *field, size_t length)
+{
+   uint64_t value = 0;
+
+   // GNU tar stores large values in base 256, which is indicated by the high bit of the first byte
+   if(*field & 0x80) {
+      value = *field & 0x3f;
+
+      for(size_t index = 1; index < length; index++)
+         value = (value << 8) | (unsigned char) field[index];
+
+      return value;
+   }
+
+   for(size_t index = 0; index < length && field[index]; index++) {
+      if(field[index] >= '0' && field[index] <= '7')
+         value = (value << 3) | (uint64_t) (field[index] - '0');
+   }
+
+   return value;
+}
+
+bool TarReader::NextFile(std::string& path, uint64_t& size)
+{
+   char header[block_size];
+   std::string metadata;
+   std::string longpath;
+   uint64_t longsize = 0;
+   bool has_longsize = false;
+
+   SkipData(remaining + padding);
+
+   remaining = padding = 0;
+
+   for(;;) {
+      size_t length = ReadData(header, block_size);
+
+      // some archivers omit end-of-archive blocks
+      if(length == 0)
+         return false;
+
+      if(length != block_size)
+         throw std::runtime_error("Archive is truncated: " + tarpath);
+
+      // a zero block marks the end of the archive
+      if(std::all_of(header, header + block_size, [] (char ch) {return ch == 0;}))
+         return false;
+
+      // the checksum is computed with the checksum field filled with spaces
+      uint64_t checksum = 0;
+
+      for(size_t index = 0; index < block_size; index++)
+         checksum += (index >= 148 && index < 156) ? ' ' : (unsigned char) header[index];
+
+      if(checksum != ParseNumber(header + 148, 8))
+         throw std::runtime_error("Invalid header in archive " + tarpath);
+
+      uint64_t entry_size = ParseNumber(header + 124, 12);
+      uint64_t entry_padding = (block_size - entry_size % block_size) % block_size;
+
+      switch(header[156]) {
+         case 'L':
+            // GNU long name of the next entry
+            ReadMetadata(entry_size, longpath);
+            longpath.resize(strnlen(longpath.c_str(), longpath.length()));
+            continue;
+         case 'x':
+            // pax extended header records for the next entry, formatted as "length key=value\n"
+            ReadMetadata(entry_size, metadata);
+
+            for(size_t pos = 0; pos < metadata.length(); ) {
+               size_t space = metadata.find(' ', pos);
+               size_t record_length = strtoul(metadata.c_str() + pos, nullptr, 10);
+
+               if(space == std::string::npos || record_length <= space - pos || pos + record_length > metadata.length())
+                  throw std::runtime_error("Invalid extended header in archive " + tarpath);
+
+               std::string_view record(metadata.data() + space + 1, pos + record_length - space - 2);
+
+               if(!record.compare(0, 5, "path="))
+                  longpath = record.substr(5);
+               else if(!record.compare(0, 5, "size=")) {
+                  longsize = strtoull(std::string(record.substr(5)).c_str(), nullptr, 10);
+                  has_longsize = true;
+               }
+
+               pos += record_length;
+            }
+            continue;
+         case '0':
+         case '7':
+         case '\0':
+            break;
+         default:
+            // directories, links, devices, global headers, etc.
+            SkipData(entry_size + entry_padding);
+            longpath.clear();
+            has_longsize = false;
+            continue;
+      }
+
+      if(has_longsize) {
+         entry_size = longsize;
+         entry_padding = (block_size - entry_size % block_size) % block_size;
+      }
+
+      if(!longpath.empty())
+         path.swap(longpath);
+      else {
+         path.assign(header, strnlen(header, 100));
+
+         // ustar archives keep the leading part of long paths in the prefix field
+         if(!memcmp(header + 257, "ustar", 5) && header[345]) {
+            path.insert(0, 1, '/');
+            path.insert(0, header + 345, strnlen(header + 345, 155));
+         }
+      }
+
+      size = remaining = entry_size;
+      padding = entry_padding;
+
+      return true;
+   }
+}
+
+void TarReader::ReadFile(std::string& data)
+{
+   data.resize((size_t) remaining);
+
+   if(ReadData(&data[0], data.length()) != data.length())
+      throw std::runtime_error("Archive is truncated: " + tarpath);
+
+   remaining = 0;
+}
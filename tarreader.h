@@ -0,0 +1,109 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef TARREADER_H
+#define TARREADER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+///
+/// @brief  A single-pass reader of regular files in a tar archive, which
+///         may be compressed with gzip.
+///
+/// The archive is read and decompressed by a separate thread into a small
+/// number of fixed-size chunks, which are consumed by the thread reading
+/// files, so decompression of the next part of the archive runs while the
+/// current file is processed. Memory use is limited to the chunk queue and
+/// to the buffer of the file being read.
+///
+/// The ustar format is supported, along with GNU long names and pax
+/// extended headers for long paths and large sizes. Entries other than
+/// regular files, such as directories and links, are skipped.
+///
+/// A reader instance must be used by a single thread.
+///
+class TarReader {
+   private:
+      static constexpr size_t chunk_size = 256 * 1024;  ///< Size of each chunk of archive data.
+      static constexpr size_t max_chunks = 4;           ///< Maximum number of chunks waiting to be read.
+
+      static constexpr size_t block_size = 512;         ///< Size of tar headers and the unit of file data.
+
+   private:
+      std::string          tarpath;          ///< Archive path (`-` for the standard input).
+      FILE                 *input;           ///< Archive stream.
+
+      std::thread          reader;           ///< Reads and decompresses the archive.
+
+      std::deque<std::vector<char>> chunks;  ///< Chunks with archive data, in order.
+      std::vector<std::vector<char>> free_chunks;  ///< Chunks that may be reused by the reader thread.
+      std::mutex           chunks_mtx;       ///< Protects chunk lists and flags.
+      std::condition_variable chunks_cv;     ///< Signals queued and freed chunks.
+      bool                 end_of_input;     ///< Set when the reader thread has queued all data.
+      bool                 stopping;         ///< Set when the reader thread should stop.
+      std::exception_ptr   error;            ///< An exception thrown in the reader thread.
+
+      std::vector<char>    current;          ///< Chunk being consumed.
+      size_t               current_pos;      ///< Position of unconsumed data in `current`.
+
+      uint64_t             remaining;        ///< Unread data of the current file.
+      uint64_t             padding;          ///< Padding after the data of the current file.
+
+   private:
+      /// Reads and, if needed, decompresses the archive in the reader thread.
+      void ReadInput(void);
+
+      /// Waits for room in the chunk queue and returns a chunk to fill. Returns `false` if stopping.
+      bool GetFreeChunk(std::vector<char>& chunk);
+
+      /// Queues a filled chunk for the consuming thread.
+      void PutChunk(std::vector<char>&& chunk);
+
+      /// Reads up to `size` bytes of archive data. Returns fewer bytes only at the end of the archive.
+      size_t ReadData(char *buffer, size_t size);
+
+      /// Skips `size` bytes of archive data.
+      void SkipData(uint64_t size);
+
+      /// Reads an extended header or a long name of `size` bytes, along with its padding.
+      void ReadMetadata(uint64_t size, std::string& data);
+
+      /// Parses an octal or a base-256 numeric header field.
+      static uint64_t ParseNumber(const char *field, size_t length);
+
+   public:
+      /// Opens the archive at `tarpath`, or the standard input if `-` is used, and starts reading it.
+      TarReader(const std::string& tarpath);
+
+      TarReader(const TarReader&) = delete;
+
+      /// Stops the reader thread and closes the archive.
+      ~TarReader(void);
+
+      TarReader& operator = (const TarReader&) = delete;
+
+      ///
+      /// @brief  Moves to the next regular file in the archive and returns
+      ///         its path and size. Returns `false` at the end of the archive.
+      ///
+      /// Any unread data of the previous file is skipped.
+      ///
+      bool NextFile(std::string& path, uint64_t& size);
+
+      /// Reads the contents of the current file into `data`.
+      void ReadFile(std::string& data);
+};
+
+#endif // TARREADER_H
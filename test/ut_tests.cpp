@@ -1,8 +1,44 @@
 #include <gtest/gtest.h>
 
 #include "../cpplexer.h"
+#include "../simdlexer.h"
+#include "../dfalexer.h"
+#include "../countcache.h"
+#include "../contenthash.h"
+#include "../totals.h"
+#include "../runstats.h"
+#include "../outputwriter.h"
+#include "../gitrepo.h"
+#include "../tarreader.h"
+#include "../languages.h"
+#include "../filereader.h"
+#include "../namelist.h"
+#include "../counter.h"
+#include "../pathfilter.h"
+#include "../allocstats.h"
+#include "../workerpool.h"
+#if defined(__linux__)
+#include "../treewatcher.h"
+#endif
+
+#include <zlib.h>
 
 #include <string_view>
+#include <map>
+#include <functional>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+
+#if !defined(_WIN32)
+#include <cstdio>
+#include <sys/wait.h>
+#endif
 
 using namespace std::string_view_literals;
 
@@ -26,9 +62,20 @@ namespace test {
 //    * (e) empty lines
 //    * (b) brace lines
 //
-TEST(FlexLexerTest, TC_0L_0d_0C_0p_0c_0e_0b)
+// Tests that verify line counts are run for all line counting engines,
+// which must produce identical results.
+//
+template <typename Lexer>
+class LexerTest : public testing::Test {
+};
+
+typedef testing::Types<CppFlexLexer, SimdLexer, DfaLexer> LexerTypes;
+
+TYPED_TEST_SUITE(LexerTest, LexerTypes);
+
+TYPED_TEST(LexerTest, TC_0L_0d_0C_0p_0c_0e_0b)
 {
-   CppFlexLexer lex("");
+   TypeParam lex("");
 
    CppFlexLexer::Result counts = lex.CountLines();
 
@@ -40,9 +87,9 @@ TEST(FlexLexerTest, TC_0L_0d_0C_0p_0c_0e_0b)
    ASSERT_EQ(0, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_11L_10d_3C_0p_3c_1e_0b)
+TYPED_TEST(LexerTest, TC_11L_10d_3C_0p_3c_1e_0b)
 {
-   CppFlexLexer lex(R"==("string"
+   TypeParam lex(R"==("string"
    "indented string with a /* comment */"
 	"unterminated string
 { "string"
@@ -66,9 +113,9 @@ code /* comment */ "string"
 }
 
 
-TEST(FlexLexerTest, TC_14L_4d_4C_2p_3c_4e_4b)
+TYPED_TEST(LexerTest, TC_14L_4d_4C_2p_3c_4e_4b)
 {
-   CppFlexLexer lex(R"==(
+   TypeParam lex(R"==(
 code
 {
         {
@@ -94,9 +141,9 @@ trailing code line)==");
    ASSERT_EQ(4, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_20L_15d_0C_0p_0c_5e_0b)
+TYPED_TEST(LexerTest, TC_20L_15d_0C_0p_0c_5e_0b)
 {
-   CppFlexLexer lex(R"==("text // text"
+   TypeParam lex(R"==("text // text"
     "text // text"
 code "text // text"
 
@@ -128,9 +175,9 @@ code 'text /* text */ text'
    ASSERT_EQ(0, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_2L_0d_1C_1p_0c_1e_0b)
+TYPED_TEST(LexerTest, TC_2L_0d_1C_1p_0c_1e_0b)
 {
-   CppFlexLexer lex(R"==(
+   TypeParam lex(R"==(
 // trailing C++ comment line)==");
 
    CppFlexLexer::Result counts = lex.CountLines();
@@ -144,9 +191,9 @@ TEST(FlexLexerTest, TC_2L_0d_1C_1p_0c_1e_0b)
    ASSERT_EQ(0, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_9L_3d_5C_2p_3c_1e_1b)
+TYPED_TEST(LexerTest, TC_9L_3d_5C_2p_3c_1e_1b)
 {
-   CppFlexLexer lex(R"==(/* 
+   TypeParam lex(R"==(/* 
 	trailing brace test 
 */
 code 
@@ -167,10 +214,10 @@ if(test) {
    ASSERT_EQ(1, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_0L_0d_0C_0p_0c_5e_0b)
+TYPED_TEST(LexerTest, TC_0L_0d_0C_0p_0c_5e_0b)
 {
    // 5 empty lines (including one in the next source line)
-   CppFlexLexer lex(R"==(
+   TypeParam lex(R"==(
 
 
 
@@ -187,10 +234,10 @@ TEST(FlexLexerTest, TC_0L_0d_0C_0p_0c_5e_0b)
    ASSERT_EQ(0, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_5L_5d_0C_0p_0c_0e_0b)
+TYPED_TEST(LexerTest, TC_5L_5d_0C_0p_0c_0e_0b)
 {
    // 5 code lines
-   CppFlexLexer lex(R"==(code 1
+   TypeParam lex(R"==(code 1
 code 2
 code 3
 code 4
@@ -207,10 +254,10 @@ code 5)==");
    ASSERT_EQ(0, counts.bracecnt);
 }
 
-TEST(FlexLexerTest, TC_6L_5d_0C_0p_0c_1e_0b)
+TYPED_TEST(LexerTest, TC_6L_5d_0C_0p_0c_1e_0b)
 {
    // 5 code lines, one empty line
-   CppFlexLexer lex(R"==(code 1
+   TypeParam lex(R"==(code 1
 code 2
 code 3
 code 4
@@ -228,4 +275,1477 @@ code 5
    ASSERT_EQ(0, counts.bracecnt);
 }
 
+TEST(FlexLexerTest, InterleavedLexers)
+{
+   // two scanners are alive at the same time and are read in turns
+   CppFlexLexer lex1("code\n// C++ comment\n");
+   CppFlexLexer lex2("/* C comment */\n{\n\n");
+
+   CppFlexLexer::Result counts1 = lex1.CountLines();
+   CppFlexLexer::Result counts2 = lex2.CountLines();
+
+   ASSERT_EQ(3, counts1.linecnt);
+   ASSERT_EQ(1, counts1.codecnt);
+   ASSERT_EQ(1, counts1.cmntcnt);
+   ASSERT_EQ(1, counts1.cppcnt);
+   ASSERT_EQ(0, counts1.ccnt);
+   ASSERT_EQ(1, counts1.emptycnt);
+   ASSERT_EQ(0, counts1.bracecnt);
+
+   ASSERT_EQ(4, counts2.linecnt);
+   ASSERT_EQ(0, counts2.codecnt);
+   ASSERT_EQ(1, counts2.cmntcnt);
+   ASSERT_EQ(0, counts2.cppcnt);
+   ASSERT_EQ(1, counts2.ccnt);
+   ASSERT_EQ(2, counts2.emptycnt);
+   ASSERT_EQ(1, counts2.bracecnt);
+}
+
+TEST(FlexLexerTest, ConcurrentLexers)
+{
+   constexpr size_t thread_count = 16;
+   constexpr size_t iterations = 200;
+
+   // each thread uses a source with a different number of lines
+   std::vector<std::string> sources;
+
+   for(size_t i = 0; i < thread_count; i++) {
+      std::string source;
+
+      for(size_t k = 0; k <= i; k++)
+         source += "code /* C comment */\n// C++ comment\n{\n\n";
+
+      sources.push_back(std::move(source));
+   }
+
+   std::atomic<size_t> mismatches = 0;
+   std::vector<std::thread> threads;
+
+   for(size_t i = 0; i < thread_count; i++) {
+      threads.emplace_back([&sources, &mismatches, i]()
+      {
+         unsigned int blocks = (unsigned int) i + 1;
+
+         for(size_t n = 0; n < iterations; n++) {
+            CppFlexLexer lex(sources[i]);
+
+            CppFlexLexer::Result counts = lex.CountLines();
+
+            if(counts.linecnt != blocks * 4 + 1 ||
+                  counts.codecnt != blocks ||
+                  counts.cmntcnt != blocks * 2 ||
+                  counts.cppcnt != blocks ||
+                  counts.ccnt != blocks ||
+                  counts.emptycnt != blocks + 1 ||
+                  counts.bracecnt != blocks)
+               mismatches++;
+         }
+      });
+   }
+
+   for(std::thread& thread : threads)
+      thread.join();
+
+   ASSERT_EQ(0, mismatches.load());
+}
+
+///
+/// @brief  Returns a random source text built from characters and sequences
+///         that change lexer states, mixed with some code and whitespace.
+///
+static std::string MakeRandomSource(std::mt19937& rng, size_t max_length)
+{
+   static const char *tokens[] = {
+      "\n", "\r\n", "\r", "\n\n", " ", "\t", "  ", "\x0B", "\x0C",
+      "{", "}", "{ ", " }", "/", "*", "//", "/*", "*/", "**/",
+      "\"", "'", "\\", "\\\"", "\\'", "\\\n", "\\\r\n", "\\\r",
+      "code", "x", "/* comment */", "// comment", "\"string\"", "'c'",
+      "code code code code code code code code code code code code code code"
+   };
+
+   std::uniform_int_distribution<size_t> token_dist(0, sizeof(tokens) / sizeof(tokens[0]) - 1);
+   std::uniform_int_distribution<size_t> length_dist(0, max_length);
+
+   std::string source;
+   size_t length = length_dist(rng);
+
+   while(source.length() < length)
+      source += tokens[token_dist(rng)];
+
+   return source;
+}
+
+TEST(SimdLexerTest, RandomSourceSameAsFlex)
+{
+   std::mt19937 rng(20211015);
+
+   for(size_t i = 0; i < 5000; i++) {
+      std::string source = MakeRandomSource(rng, i < 4000 ? 64 : 4096);
+
+      CppFlexLexer flexlex(source);
+      SimdLexer simdlex(source);
+
+      CppFlexLexer::Result flex_counts = flexlex.CountLines();
+      CppFlexLexer::Result simd_counts = simdlex.CountLines();
+
+      ASSERT_EQ(flex_counts.linecnt, simd_counts.linecnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.codecnt, simd_counts.codecnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.cmntcnt, simd_counts.cmntcnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.cppcnt, simd_counts.cppcnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.ccnt, simd_counts.ccnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.emptycnt, simd_counts.emptycnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.bracecnt, simd_counts.bracecnt) << "Source: " << source;
+   }
+}
+
+TEST(DfaLexerTest, RandomSourceSameAsFlex)
+{
+   std::mt19937 rng(20211017);
+
+   for(size_t i = 0; i < 5000; i++) {
+      std::string source = MakeRandomSource(rng, i < 4000 ? 64 : 4096);
+
+      CppFlexLexer flexlex(source);
+      DfaLexer dfalex(source);
+
+      CppFlexLexer::Result flex_counts = flexlex.CountLines();
+      CppFlexLexer::Result dfa_counts = dfalex.CountLines();
+
+      ASSERT_EQ(flex_counts.linecnt, dfa_counts.linecnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.codecnt, dfa_counts.codecnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.cmntcnt, dfa_counts.cmntcnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.cppcnt, dfa_counts.cppcnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.ccnt, dfa_counts.ccnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.emptycnt, dfa_counts.emptycnt) << "Source: " << source;
+      ASSERT_EQ(flex_counts.bracecnt, dfa_counts.bracecnt) << "Source: " << source;
+   }
+}
+
+TEST(DfaLexerTest, ChunksSameAsSerial)
+{
+   std::mt19937 rng(20211018);
+   std::uniform_int_distribution<size_t> chunk_dist(2, 16);
+
+   for(size_t i = 0; i < 1000; i++) {
+      std::string source = MakeRandomSource(rng, 4096);
+      size_t chunk_count = chunk_dist(rng);
+
+      CppFlexLexer::Result serial_counts = DfaLexer(source).CountLines();
+      CppFlexLexer::Result chunk_counts = DfaLexer(source).CountLines(chunk_count);
+
+      ASSERT_EQ(serial_counts.linecnt, chunk_counts.linecnt) << "Chunks: " << chunk_count << ", source: " << source;
+      ASSERT_EQ(serial_counts.codecnt, chunk_counts.codecnt) << "Chunks: " << chunk_count << ", source: " << source;
+      ASSERT_EQ(serial_counts.cmntcnt, chunk_counts.cmntcnt) << "Chunks: " << chunk_count << ", source: " << source;
+      ASSERT_EQ(serial_counts.cppcnt, chunk_counts.cppcnt) << "Chunks: " << chunk_count << ", source: " << source;
+      ASSERT_EQ(serial_counts.ccnt, chunk_counts.ccnt) << "Chunks: " << chunk_count << ", source: " << source;
+      ASSERT_EQ(serial_counts.emptycnt, chunk_counts.emptycnt) << "Chunks: " << chunk_count << ", source: " << source;
+      ASSERT_EQ(serial_counts.bracecnt, chunk_counts.bracecnt) << "Chunks: " << chunk_count << ", source: " << source;
+   }
+}
+
+TEST(CountCacheTest, SaveAndLoad)
+{
+   std::string cachepath = testing::TempDir() + "ut_countcache.bin";
+
+   CountCache::file_info_t fileinfo1 = {1, 100, 1000};
+   CountCache::file_info_t fileinfo2 = {2, 200, 2000};
+
+   CppFlexLexer::Result counts1 = CppFlexLexer("code\n// C++ comment\n").CountLines();
+
+   {
+      CountCache cache;
+
+      ASSERT_FALSE(cache.Load(cachepath + ".missing"));
+
+      cache.Update("src/a.cpp", fileinfo1, counts1);
+      cache.Update("src/b.cpp", fileinfo2, CppFlexLexer::Result());
+
+      cache.Save(cachepath);
+   }
+
+   CountCache cache;
+   CppFlexLexer::Result counts;
+
+   ASSERT_TRUE(cache.Load(cachepath));
+
+   ASSERT_TRUE(cache.Lookup("src/a.cpp", fileinfo1, counts));
+   ASSERT_EQ(counts1.linecnt, counts.linecnt);
+   ASSERT_EQ(counts1.codecnt, counts.codecnt);
+   ASSERT_EQ(counts1.cmntcnt, counts.cmntcnt);
+   ASSERT_EQ(counts1.cppcnt, counts.cppcnt);
+   ASSERT_EQ(counts1.ccnt, counts.ccnt);
+   ASSERT_EQ(counts1.emptycnt, counts.emptycnt);
+   ASSERT_EQ(counts1.bracecnt, counts.bracecnt);
+
+   // any change in file attributes makes a cached entry stale
+   fileinfo2.mtime++;
+
+   ASSERT_FALSE(cache.Lookup("src/b.cpp", fileinfo2, counts));
+   ASSERT_FALSE(cache.Lookup("src/c.cpp", fileinfo1, counts));
+
+   // only entries used in the last run are saved
+   cache.Save(cachepath);
+
+   ASSERT_TRUE(cache.Load(cachepath));
+   ASSERT_TRUE(cache.Lookup("src/a.cpp", fileinfo1, counts));
+   ASSERT_FALSE(cache.Lookup("src/b.cpp", {2, 200, 2000}, counts));
+
+   remove(cachepath.c_str());
+}
+
+TEST(ContentHashTest, ReferenceValues)
+{
+   // values produced by the reference XXH64 implementation with a zero seed
+   ASSERT_EQ(0xEF46DB3751D8E999ull, HashContent("", 0));
+   ASSERT_EQ(0xD24EC4F1A98C6E5Bull, HashContent("a", 1));
+   ASSERT_EQ(0x44BC2CF5AD770999ull, HashContent("abc", 3));
+   ASSERT_EQ(0xFBCEA83C8A378BF1ull, HashContent("Nobody inspects the spammish repetition", 39));
+}
+
+TEST(TotalsTest, MergeTotals)
+{
+   Totals totals1, totals2;
+
+   totals1.filecnt = 1;
+   totals1.bytecnt = 0xFFFFFFFFull;
+   totals1.lines = CppFlexLexer("code\n/* C comment */\n").CountLines();
+   totals1.lines.linecnt = 0xFFFFFFFFull;
+
+   totals2.filecnt = 2;
+   totals2.dircnt = 1;
+   totals2.bytecnt = 2;
+   totals2.dupfilecnt = 1;
+   totals2.lines = CppFlexLexer("{\n\n").CountLines();
+
+   totals1 += totals2;
+
+   // totals must not wrap around at 32 bits
+   ASSERT_EQ(3, totals1.filecnt);
+   ASSERT_EQ(1, totals1.dircnt);
+   ASSERT_EQ(0x100000001ull, totals1.bytecnt);
+   ASSERT_EQ(0, totals1.cachedcnt);
+   ASSERT_EQ(1, totals1.dupfilecnt);
+   ASSERT_EQ(0x100000002ull, totals1.lines.linecnt);
+   ASSERT_EQ(1, totals1.lines.codecnt);
+   ASSERT_EQ(1, totals1.lines.cmntcnt);
+   ASSERT_EQ(0, totals1.lines.cppcnt);
+   ASSERT_EQ(1, totals1.lines.ccnt);
+   ASSERT_EQ(3, totals1.lines.emptycnt);
+   ASSERT_EQ(1, totals1.lines.bracecnt);
+}
+
+TEST(RunStatsTest, JsonReport)
+{
+   RunStats stats(GetAllocationCount);
+
+   {
+      RunStats::PhaseTimer timer(&stats, RunStats::PHASE_LEX);
+   }
+
+   // only 10 slowest files are reported, from the slowest one down
+   for(uint64_t i = 0; i < 20; i++)
+      stats.AddFile("src/f" + std::to_string(i) + ".cpp", i * 1024, i * 1000);
+
+   stats.AddFile("src/\"quoted\".cpp", 5000000, 50);
+
+   FILE *output = tmpfile();
+
+   ASSERT_NE(nullptr, output);
+
+   stats.PrintJsonReport(output);
+
+   std::string report(ftell(output), '\0');
+
+   rewind(output);
+   ASSERT_EQ(report.length(), fread(report.data(), 1, report.length(), output));
+   fclose(output);
+
+   ASSERT_NE(std::string::npos, report.find("\"files\": 21,"));
+   ASSERT_NE(std::string::npos, report.find("\"allocations\": "));
+   ASSERT_NE(std::string::npos, report.find("\"lex\": {\"calls\": 1,"));
+   ASSERT_NE(std::string::npos, report.find("\"threads\": 1,"));
+   ASSERT_NE(std::string::npos, report.find("\"read\": {\"calls\": 0,"));
+
+   ASSERT_LT(report.find("src/f19.cpp"), report.find("src/f10.cpp"));
+   ASSERT_EQ(std::string::npos, report.find("src/f9.cpp"));
+   ASSERT_EQ(std::string::npos, report.find("quoted"));
+
+   // 0 and 1 KB files, 2-3 KB files, 4-15 KB files and one file over 4 MB
+   ASSERT_NE(std::string::npos, report.find("{\"min_size\": 0, \"files\": 1}"));
+   ASSERT_NE(std::string::npos, report.find("{\"min_size\": 1024, \"files\": 3}"));
+   ASSERT_NE(std::string::npos, report.find("{\"min_size\": 4096, \"files\": 12}"));
+   ASSERT_NE(std::string::npos, report.find("{\"min_size\": 4194304, \"files\": 1}"));
+}
+
+TEST(OutputWriterTest, FormatFields)
+{
+   FILE *output = tmpfile();
+
+   ASSERT_NE(nullptr, output);
+
+   {
+      // a small buffer is written out several times
+      OutputWriter writer(output, 8);
+
+      writer.WriteUInt(0).Write(' ').WriteUInt(18446744073709551615ull).Write('|').WriteUInt(42, 5).Write('|').WriteUInt(123456, 3).Write('\n');
+      writer.WriteJsonString("a \"b\"\\c\n\x01").Write('\n');
+      writer.WriteCsvString("a,b").Write(',').WriteCsvString("c \"d\"").Write(',').WriteCsvString("plain").Write('\n');
+
+      writer.Flush();
+   }
+
+   std::string text(ftell(output), '\0');
+
+   rewind(output);
+   ASSERT_EQ(text.length(), fread(text.data(), 1, text.length(), output));
+   fclose(output);
+
+   ASSERT_EQ("0 18446744073709551615|   42|123456\n"
+             "\"a \\\"b\\\"\\\\c\\n\\u0001\"\n"
+             "\"a,b\",\"c \"\"d\"\"\",plain\n", text);
+}
+
+TEST(GitRepoTest, LooseObjects)
+{
+   std::filesystem::path gitdir = std::filesystem::path(testing::TempDir()) / "ut_gitrepo.git";
+
+   std::filesystem::remove_all(gitdir);
+   std::filesystem::create_directories(gitdir / "refs" / "heads");
+
+   // writes a file with the specified contents
+   auto write_file = [] (const std::filesystem::path& filepath, std::string_view data)
+   {
+      FILE *file = fopen(filepath.string().c_str(), "wb");
+
+      ASSERT_NE(nullptr, file);
+      ASSERT_EQ(data.length(), fwrite(data.data(), 1, data.length(), file));
+      ASSERT_EQ(0, fclose(file));
+   };
+
+   // writes a compressed loose object, which is identified by the SHA-1 hash of the header and the data
+   auto write_object = [&gitdir, &write_file] (const std::string& hex, const char *type, std::string_view data)
+   {
+      std::string object = std::string(type) + ' ' + std::to_string(data.length()) + '\0' + std::string(data);
+      std::vector<Bytef> packed(compressBound((uLong) object.length()));
+      uLongf length = (uLongf) packed.size();
+
+      ASSERT_EQ(Z_OK, compress(packed.data(), &length, (const Bytef*) object.data(), (uLong) object.length()));
+
+      std::filesystem::create_directories(gitdir / "objects" / hex.substr(0, 2));
+
+      write_file(gitdir / "objects" / hex.substr(0, 2) / hex.substr(2), std::string_view((const char*) packed.data(), length));
+   };
+
+   GitRepo::object_id_t blob_id, tree_id, commit_id;
+
+   ASSERT_TRUE(GitRepo::ParseId("5e52657a1f1732ccd3b0a6f0840af682d4b94e00", blob_id));
+   ASSERT_TRUE(GitRepo::ParseId("70ece24299d33cefe2e08c7a2a5500797e4536b4", tree_id));
+   ASSERT_TRUE(GitRepo::ParseId("76f4979912d663d4ece15266e437d8d79541a120", commit_id));
+
+   ASSERT_FALSE(GitRepo::ParseId("70ece24299d33cefe2e08c7a2a5500797e4536bx", tree_id));
+
+   std::string blob = "int a;\n// comment\n\n";
+   std::string tree = std::string("100644 a.cpp") + '\0' + std::string((const char*) blob_id.data(), blob_id.size()) +
+                      std::string("120000 b.cpp") + '\0' + std::string((const char*) blob_id.data(), blob_id.size());
+
+   write_object(GitRepo::FormatId(blob_id), "blob", blob);
+   write_object(GitRepo::FormatId(tree_id), "tree", tree);
+   write_object(GitRepo::FormatId(commit_id), "commit", "tree 70ece24299d33cefe2e08c7a2a5500797e4536b4\n"
+                                                        "author a <a@b> 0 +0000\n"
+                                                        "committer a <a@b> 0 +0000\n\n"
+                                                        "init\n");
+
+   write_file(gitdir / "HEAD", "ref: refs/heads/main\n");
+   write_file(gitdir / "refs" / "heads" / "main", "76f4979912d663d4ece15266e437d8d79541a120\n");
+
+   {
+      GitRepo repo(gitdir.string());
+      std::vector<GitRepo::tree_entry_t> entries;
+      std::string data;
+
+      ASSERT_EQ(commit_id, repo.ResolveRevision("HEAD"));
+      ASSERT_EQ(commit_id, repo.ResolveRevision("main"));
+      ASSERT_EQ(commit_id, repo.ResolveRevision("76f4979"));
+      ASSERT_EQ(commit_id, repo.ResolveRevision("main^0"));
+
+      ASSERT_THROW(repo.ResolveRevision("HEAD~1"), std::runtime_error);
+      ASSERT_THROW(repo.ResolveRevision("missing"), std::runtime_error);
+
+      ASSERT_EQ(tree_id, repo.GetTreeId(commit_id));
+      ASSERT_EQ(tree_id, repo.GetTreeId(tree_id));
+
+      repo.ReadTree(tree_id, entries);
+
+      ASSERT_EQ(2, entries.size());
+      ASSERT_EQ("a.cpp", entries[0].name);
+      ASSERT_EQ(blob_id, entries[0].id);
+      ASSERT_TRUE(entries[0].IsFile());
+      ASSERT_EQ("b.cpp", entries[1].name);
+      ASSERT_FALSE(entries[1].IsFile());
+      ASSERT_FALSE(entries[1].IsTree());
+
+      ASSERT_EQ(GitRepo::OBJ_BLOB, repo.ReadObject(blob_id, data));
+      ASSERT_EQ(blob, data);
+   }
+
+   std::filesystem::remove_all(gitdir);
+}
+
+TEST(TarReaderTest, PlainAndCompressed)
+{
+   std::string tarpath = testing::TempDir() + "ut_tarreader.tar";
+   std::string archive;
+
+   // appends a ustar header and data, padded to 512-byte blocks
+   auto add_entry = [&archive] (const std::string& name, char type, const std::string& data)
+   {
+      char header[512] = {};
+
+      memcpy(header, name.c_str(), std::min(name.length(), (size_t) 100));
+      snprintf(header + 100, 8, "%07o", 0644);
+      snprintf(header + 124, 12, "%011o", (unsigned int) data.length());
+      memcpy(header + 148, "        ", 8);
+      header[156] = type;
+      memcpy(header + 257, "ustar\0" "00", 8);
+
+      unsigned int checksum = 0;
+
+      for(char ch : header)
+         checksum += (unsigned char) ch;
+
+      snprintf(header + 148, 8, "%06o", checksum);
+
+      archive.append(header, sizeof(header));
+      archive.append(data);
+      archive.append((512 - data.length() % 512) % 512, '\0');
+   };
+
+   std::string long_name = "src/" + std::string(120, 'x') + ".cpp";
+   std::string large_file(300 * 1024, 'a');
+
+   add_entry("src/", '5', "");
+   add_entry("src/a.cpp", '0', "int a;\n");
+   add_entry("././@LongLink", 'L', long_name + '\0');
+   add_entry("src/truncated", '0', "// b\n");
+   add_entry("PaxHeaders/c.cpp", 'x', "25 path=src/pax/long.cpp\n");
+   add_entry("src/c.cpp", '0', large_file);
+   add_entry("src/link.cpp", '2', "");
+   archive.append(1024, '\0');
+
+   std::string compressed(compressBound((uLong) archive.length()) + 32, '\0');
+   z_stream stream = {};
+
+   // add 16 to the window size to write a gzip header and a trailer
+   ASSERT_EQ(Z_OK, deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY));
+
+   stream.next_in = (Bytef*) archive.data();
+   stream.avail_in = (uInt) archive.length();
+   stream.next_out = (Bytef*) &compressed[0];
+   stream.avail_out = (uInt) compressed.length();
+
+   ASSERT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+
+   compressed.resize(stream.total_out);
+
+   deflateEnd(&stream);
+
+   for(const std::string& contents : {archive, compressed}) {
+      FILE *file = fopen(tarpath.c_str(), "wb");
+
+      ASSERT_NE(nullptr, file);
+      ASSERT_EQ(contents.length(), fwrite(contents.data(), 1, contents.length(), file));
+      ASSERT_EQ(0, fclose(file));
+
+      TarReader tar(tarpath);
+      std::string path;
+      std::string data;
+      uint64_t size;
+
+      ASSERT_TRUE(tar.NextFile(path, size));
+      ASSERT_EQ("src/a.cpp", path);
+      ASSERT_EQ(7, size);
+
+      tar.ReadFile(data);
+      ASSERT_EQ("int a;\n", data);
+
+      // data of this file is skipped
+      ASSERT_TRUE(tar.NextFile(path, size));
+      ASSERT_EQ(long_name, path);
+      ASSERT_EQ(5, size);
+
+      ASSERT_TRUE(tar.NextFile(path, size));
+      ASSERT_EQ("src/pax/long.cpp", path);
+      ASSERT_EQ(large_file.length(), size);
+
+      tar.ReadFile(data);
+      ASSERT_EQ(large_file, data);
+
+      ASSERT_FALSE(tar.NextFile(path, size));
+   }
+
+   remove(tarpath.c_str());
+}
+
+TEST(SimdLexerTest, LanguageProfiles)
+{
+   // hash comments, with quotes and a brace line
+   CppFlexLexer::Result counts = SimdLexer("#!/bin/sh\nx=\"# not a comment\" # comment\n\n  # indented\n}\n", SimdLexer::PROFILE_HASH).CountLines();
+
+   ASSERT_EQ(6, counts.linecnt);
+   ASSERT_EQ(1, counts.codecnt);
+   ASSERT_EQ(3, counts.cmntcnt);
+   ASSERT_EQ(3, counts.cppcnt);
+   ASSERT_EQ(0, counts.ccnt);
+   ASSERT_EQ(2, counts.emptycnt);
+   ASSERT_EQ(1, counts.bracecnt);
+
+   // SQL line and block comments, and a C++ comment, which is code in SQL
+   counts = SimdLexer("-- comment\nSELECT 1; -- comment\n/* comment\n   comment */\nSELECT 2 // x\n", SimdLexer::PROFILE_SQL).CountLines();
+
+   ASSERT_EQ(6, counts.linecnt);
+   ASSERT_EQ(2, counts.codecnt);
+   ASSERT_EQ(4, counts.cmntcnt);
+   ASSERT_EQ(2, counts.cppcnt);
+   ASSERT_EQ(2, counts.ccnt);
+   ASSERT_EQ(1, counts.emptycnt);
+   ASSERT_EQ(0, counts.bracecnt);
+
+   // Lua long comments start like line comments
+   counts = SimdLexer("--[[ comment\ncomment ]] x = 1\n-- comment\n/* code */", SimdLexer::PROFILE_LUA).CountLines();
+
+   ASSERT_EQ(4, counts.linecnt);
+   ASSERT_EQ(2, counts.codecnt);
+   ASSERT_EQ(3, counts.cmntcnt);
+   ASSERT_EQ(1, counts.cppcnt);
+   ASSERT_EQ(2, counts.ccnt);
+   ASSERT_EQ(0, counts.emptycnt);
+   ASSERT_EQ(0, counts.bracecnt);
+
+   // Python triple-quoted strings span lines, which are counted as code
+   counts = SimdLexer("s = \"\"\"\n# not a comment\n\n\"\"\"  # comment\n# comment\nx = '''a'''\n", SimdLexer::PROFILE_HASH).CountLines();
+
+   ASSERT_EQ(7, counts.linecnt);
+   ASSERT_EQ(5, counts.codecnt);
+   ASSERT_EQ(2, counts.cmntcnt);
+   ASSERT_EQ(2, counts.cppcnt);
+   ASSERT_EQ(0, counts.ccnt);
+   ASSERT_EQ(1, counts.emptycnt);
+   ASSERT_EQ(0, counts.bracecnt);
+
+   // shell parameters with a hash are not comments
+   counts = SimdLexer("echo $# ${#name}\nx=${#a} # comment\n", SimdLexer::PROFILE_HASH).CountLines();
+
+   ASSERT_EQ(3, counts.linecnt);
+   ASSERT_EQ(2, counts.codecnt);
+   ASSERT_EQ(1, counts.cmntcnt);
+   ASSERT_EQ(1, counts.cppcnt);
+   ASSERT_EQ(0, counts.ccnt);
+   ASSERT_EQ(1, counts.emptycnt);
+   ASSERT_EQ(0, counts.bracecnt);
+
+   // Lua long comments and long strings end only with brackets of the same level
+   counts = SimdLexer("--[==[ comment\n]] comment\n]==] x = [[\n-- code\n]] .. [=[ ]] ]=]\n--[=x\n", SimdLexer::PROFILE_LUA).CountLines();
+
+   ASSERT_EQ(7, counts.linecnt);
+   ASSERT_EQ(3, counts.codecnt);
+   ASSERT_EQ(4, counts.cmntcnt);
+   ASSERT_EQ(1, counts.cppcnt);
+   ASSERT_EQ(3, counts.ccnt);
+   ASSERT_EQ(1, counts.emptycnt);
+   ASSERT_EQ(0, counts.bracecnt);
+
+   // template literals span lines, which are counted as code
+   counts = SimdLexer("/* c */ s = `line\n// line\n\n/* line`; // comment\n// comment", SimdLexer::PROFILE_JS).CountLines();
+
+   ASSERT_EQ(5, counts.linecnt);
+   ASSERT_EQ(4, counts.codecnt);
+   ASSERT_EQ(3, counts.cmntcnt);
+   ASSERT_EQ(2, counts.cppcnt);
+   ASSERT_EQ(1, counts.ccnt);
+   ASSERT_EQ(0, counts.emptycnt);
+   ASSERT_EQ(0, counts.bracecnt);
+}
+
+TEST(FileReaderTest, ReadsFilesInOrder)
+{
+   std::string dirpath = testing::TempDir() + "ut_filereader";
+   std::vector<std::string> contents = {"", "int a;\n", std::string(200 * 1024, 'b'), "// c\n"};
+
+   std::filesystem::create_directories(dirpath);
+
+   for(size_t index = 0; index < contents.size(); index++) {
+      FILE *file = fopen((dirpath + "/" + std::to_string(index)).c_str(), "wb");
+
+      ASSERT_NE(nullptr, file);
+      ASSERT_EQ(contents[index].length(), fwrite(contents[index].data(), 1, contents[index].length(), file));
+      ASSERT_EQ(0, fclose(file));
+   }
+
+   for(FileReader::backend_t backend : {FileReader::BACKEND_URING, FileReader::BACKEND_THREADS}) {
+      // two slots make files wait for free slots and reuse buffers of previous files
+      FileReader reader(backend, 2);
+      std::string path;
+      std::string data;
+
+      if(backend == FileReader::BACKEND_THREADS) {
+         ASSERT_EQ(FileReader::BACKEND_THREADS, reader.GetBackend());
+      }
+
+      for(size_t round = 0; round < 2; round++) {
+         for(size_t index = 0; index < contents.size(); index++)
+            reader.Submit(dirpath + "/" + std::to_string(index));
+
+         reader.Submit(dirpath + "/missing");
+
+         for(size_t index = 0; index < contents.size(); index++) {
+            ASSERT_EQ(0, reader.Next(path, data));
+            ASSERT_EQ(dirpath + "/" + std::to_string(index), path);
+            ASSERT_EQ(contents[index] + std::string(2, '\0'), data);
+         }
+
+         ASSERT_EQ(ENOENT, reader.Next(path, data));
+         ASSERT_EQ(dirpath + "/missing", path);
+      }
+   }
+
+   std::filesystem::remove_all(dirpath);
+}
+
+#if defined(__linux__)
+TEST(TreeWatcherTest, ReportsChanges)
+{
+   std::string dirpath = testing::TempDir() + "ut_treewatcher";
+   std::vector<TreeWatcher::event_t> events;
+
+   std::filesystem::remove_all(dirpath);
+   std::filesystem::create_directories(dirpath + "/sub");
+
+   TreeWatcher watcher;
+
+   watcher.AddDirectory(dirpath);
+   watcher.AddDirectory(dirpath + "/sub");
+
+   ASSERT_EQ(2, watcher.GetDirectoryCount());
+   ASSERT_FALSE(watcher.ReadEvents(events, 0));
+
+   FILE *file = fopen((dirpath + "/sub/a.cpp").c_str(), "w");
+
+   ASSERT_NE(nullptr, file);
+   ASSERT_EQ(0, fclose(file));
+
+   std::filesystem::remove(dirpath + "/sub/a.cpp");
+   std::filesystem::create_directory(dirpath + "/new");
+   std::filesystem::remove(dirpath + "/sub");
+
+   while(watcher.ReadEvents(events, 100));
+
+   // file creation and closing after writing are reported separately, as file changes
+   ASSERT_EQ(5, events.size());
+
+   for(size_t index = 0; index < 3; index++) {
+      ASSERT_EQ(TreeWatcher::EVENT_FILE_CHANGED, events[index].type);
+      ASSERT_EQ(dirpath + "/sub", events[index].dirpath);
+      ASSERT_EQ("a.cpp", events[index].name);
+   }
+
+   ASSERT_EQ(TreeWatcher::EVENT_DIR_ADDED, events[3].type);
+   ASSERT_EQ("new", events[3].name);
+
+   ASSERT_EQ(TreeWatcher::EVENT_DIR_REMOVED, events[4].type);
+   ASSERT_EQ(dirpath, events[4].dirpath);
+   ASSERT_EQ("sub", events[4].name);
+
+   watcher.RemoveDirectory(dirpath + "/sub");
+
+   ASSERT_EQ(1, watcher.GetDirectoryCount());
+
+   events.clear();
+
+   std::filesystem::remove_all(dirpath);
+
+   while(watcher.ReadEvents(events, 100));
+
+   ASSERT_FALSE(events.empty());
+   ASSERT_EQ(TreeWatcher::EVENT_ROOT_REMOVED, events.back().type);
+}
+#endif
+
+TEST(NameListTest, ReusesMemory)
+{
+   NameList names;
+
+   ASSERT_TRUE(names.IsEmpty());
+
+   names.Add("main.cpp");
+   names.Add(std::string_view("a_much_longer_file_name.h.bak", 25));
+   names.Add("");
+
+   ASSERT_EQ(3, names.GetCount());
+   ASSERT_STREQ("main.cpp", names[0]);
+   ASSERT_STREQ("a_much_longer_file_name.h", names[1]);
+   ASSERT_STREQ("", names[2]);
+
+   names.Clear();
+
+   ASSERT_TRUE(names.IsEmpty());
+
+   // names that fit into memory of the cleared list are added and sorted without allocating any memory
+   uint64_t allocs = GetAllocationCount();
+
+   names.Add("linecnt.cpp", 7);
+   names.Add("cpplexer.h", 3);
+   names.Add("totals.h", 7);
+
+   names.SortByKey();
+
+   ASSERT_EQ(allocs, GetAllocationCount());
+
+   // names with the same key remain in the order they were added
+   ASSERT_EQ(3, names.GetCount());
+   ASSERT_STREQ("cpplexer.h", names[0]);
+   ASSERT_STREQ("linecnt.cpp", names[1]);
+   ASSERT_STREQ("totals.h", names[2]);
+}
+
+TEST(CounterTest, BuffersFilesAndTrees)
+{
+   std::string dirpath = testing::TempDir() + "ut_counter";
+   std::string source = "int a;\n\n// b\n";
+   Counter counter;
+
+   counter.AddLanguage(*FindLanguage("cpp"));
+   counter.AddExtension("py", GetExtensionLanguage("py"));
+
+   ASSERT_TRUE(counter.IsSourceFile("a.CPP"));
+   ASSERT_FALSE(counter.IsSourceFile("a.java"));
+   ASSERT_STREQ("Python", counter.GetFileLanguage("a.py").name);
+
+   CppFlexLexer::Result counts = counter.CountBuffer(source, counter.GetFileLanguage("a.cpp"));
+
+   ASSERT_EQ(4, counts.linecnt);
+   ASSERT_EQ(1, counts.codecnt);
+   ASSERT_EQ(1, counts.cppcnt);
+   ASSERT_EQ(2, counts.emptycnt);
+
+   // the same source is counted concurrently, each thread in its own buffer
+   std::vector<std::thread> threads;
+   std::atomic<size_t> mismatches(0);
+
+   for(size_t index = 0; index < 4; index++) {
+      threads.emplace_back([&] {
+         for(size_t round = 0; round < 100; round++) {
+            if(counter.CountBuffer(source, counter.GetFileLanguage("a.cpp")).linecnt != 4)
+               mismatches++;
+         }
+      });
+   }
+
+   for(std::thread& thread : threads)
+      thread.join();
+
+   ASSERT_EQ(0, mismatches);
+
+   std::filesystem::remove_all(dirpath);
+   std::filesystem::create_directories(dirpath + "/sub/.hidden");
+
+   for(const char *filename : {"/a.cpp", "/b.txt", "/sub/c.h", "/sub/d.py", "/sub/.hidden/e.cpp"}) {
+      FILE *file = fopen((dirpath + filename).c_str(), "w");
+
+      ASSERT_NE(nullptr, file);
+      ASSERT_EQ(source.length(), fwrite(source.data(), 1, source.length(), file));
+      ASSERT_EQ(0, fclose(file));
+   }
+
+   Totals totals = counter.CountFile(dirpath + "/b.txt");
+
+   ASSERT_EQ(1, totals.filecnt);
+   ASSERT_EQ(source.length(), totals.bytecnt);
+   ASSERT_EQ(4, totals.lines.linecnt);
+
+   std::vector<std::string> files;
+
+   totals = counter.CountTree(dirpath, Counter::tree_options_t(), [&files] (const std::string&, const char *filename, const language_t& language, const Totals&)
+   {
+      files.push_back(std::string(language.name) + ":" + filename);
+   });
+
+   // directories starting with a period are not counted
+   ASSERT_EQ(2, totals.dircnt);
+   ASSERT_EQ(3, totals.filecnt);
+   ASSERT_EQ(12, totals.lines.linecnt);
+
+   std::sort(files.begin(), files.end());
+
+   ASSERT_EQ(std::vector<std::string>({"C/C++:a.cpp", "C/C++:c.h", "Python:d.py"}), files);
+
+   Counter::tree_options_t tree_options;
+
+   tree_options.recursive = false;
+
+   totals = counter.CountTree(dirpath, tree_options, nullptr);
+
+   ASSERT_EQ(1, totals.dircnt);
+   ASSERT_EQ(1, totals.filecnt);
+
+   std::filesystem::remove_all(dirpath);
+}
+
+TEST(CounterTest, TreeJobsAndHooks)
+{
+   std::string dirpath = testing::TempDir() + "ut_counter_jobs";
+   Counter counter;
+
+   counter.AddLanguage(*FindLanguage("cpp"));
+
+   std::filesystem::remove_all(dirpath);
+
+   // enough directories and files for worker threads to complete them out of order
+   for(size_t index = 0; index < 8; index++) {
+      std::string subdir = dirpath + "/d" + std::to_string(index);
+
+      std::filesystem::create_directories(subdir + "/s");
+
+      for(const char *filename : {"/f1.cpp", "/f2.cpp", "/s/g1.cpp"}) {
+         FILE *file = fopen((subdir + filename).c_str(), "w");
+
+         ASSERT_NE(nullptr, file);
+         ASSERT_NE(EOF, fputs("int a;\n// b\n", file));
+         ASSERT_EQ(0, fclose(file));
+      }
+   }
+
+   // counts the tree or the file list with the options and returns reported paths
+   auto count = [&counter, &dirpath] (const Counter::tree_options_t& tree_options, const std::vector<std::string> *paths, Totals& totals)
+   {
+      std::vector<std::string> files;
+
+      auto callback = [&files] (const std::string& filedir, const char *filename, const language_t&, const Totals&)
+      {
+         files.push_back(filedir + "/" + filename);
+      };
+
+      totals = paths ? counter.CountFileList(dirpath, *paths, tree_options, callback) : counter.CountTree(dirpath, tree_options, callback);
+
+      return files;
+   };
+
+   Counter::tree_options_t tree_options;
+   Totals totals1, totals4;
+
+   std::vector<std::string> files1 = count(tree_options, nullptr, totals1);
+
+   tree_options.jobs = 4;
+
+   std::vector<std::string> files4 = count(tree_options, nullptr, totals4);
+
+   ASSERT_EQ(24, files1.size());
+   ASSERT_EQ(files1, files4);
+   ASSERT_EQ(17, totals4.dircnt);
+   ASSERT_EQ(24, totals4.filecnt);
+   ASSERT_EQ(72, totals4.lines.linecnt);
+
+   // the same files, listed relative to the tree, are reported in the list order
+   std::vector<std::string> paths;
+
+   for(const std::string& filepath : files1)
+      paths.push_back(filepath.substr(dirpath.length() + 1));
+
+   std::reverse(paths.begin(), paths.end());
+
+   std::vector<std::string> listed = count(tree_options, &paths, totals4);
+
+   std::reverse(listed.begin(), listed.end());
+
+   ASSERT_EQ(files1, listed);
+   ASSERT_EQ(16, totals4.dircnt);
+   ASSERT_EQ(24, totals4.filecnt);
+
+   // f1.cpp is found by the lookup hook without being read and other files are counted by the buffer hook
+   std::atomic<size_t> prefetched(0), buffers(0);
+
+   tree_options.lookup = [] (const std::string& filepath, const language_t&, const std::function<Totals(void)>& read)
+   {
+      if(filepath.compare(filepath.length() - 6, 6, "f1.cpp"))
+         return read();
+
+      Totals totals;
+
+      totals.filecnt = 1;
+      totals.cachedcnt = 1;
+
+      return totals;
+   };
+
+   tree_options.count_buffer = [&buffers] (char *, size_t length, const language_t&)
+   {
+      Totals totals;
+
+      totals.filecnt = 1;
+      totals.bytecnt = length;
+      buffers++;
+
+      return totals;
+   };
+
+   tree_options.prefetch = [&prefetched] (const std::string&, const NameList& files)
+   {
+      prefetched += files.GetCount();
+   };
+
+   for(unsigned int jobs : {1u, 4u}) {
+      prefetched = buffers = 0;
+      tree_options.jobs = jobs;
+
+      ASSERT_EQ(files1, count(tree_options, nullptr, totals4));
+      ASSERT_EQ(24, totals4.filecnt);
+      ASSERT_EQ(8, totals4.cachedcnt);
+      ASSERT_EQ(0, totals4.lines.linecnt);
+      ASSERT_EQ(16, buffers);
+      ASSERT_EQ(24, prefetched);
+   }
+
+   // errors are thrown after all preceding files are reported
+   std::filesystem::create_symlink("/nonexistent/ut_counter_jobs", dirpath + "/d3/broken");
+
+   for(unsigned int jobs : {1u, 4u}) {
+      std::vector<std::string> files;
+
+      tree_options = Counter::tree_options_t();
+      tree_options.jobs = jobs;
+
+      ASSERT_THROW(counter.CountTree(dirpath, tree_options, [&files] (const std::string& filedir, const char *filename, const language_t&, const Totals&)
+      {
+         files.push_back(filedir + "/" + filename);
+      }), std::system_error);
+
+      // directories are enumerated in the inode order, so files of d3 are found in the reported list
+      size_t reported = std::find_if(files1.begin(), files1.end(), [&dirpath] (const std::string& filepath) {return !filepath.compare(0, dirpath.length() + 4, dirpath + "/d3/");}) - files1.begin();
+
+      ASSERT_EQ(std::vector<std::string>(files1.begin(), files1.begin() + reported), files);
+   }
+
+   std::filesystem::remove_all(dirpath);
+}
+
+TEST(CounterTest, ExtensionLookup)
+{
+   Counter counter;
+
+   ASSERT_FALSE(counter.IsSourceFile("a.cpp"));
+
+   // enough extensions to grow the lookup table a few times
+   for(const language_t& language : GetLanguages())
+      counter.AddLanguage(language);
+
+   counter.AddExtension("Inc", GetExtensionLanguage("inc"));
+   counter.AddExtension("verylongextension", GetExtensionLanguage("verylongextension"));
+
+   ASSERT_STREQ("C/C++", counter.GetFileLanguage("a.CPP").name);
+   ASSERT_STREQ("C/C++", counter.GetFileLanguage("dir.h/a.cpp").name);
+   ASSERT_STREQ("Python", counter.GetFileLanguage("a.b.Py").name);
+   ASSERT_EQ(&GetLanguages().back(), &counter.GetFileLanguage("scanner.INC"));
+   ASSERT_TRUE(counter.IsSourceFile("a.VeryLongExtension"));
+
+   ASSERT_FALSE(counter.IsSourceFile("Makefile"));
+   ASSERT_FALSE(counter.IsSourceFile("a."));
+   ASSERT_FALSE(counter.IsSourceFile("a.cp"));
+   ASSERT_FALSE(counter.IsSourceFile("a.cppx"));
+   ASSERT_FALSE(counter.IsSourceFile("a.verylongextensio"));
+   ASSERT_FALSE(counter.IsSourceFile("a.c\xC3\x80"));
+}
+
+TEST(PathFilterTest, MatchPatterns)
+{
+   PathFilter filter;
+   PathFilter::dir_state_t state;
+
+   ASSERT_TRUE(filter.IsEmpty());
+   ASSERT_FALSE(filter.IsPathExcluded("src/a.cpp", false));
+
+   filter.AddPattern("build/", true);
+   filter.AddPattern("*.min.js", true);
+   filter.AddPattern("/third_party", true);
+   filter.AddPattern("docs/**/gen", true);
+   filter.AddPattern("test/data/**", true);
+   filter.AddPattern("f[0-3].c", true);
+   filter.AddPattern("test/data/keep", false);
+
+   ASSERT_FALSE(filter.IsEmpty());
+
+   // names without separators match at any depth, directory patterns match only directories
+   ASSERT_TRUE(filter.IsPathExcluded("build", true));
+   ASSERT_TRUE(filter.IsPathExcluded("src/build", true));
+   ASSERT_FALSE(filter.IsPathExcluded("src/build", false));
+   ASSERT_TRUE(filter.IsPathExcluded("src/build/a.cpp", false));
+   ASSERT_TRUE(filter.IsPathExcluded("web/app.min.js", false));
+   ASSERT_FALSE(filter.IsPathExcluded("web/app.js", false));
+
+   // anchored patterns match only from the root
+   ASSERT_TRUE(filter.IsPathExcluded("third_party", true));
+   ASSERT_FALSE(filter.IsPathExcluded("src/third_party", true));
+
+   // `**` matches any number of directories, including none
+   ASSERT_TRUE(filter.IsPathExcluded("docs/gen", true));
+   ASSERT_TRUE(filter.IsPathExcluded("docs/a/b/gen", true));
+   ASSERT_FALSE(filter.IsPathExcluded("gen", true));
+
+   // a trailing `**` matches contents, but not the directory itself, which allows including some contents
+   ASSERT_FALSE(filter.IsPathExcluded("test/data", true));
+   ASSERT_TRUE(filter.IsPathExcluded("test/data/a.cpp", false));
+   ASSERT_FALSE(filter.IsPathExcluded("test/data/keep", true));
+
+   // character ranges
+   ASSERT_TRUE(filter.IsPathExcluded("f2.c", false));
+   ASSERT_FALSE(filter.IsPathExcluded("f4.c", false));
+
+   // directory states are matched one component at a time
+   filter.EnterDirectory("docs/a", state);
+
+   ASSERT_TRUE(filter.IsExcluded(state, "gen", true));
+   ASSERT_FALSE(filter.IsExcluded(state, "src", true));
+
+   std::string filepath = testing::TempDir() + "ut_gitignore";
+   FILE *file = fopen(filepath.c_str(), "wb");
+
+   ASSERT_NE(nullptr, file);
+   ASSERT_NE(EOF, fputs("# generated files\r\n\r\n*.inc  \r\n!keep.inc\r\nout/\r\n", file));
+   ASSERT_EQ(0, fclose(file));
+
+   PathFilter ignore;
+
+   ASSERT_TRUE(ignore.ReadIgnoreFile(filepath));
+   ASSERT_FALSE(ignore.ReadIgnoreFile(filepath + ".missing"));
+
+   ASSERT_TRUE(ignore.IsPathExcluded("src/scanner.inc", false));
+   ASSERT_FALSE(ignore.IsPathExcluded("src/keep.inc", false));
+   ASSERT_TRUE(ignore.IsPathExcluded("out", true));
+   ASSERT_FALSE(ignore.IsPathExcluded("# generated files", false));
+
+   remove(filepath.c_str());
+}
+
+TEST(LanguagesTest, ExtensionLookup)
+{
+   const std::vector<language_t>& languages = GetLanguages();
+
+   for(size_t index = 0; index < languages.size(); index++)
+      ASSERT_EQ(index, languages[index].id);
+
+   ASSERT_STREQ("Python", GetExtensionLanguage("PY").name);
+   ASSERT_EQ(SimdLexer::PROFILE_HASH, GetExtensionLanguage("yml").profile);
+   ASSERT_EQ(SimdLexer::PROFILE_JS, GetExtensionLanguage("ts").profile);
+   ASSERT_STREQ("C/C++", GetExtensionLanguage("h").name);
+
+   // unregistered extensions are counted as C-like sources
+   ASSERT_EQ(&languages.back(), &GetExtensionLanguage("inc"));
+   ASSERT_EQ(SimdLexer::PROFILE_C, languages.back().profile);
+
+   ASSERT_EQ(&GetExtensionLanguage("lua"), FindLanguage("lua"));
+   ASSERT_EQ(nullptr, FindLanguage("Other"));
+}
+
+
+TEST(WorkerPoolTest, DiscardsQueuedJobs)
+{
+   std::atomic<bool> release = false;
+   std::atomic<size_t> started = 0;
+   std::atomic<size_t> finished = 0;
+
+   auto workers = std::make_unique<WorkerPool>(1);
+   WorkerPool *pool = workers.get();
+
+   workers->Submit([&, pool] (size_t) {
+      started++;
+
+      while(!release)
+         std::this_thread::yield();
+
+      // a running job may still submit jobs while the pool is being destroyed
+      pool->Submit([&] (size_t) {finished++;});
+
+      finished++;
+   });
+
+   // jobs are popped in the reverse order, so queue more only after the first one started
+   while(!started)
+      std::this_thread::yield();
+
+   for(size_t index = 0; index < 10; index++)
+      workers->Submit([&] (size_t) {finished++;});
+
+   // the blocked job is released after the destructor marked queued jobs to be discarded
+   std::thread releaser([&release] ()
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      release = true;
+   });
+
+   workers.reset();
+   releaser.join();
+
+   ASSERT_EQ(1, finished);
+}
+
+#if !defined(_WIN32)
+///
+/// @brief  Runs a shell command, captures its standard output in `output`
+///         and returns its exit status, or `-1` if it didn't exit normally.
+///
+static int RunCommand(const std::string& command, std::string& output)
+{
+   FILE *pipe = popen(command.c_str(), "r");
+   char buffer[256];
+   size_t length;
+
+   if(!pipe)
+      return -1;
+
+   while((length = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+      output.append(buffer, length);
+
+   int status = pclose(pipe);
+
+   return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+///
+/// @brief  Runs the linecnt executable in the `LINECNT` environment
+///         variable with `args`, captures its standard output, along
+///         with its standard error if `errors` is `true`, in `output`
+///         and returns its exit status, or `-1` if it didn't exit
+///         normally.
+///
+static int RunLineCount(const std::string& args, std::string& output, bool errors = true)
+{
+   return RunCommand(std::string(getenv("LINECNT")) + " " + args + (errors ? " 2>&1" : " 2>/dev/null"), output);
+}
+
+TEST(LineCountTest, ParallelTreeErrors)
+{
+   if(!getenv("LINECNT") || !*getenv("LINECNT"))
+      GTEST_SKIP() << "LINECNT must contain the path of the linecnt executable";
+
+   std::string dirpath = testing::TempDir() + "ut_parallel_tree";
+
+   std::filesystem::remove_all(dirpath);
+
+   // enough directories for other tasks to be running or queued when the error is found
+   for(size_t index = 0; index < 40; index++) {
+      std::string subdir = dirpath + "/d" + std::to_string(index);
+
+      std::filesystem::create_directories(subdir + "/s");
+
+      for(const char *filename : {"/f1.cpp", "/f2.cpp", "/s/g1.cpp", "/s/g2.cpp"}) {
+         FILE *file = fopen((subdir + filename).c_str(), "w");
+
+         ASSERT_NE(nullptr, file);
+         ASSERT_NE(EOF, fputs("int a;\n", file));
+         ASSERT_EQ(0, fclose(file));
+      }
+   }
+
+   // a dangling symbolic link cannot be identified as a file or a directory
+   std::filesystem::create_symlink("/nonexistent/ut_parallel_tree", dirpath + "/d0/broken");
+
+   // errors are reported while other tasks are in flight, so each walk is repeated
+   for(const char *jobs : {"1", "4", "8"}) {
+      for(size_t run = 0; run < 5; run++) {
+         std::string output;
+
+         ASSERT_EQ(1, RunLineCount(std::string("-s -c -J ") + jobs + " -d " + dirpath, output)) << output;
+         ASSERT_NE(std::string::npos, output.find("Cannot stat directory")) << output;
+      }
+   }
+
+   std::filesystem::remove_all(dirpath);
+}
+
+TEST(LineCountTest, ParallelFileListErrors)
+{
+   if(!getenv("LINECNT") || !*getenv("LINECNT"))
+      GTEST_SKIP() << "LINECNT must contain the path of the linecnt executable";
+
+   std::string dirpath = testing::TempDir() + "ut_parallel_list";
+   std::string listpath = dirpath + "/files.txt";
+   std::string list;
+
+   std::filesystem::remove_all(dirpath);
+
+   // files in each directory are parsed by one task, so use enough directories to have tasks in flight
+   for(size_t index = 0; index < 40; index++) {
+      std::string subdir = dirpath + "/d" + std::to_string(index);
+
+      std::filesystem::create_directories(subdir);
+
+      for(const char *filename : {"/f1.cpp", "/f2.cpp", "/f3.cpp"}) {
+         FILE *file = fopen((subdir + filename).c_str(), "w");
+
+         ASSERT_NE(nullptr, file);
+         ASSERT_NE(EOF, fputs("int a;\n", file));
+         ASSERT_EQ(0, fclose(file));
+
+         list += subdir + filename + '\n';
+      }
+
+      if(index == 1)
+         list += subdir + "/missing.cpp\n";
+   }
+
+   FILE *file = fopen(listpath.c_str(), "w");
+
+   ASSERT_NE(nullptr, file);
+   ASSERT_NE(EOF, fputs(list.c_str(), file));
+   ASSERT_EQ(0, fclose(file));
+
+   for(const char *jobs : {"1", "4", "8"}) {
+      for(size_t run = 0; run < 10; run++) {
+         std::string output;
+
+         ASSERT_EQ(1, RunLineCount(std::string("-s -c -J ") + jobs + " --files-from " + listpath, output)) << output;
+         ASSERT_NE(std::string::npos, output.find("missing.cpp")) << output;
+      }
+   }
+
+   std::filesystem::remove_all(dirpath);
+}
+///
+/// @brief  Returns `true` if `line` contains a single JSON object, with
+///         balanced braces and brackets outside of strings.
+///
+static bool IsJsonObjectLine(const std::string& line)
+{
+   size_t depth = 0;
+   bool instring = false;
+
+   if(line.empty() || line.front() != '{' || line.back() != '}')
+      return false;
+
+   for(size_t index = 0; index < line.length(); index++) {
+      char c = line[index];
+
+      if(instring) {
+         if(c == '\\')
+            index++;
+         else if(c == '"')
+            instring = false;
+      }
+      else if(c == '"')
+         instring = true;
+      else if(c == '{' || c == '[')
+         depth++;
+      else if(c == '}' || c == ']') {
+         // the outermost object must end only at the end of the line
+         if(!depth-- || (!depth && index != line.length() - 1))
+            return false;
+      }
+   }
+
+   return !depth && !instring;
+}
+
+TEST(LineCountTest, JsonLinesStats)
+{
+   if(!getenv("LINECNT") || !*getenv("LINECNT"))
+      GTEST_SKIP() << "LINECNT must contain the path of the linecnt executable";
+
+   std::string dirpath = testing::TempDir() + "ut_jsonl_stats";
+
+   std::filesystem::remove_all(dirpath);
+   std::filesystem::create_directories(dirpath + "/s");
+
+   for(const char *filename : {"/f1.cpp", "/f2.h", "/s/g1.cpp"}) {
+      FILE *file = fopen((dirpath + filename).c_str(), "w");
+
+      ASSERT_NE(nullptr, file);
+      ASSERT_NE(EOF, fputs("// \"quoted\"\nint a;\n", file));
+      ASSERT_EQ(0, fclose(file));
+   }
+
+   std::string output;
+
+   ASSERT_EQ(0, RunLineCount("-s -c --format=jsonl --stats=- -d " + dirpath, output, false)) << output;
+
+   std::vector<std::string> lines;
+   size_t start = 0, end;
+
+   while((end = output.find('\n', start)) != std::string::npos) {
+      lines.push_back(output.substr(start, end - start));
+      start = end + 1;
+   }
+
+   // nothing may follow the last line feed
+   ASSERT_EQ(output.length(), start) << output;
+
+   // 3 files, 1 language, totals and statistics
+   ASSERT_EQ(6, lines.size()) << output;
+
+   for(const std::string& line : lines) {
+      EXPECT_TRUE(IsJsonObjectLine(line)) << line;
+      EXPECT_EQ(0, line.compare(0, 9, "{\"type\":\"")) << line;
+   }
+
+   EXPECT_EQ(0, lines[4].compare(0, 16, "{\"type\":\"totals\"")) << lines[4];
+   EXPECT_EQ(0, lines[5].compare(0, 15, "{\"type\":\"stats\"")) << lines[5];
+   EXPECT_NE(std::string::npos, lines[5].find("\"files\":3,")) << lines[5];
+
+   // statistics cannot be mixed with CSV records
+   output.clear();
+
+   ASSERT_EQ(1, RunLineCount("-s -c --format=csv --stats=- -d " + dirpath, output)) << output;
+
+   std::filesystem::remove_all(dirpath);
+}
+TEST(GitRepoTest, PackedObjects)
+{
+   std::string output;
+
+   if(RunCommand("git --version 2>&1", output) != 0)
+      GTEST_SKIP() << "Git must be installed to create pack files";
+
+   std::string workdir = testing::TempDir() + "ut_gitpack";
+   std::string git = "git -C " + workdir + " -c user.name=a -c user.email=a@b -c commit.gpgsign=false ";
+
+   std::filesystem::remove_all(workdir);
+   std::filesystem::create_directories(workdir + "/src");
+
+   // writes a file with the specified contents
+   auto write_file = [&workdir] (const std::string& filename, const std::string& data)
+   {
+      FILE *file = fopen((workdir + "/" + filename).c_str(), "wb");
+
+      ASSERT_NE(nullptr, file);
+      ASSERT_EQ(data.length(), fwrite(data.data(), 1, data.length(), file));
+      ASSERT_EQ(0, fclose(file));
+   };
+
+   std::vector<std::string> lines;
+
+   for(size_t index = 0; index < 300; index++)
+      lines.push_back("int value" + std::to_string(index) + " = " + std::to_string(index) + "; // line " + std::to_string(index) + "\n");
+
+   // small changes in large files in each commit make Git store most blobs as chains of deltas
+   for(size_t commit = 0; commit < 5; commit++) {
+      std::string header = "/* header */\n";
+
+      lines[commit * 50] = "int changed" + std::to_string(commit) + ";\n";
+
+      for(size_t index = 0; index <= commit; index++)
+         header += "// revision " + std::to_string(index) + "\n";
+
+      std::string source;
+
+      for(const std::string& line : lines)
+         source += line;
+
+      write_file("src/a.cpp", source);
+      write_file("b.h", header + source);
+
+      output.clear();
+
+      ASSERT_EQ(0, RunCommand((commit ? "" : git + "init -q && ") + git + "add -A && " + git + "commit -q -m " + std::to_string(commit) + " 2>&1", output)) << output;
+   }
+
+   // collects contents of all blobs in the last 3 commits and, if linecnt is available, its output for each commit
+   auto read_revisions = [&workdir] (std::map<std::string, std::string>& blobs, std::vector<std::string>& counts)
+   {
+      GitRepo repo(workdir);
+
+      std::function<void(const GitRepo::object_id_t&)> read_tree = [&repo, &blobs, &read_tree] (const GitRepo::object_id_t& tree_id)
+      {
+         std::vector<GitRepo::tree_entry_t> entries;
+
+         repo.ReadTree(tree_id, entries);
+
+         for(const GitRepo::tree_entry_t& entry : entries) {
+            if(entry.IsTree())
+               read_tree(entry.id);
+            else {
+               std::string data;
+
+               ASSERT_EQ(GitRepo::OBJ_BLOB, repo.ReadObject(entry.id, data));
+
+               blobs[GitRepo::FormatId(entry.id)] = data;
+            }
+         }
+      };
+
+      for(const char *revision : {"HEAD", "HEAD~1", "HEAD~2"}) {
+         read_tree(repo.GetTreeId(repo.ResolveRevision(revision)));
+
+         if(getenv("LINECNT") && *getenv("LINECNT")) {
+            std::string output;
+
+            ASSERT_EQ(0, RunLineCount(std::string("-s -c --format=jsonl --git-rev ") + revision + " -d " + workdir, output)) << output;
+
+            counts.push_back(output);
+         }
+      }
+   };
+
+   std::map<std::string, std::string> loose_blobs;
+   std::vector<std::string> loose_counts;
+
+   read_revisions(loose_blobs, loose_counts);
+
+   ASSERT_EQ(6, loose_blobs.size());
+
+   // compares objects in a pack with loose objects after checking that the pack has delta chains
+   auto check_pack = [&] (const char *delta_type)
+   {
+      std::map<std::string, std::string> packed_blobs;
+      std::vector<std::string> packed_counts;
+
+      output.clear();
+
+      ASSERT_EQ(0, RunCommand(git + "verify-pack -v " + workdir + "/.git/objects/pack/*.idx 2>&1", output)) << output;
+      ASSERT_NE(std::string::npos, output.find("chain length = 2")) << output;
+
+      read_revisions(packed_blobs, packed_counts);
+
+      ASSERT_TRUE(loose_blobs == packed_blobs) << delta_type;
+      ASSERT_TRUE(loose_counts == packed_counts) << delta_type;
+   };
+
+   // OBJ_OFS_DELTA objects and 31-bit offsets
+   output.clear();
+
+   ASSERT_EQ(0, RunCommand(git + "repack -adfq 2>&1", output)) << output;
+   ASSERT_FALSE(std::filesystem::exists(workdir + "/.git/objects/" + loose_blobs.begin()->first.substr(0, 2)));
+
+   check_pack("OBJ_OFS_DELTA");
+
+   // an index with 64-bit offsets for all objects after the first one, which follows the 12-byte pack header
+   std::string packpath;
+
+   for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(workdir + "/.git/objects/pack")) {
+      if(entry.path().extension() == ".pack")
+         packpath = entry.path().string();
+   }
+
+   std::string indexpath = packpath.substr(0, packpath.length() - 5) + ".idx";
+
+   uintmax_t index_size = std::filesystem::file_size(indexpath);
+
+   output.clear();
+
+   ASSERT_EQ(0, RunCommand(git + "index-pack --index-version=2,12 -o " + workdir + "/large.idx " + packpath + " 2>&1", output)) << output;
+
+   std::filesystem::remove(indexpath);
+   std::filesystem::rename(workdir + "/large.idx", indexpath);
+
+   ASSERT_LT(index_size, std::filesystem::file_size(indexpath));
+
+   check_pack("64-bit offsets");
+
+   // OBJ_REF_DELTA objects
+   output.clear();
+
+   ASSERT_EQ(0, RunCommand(git + "-c repack.useDeltaBaseOffset=false repack -adfq 2>&1", output)) << output;
+
+   check_pack("OBJ_REF_DELTA");
+
+   std::filesystem::remove_all(workdir);
+}
+#endif
+
 }
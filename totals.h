@@ -0,0 +1,63 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef TOTALS_H
+#define TOTALS_H
+
+#include "cpplexer.h"
+
+#include <cstdint>
+
+///
+/// @brief  Aggregated line, file and byte counts.
+///
+/// Totals are collected for individual files, directories or entire
+/// runs and are combined with `operator +=`, so each thread may keep
+/// its own totals and merge them with others without locking. Totals of
+/// files that change are updated with `operator -=` in the watch mode.
+///
+struct Totals {
+   uint64_t             filecnt = 0;         ///< Count of processed files.
+   uint64_t             dircnt = 0;          ///< Count of processed directories.
+   uint64_t             bytecnt = 0;         ///< Size of processed files, in bytes.
+   uint64_t             cachedcnt = 0;       ///< Count of files with line counts from the count cache.
+   uint64_t             dupfilecnt = 0;      ///< Count of files with duplicate contents.
+   uint64_t             dupbytecnt = 0;      ///< Size of files with duplicate contents, in bytes.
+
+   CppFlexLexer::Result lines;               ///< Line counts.
+
+   /// Adds counts in `other` to these totals.
+   Totals& operator += (const Totals& other)
+   {
+      filecnt += other.filecnt;
+      dircnt += other.dircnt;
+      bytecnt += other.bytecnt;
+      cachedcnt += other.cachedcnt;
+      dupfilecnt += other.dupfilecnt;
+      dupbytecnt += other.dupbytecnt;
+
+      lines += other.lines;
+
+      return *this;
+   }
+
+   /// Subtracts counts in `other`, which must have been added before, from these totals.
+   Totals& operator -= (const Totals& other)
+   {
+      filecnt -= other.filecnt;
+      dircnt -= other.dircnt;
+      bytecnt -= other.bytecnt;
+      cachedcnt -= other.cachedcnt;
+      dupfilecnt -= other.dupfilecnt;
+      dupbytecnt -= other.dupbytecnt;
+      lines -= other.lines;
+
+      return *this;
+   }
+};
+
+#endif // TOTALS_H
@@ -0,0 +1,151 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#if defined(__linux__)
+#include "treewatcher.h"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+//
+// File events are requested only for entries of watched directories. Self
+// events are used only to detect that the root directory went away, which
+// the parent of any other directory reports as a directory entry change.
+//
+static const uint32_t WatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// fits many events with long names, so busy trees are drained in a few reads
+static const size_t EventBufferSize = 65536;
+
+TreeWatcher::TreeWatcher(void) :
+      fd(inotify_init1(IN_CLOEXEC)),
+      root_wd(-1),
+      buffer(EventBufferSize)
+{
+   if(fd == -1)
+      throw std::system_error(errno, std::system_category(), "Cannot create an inotify instance");
+}
+
+TreeWatcher::~TreeWatcher(void)
+{
+   close(fd);
+}
+
+void TreeWatcher::AddDirectory(const std::string& dirpath)
+{
+   int wd = inotify_add_watch(fd, dirpath.c_str(), WatchMask);
+
+   if(wd == -1)
+      throw std::system_error(errno, std::system_category(), "Cannot watch directory " + dirpath);
+
+   // the same directory reached via a symbolic link has the same watch, which is kept for the first path
+   if(!paths.emplace(wd, dirpath).second)
+      return;
+
+   watches.emplace(dirpath, wd);
+
+   if(root_wd == -1)
+      root_wd = wd;
+}
+
+void TreeWatcher::EraseWatch(int wd, const std::string& dirpath)
+{
+   paths.erase(wd);
+   watches.erase(dirpath);
+}
+
+void TreeWatcher::RemoveDirectory(const std::string& dirpath)
+{
+   std::string prefix = dirpath + '/';
+
+   auto iter = watches.find(dirpath);
+
+   if(iter != watches.end()) {
+      inotify_rm_watch(fd, iter->second);
+      paths.erase(iter->second);
+      watches.erase(iter);
+   }
+
+   // all paths under the directory follow the path with the separator appended
+   iter = watches.lower_bound(prefix);
+
+   while(iter != watches.end() && !iter->first.compare(0, prefix.length(), prefix)) {
+      // watches of deleted directories are already removed, which is not an error worth checking
+      inotify_rm_watch(fd, iter->second);
+      paths.erase(iter->second);
+      iter = watches.erase(iter);
+   }
+}
+
+bool TreeWatcher::ReadEvents(std::vector<event_t>& events, int timeout)
+{
+   struct pollfd pfd = {fd, POLLIN, 0};
+   int ready;
+
+   while((ready = poll(&pfd, 1, timeout)) == -1) {
+      if(errno != EINTR)
+         throw std::system_error(errno, std::system_category(), "Cannot wait for inotify events");
+   }
+
+   if(!ready)
+      return false;
+
+   ssize_t length;
+
+   while((length = read(fd, buffer.data(), buffer.size())) == -1) {
+      if(errno != EINTR)
+         throw std::system_error(errno, std::system_category(), "Cannot read inotify events");
+   }
+
+   for(const char *ptr = buffer.data(); ptr < buffer.data() + length; ) {
+      const inotify_event *event = reinterpret_cast<const inotify_event*>(ptr);
+
+      ptr += sizeof(inotify_event) + event->len;
+
+      if(event->mask & IN_Q_OVERFLOW) {
+         events.push_back({EVENT_OVERFLOW, std::string(), std::string()});
+         continue;
+      }
+
+      auto iter = paths.find(event->wd);
+
+      // events queued for directories that were removed since
+      if(iter == paths.end())
+         continue;
+
+      if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED)) {
+         if(event->wd == root_wd)
+            events.push_back({EVENT_ROOT_REMOVED, std::string(), std::string()});
+         else if(event->mask & IN_IGNORED)
+            EraseWatch(iter->first, std::string(iter->second));
+         continue;
+      }
+
+      event_type_t type;
+
+      if(!(event->mask & IN_ISDIR))
+         type = EVENT_FILE_CHANGED;
+      else if(event->mask & (IN_CREATE | IN_MOVED_TO))
+         type = EVENT_DIR_ADDED;
+      else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+         type = EVENT_DIR_REMOVED;
+      else
+         continue;
+
+      // names are padded with null characters
+      events.push_back({type, iter->second, std::string(event->name)});
+   }
+
+   return true;
+}
+#endif
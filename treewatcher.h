@@ -0,0 +1,98 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef TREEWATCHER_H
+#define TREEWATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+///
+/// @brief  Watches directories of a tree for changes with inotify and
+///         reports changes of directory entries.
+///
+/// Each directory is watched individually and new sub-directories must
+/// be added by the caller when they are reported. File changes are
+/// reported when a file is created, is closed after it was written, is
+/// deleted or is moved into or out of a watched directory, without
+/// telling these apart, so the caller is expected to look up the file
+/// to find out whether it still exists.
+///
+/// The first directory added is the root of the tree and when it's
+/// deleted or moved, `EVENT_ROOT_REMOVED` is reported.
+///
+/// This class is only available on Linux.
+///
+class TreeWatcher {
+   public:
+      ///
+      /// @brief  Types of reported changes.
+      ///
+      enum event_type_t {
+         EVENT_FILE_CHANGED,                 ///< A file was created, written, deleted or moved.
+         EVENT_DIR_ADDED,                    ///< A directory was created or moved into a watched directory.
+         EVENT_DIR_REMOVED,                  ///< A directory was deleted or moved out of a watched directory.
+         EVENT_OVERFLOW,                     ///< Events were lost and the tree must be scanned again.
+         EVENT_ROOT_REMOVED                  ///< The root directory was deleted or moved.
+      };
+
+      ///
+      /// @brief  A change of a directory entry.
+      ///
+      struct event_t {
+         event_type_t   type;                ///< Type of the change.
+         std::string    dirpath;             ///< Path of the watched directory with the entry.
+         std::string    name;                ///< Entry name, no separators (empty for overflow and root events).
+      };
+
+   private:
+      int                                 fd;         ///< inotify file descriptor.
+      int                                 root_wd;    ///< Watch descriptor of the root directory.
+
+      std::unordered_map<int, std::string> paths;     ///< Directory paths by watch descriptors.
+      std::map<std::string, int>          watches;    ///< Watch descriptors by directory paths, sorted to find sub-trees.
+
+      std::vector<char>                   buffer;     ///< Buffer for raw inotify events.
+
+   private:
+      /// Forgets the watch `wd` of the directory `dirpath` without removing it from inotify.
+      void EraseWatch(int wd, const std::string& dirpath);
+
+   public:
+      /// Creates an inotify instance or throws `std::system_error`.
+      TreeWatcher(void);
+
+      TreeWatcher(const TreeWatcher&) = delete;
+
+      /// Closes the inotify instance, which removes all watches.
+      ~TreeWatcher(void);
+
+      TreeWatcher& operator = (const TreeWatcher&) = delete;
+
+      ///
+      /// @brief  Starts watching `dirpath`, which is not expected to be
+      ///         watched already, or throws `std::system_error`.
+      ///
+      void AddDirectory(const std::string& dirpath);
+
+      /// Stops watching `dirpath` and all watched directories under it.
+      void RemoveDirectory(const std::string& dirpath);
+
+      /// Returns the number of watched directories.
+      size_t GetDirectoryCount(void) const {return watches.size();}
+
+      ///
+      /// @brief  Waits up to `timeout` milliseconds, or indefinitely if it's
+      ///         negative, for changes, which are appended to `events`, and
+      ///         returns `false` if no changes were made in that time.
+      ///
+      bool ReadEvents(std::vector<event_t>& events, int timeout);
+};
+
+#endif // TREEWATCHER_H
@@ -0,0 +1,155 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#include "workerpool.h"
+
+//
+// Identifies the pool and the worker index of the current thread, so
+// jobs submitted from worker threads can be added to their own queues.
+//
+static thread_local const WorkerPool *CurrentPool = nullptr;
+static thread_local size_t CurrentWorker = 0;
+
+WorkerPool::WorkerPool(size_t worker_count) :
+      queued(0),
+      next_queue(0),
+      stopping(false),
+      discard(false)
+{
+   if(worker_count == 0)
+      worker_count = 1;
+
+   queues.reserve(worker_count);
+
+   for(size_t worker = 0; worker < worker_count; worker++)
+      queues.push_back(std::make_unique<job_queue_t>());
+
+   workers.reserve(worker_count);
+
+   try {
+      for(size_t worker = 0; worker < worker_count; worker++)
+         workers.emplace_back(&WorkerPool::RunWorker, this, worker);
+   }
+   catch (...) {
+      Stop();
+      throw;
+   }
+}
+
+WorkerPool::~WorkerPool(void)
+{
+   {
+      std::lock_guard<std::mutex> lock(idle_mtx);
+      discard = true;
+   }
+
+   Stop();
+}
+
+void WorkerPool::Submit(job_t&& job)
+{
+   size_t worker = CurrentPool == this ? CurrentWorker : next_queue++ % queues.size();
+
+   {
+      std::lock_guard<std::mutex> lock(queues[worker]->jobs_mtx);
+      queues[worker]->jobs.push_back(std::move(job));
+   }
+
+   queued++;
+
+   //
+   // Lock the idle mutex before notifying, so a worker that just saw no
+   // queued jobs is guaranteed to be waiting by the time it's notified.
+   //
+   {
+      std::lock_guard<std::mutex> lock(idle_mtx);
+   }
+
+   idle_cv.notify_one();
+}
+
+void WorkerPool::Stop(void)
+{
+   {
+      std::lock_guard<std::mutex> lock(idle_mtx);
+      stopping = true;
+   }
+
+   idle_cv.notify_all();
+
+   for(std::thread& worker : workers) {
+      if(worker.joinable())
+         worker.join();
+   }
+}
+
+bool WorkerPool::PopJob(size_t worker, job_t& job)
+{
+   job_queue_t& queue = *queues[worker];
+
+   std::lock_guard<std::mutex> lock(queue.jobs_mtx);
+
+   if(queue.jobs.empty())
+      return false;
+
+   job = std::move(queue.jobs.back());
+   queue.jobs.pop_back();
+
+   queued--;
+
+   return true;
+}
+
+bool WorkerPool::StealJob(size_t worker, job_t& job)
+{
+   // start with the next worker, so thieves don't all go after the same queue
+   for(size_t index = 1; index < queues.size(); index++) {
+      job_queue_t& queue = *queues[(worker + index) % queues.size()];
+
+      std::lock_guard<std::mutex> lock(queue.jobs_mtx);
+
+      if(queue.jobs.empty())
+         continue;
+
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+
+      queued--;
+
+      return true;
+   }
+
+   return false;
+}
+
+void WorkerPool::RunWorker(size_t worker)
+{
+   job_t job;
+
+   CurrentPool = this;
+   CurrentWorker = worker;
+
+   while(true) {
+      // jobs that have not been started are dropped when the pool is destroyed
+      if(discard)
+         return;
+
+      if(PopJob(worker, job) || StealJob(worker, job)) {
+         job(worker);
+         job = nullptr;
+         continue;
+      }
+
+      std::unique_lock<std::mutex> lock(idle_mtx);
+
+      idle_cv.wait(lock, [this] {return stopping || queued != 0;});
+
+      // a stopped pool finishes queued jobs, unless it is being destroyed
+      if(discard || (stopping && queued == 0))
+         return;
+   }
+}
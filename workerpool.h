@@ -0,0 +1,94 @@
+/*
+    linecnt - a source line counting utility
+
+    Copyright (c) 2003-2021, Stone Steps Inc. (www.stonesteps.ca)
+
+    See COPYING and Copyright files for additional licensing and copyright information
+*/
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+///
+/// @brief  A fixed-size pool of worker threads with work-stealing job
+///         queues.
+///
+/// Each worker has its own job queue. Jobs submitted from a worker thread
+/// are added to the back of that worker's queue and the worker runs jobs
+/// from the back of its own queue first, which keeps related jobs on the
+/// same thread. Jobs submitted from other threads are distributed between
+/// worker queues. A worker with an empty queue steals jobs from the front
+/// of other workers' queues, where the oldest and typically the largest
+/// units of work are found (e.g. directories closer to the root).
+///
+/// Each job is called with a zero-based index of the worker thread that
+/// runs it, which allows jobs to maintain per-worker data without any
+/// locking.
+///
+class WorkerPool {
+   public:
+      /// A job function that is called with the index of the worker running it.
+      typedef std::function<void(size_t worker)> job_t;
+
+   private:
+      ///
+      /// @brief  A job queue owned by a single worker.
+      ///
+      struct job_queue_t {
+         std::deque<job_t>       jobs;       ///< Jobs that have not been started yet.
+         std::mutex              jobs_mtx;   ///< Protects `jobs`.
+      };
+
+   private:
+      std::vector<std::thread>   workers;    ///< Worker threads.
+      std::vector<std::unique_ptr<job_queue_t>> queues;  ///< Per-worker job queues.
+
+      std::atomic<size_t>        queued;     ///< Number of jobs in all queues.
+      std::atomic<size_t>        next_queue; ///< Next queue for jobs submitted by non-workers.
+
+      std::mutex                 idle_mtx;   ///< Protects `stopping` and changes of `discard`.
+      std::condition_variable    idle_cv;    ///< Signals new jobs and stop requests.
+
+      bool                       stopping;   ///< Set when workers should exit.
+      std::atomic<bool>          discard;    ///< Set when queued jobs should be discarded, checked before each job.
+
+   private:
+      /// Removes a job from the back of the worker's own queue.
+      bool PopJob(size_t worker, job_t& job);
+
+      /// Removes a job from the front of another worker's queue.
+      bool StealJob(size_t worker, job_t& job);
+
+      /// Runs jobs in the worker thread `worker` until the pool is stopped.
+      void RunWorker(size_t worker);
+
+   public:
+      /// Starts `worker_count` worker threads.
+      WorkerPool(size_t worker_count);
+
+      WorkerPool(const WorkerPool&) = delete;
+
+      /// Discards jobs that have not been started yet and waits for all workers to exit.
+      ~WorkerPool(void);
+
+      WorkerPool& operator = (const WorkerPool&) = delete;
+
+      /// Returns the number of worker threads in this pool.
+      size_t GetWorkerCount(void) const {return workers.size();}
+
+      /// Queues a job to be run by this or, if stolen, by another worker.
+      void Submit(job_t&& job);
+
+      /// Runs all queued jobs and waits for all workers to exit.
+      void Stop(void);
+};
+
+#endif // WORKERPOOL_H